@@ -1,9 +1,17 @@
 #version 450
 
+// Set per pipeline through VKSpecialization, branches that are off are compiled out
+layout (constant_id = 0) const bool GRAYSCALE = false;
+
 layout (location = 0) in vec4 inFragColor;
 
 layout (location = 0) out vec4 outFragColor;
 
 void main() {
-    outFragColor = inFragColor;
+    vec4 color = inFragColor;
+    if (GRAYSCALE) {
+        float luminance = dot(color.rgb, vec3(0.299, 0.587, 0.114));
+        color = vec4(vec3(luminance), color.a);
+    }
+    outFragColor = color;
 }
@@ -4,13 +4,22 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inColor;
 
 layout (binding = 0) uniform UniformBufferObject {
-    mat4 modelViewProjection;
+    mat4 projectionView;
 } ubo;
 
+// Must match VKDrawConstants
+layout (push_constant) uniform DrawConstants {
+    uint textureIndex;
+    uint materialIndex;
+    uint instanceIndex;
+    uint pad;
+    mat4 model;
+} draw;
+
 layout (location = 0) out vec4 outColor;
 
 void main() {
     outColor = vec4(inColor, 1.0);
-    gl_Position = ubo.modelViewProjection * vec4(inPos, 1.0);
+    gl_Position = ubo.projectionView * draw.model * vec4(inPos, 1.0);
     gl_Position.y *= -1;
 }
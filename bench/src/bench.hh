@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Times each run of a benchmark and keeps the fastest, which is the one least disturbed by
+// the rest of the system
+#define BENCH_RUNS 5
+
+// Seconds the fastest of runs calls of func took
+template <typename F>
+double
+bench_best(F&& func, uint32_t runs = BENCH_RUNS) {
+    double best = 1e30;
+    for (uint32_t i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+// Suites, each prints its own table
+void jobs_bench();
+void ecs_bench();
+void events_bench();
+void render_queue_bench();
+void transforms_bench();
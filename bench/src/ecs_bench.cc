@@ -0,0 +1,80 @@
+#include "bench.hh"
+#include "core/jobs.hh"
+#include "engine/ecs.hh"
+
+#include <vector>
+
+// Entities in the world, every other one also has a Health so the query spans two archetypes
+#define ECS_BENCH_ENTITIES 100000
+
+struct BenchPosition {
+    float x, y, z;
+};
+struct BenchVelocity {
+    float x, y, z;
+};
+struct BenchHealth {
+    float value;
+};
+
+static void
+_integrate(BenchPosition& position, const BenchVelocity& velocity, float dt) {
+    position.x += velocity.x * dt;
+    position.y += velocity.y * dt;
+    position.z += velocity.z * dt;
+}
+
+static void
+_print(const char* name, double seconds) {
+    printf("%-22s %8.3f ms  %6.2f ns/entity\n", name, seconds * 1e3, seconds * 1e9 / ECS_BENCH_ENTITIES);
+}
+
+// Moves every entity by its velocity, the same loop through each way of querying the world,
+// against a plain array of structs holding the same data
+void
+ecs_bench() {
+    const float dt = 1.0f / 60.0f;
+
+    Pegasus::World world;
+    std::vector<std::pair<BenchPosition, BenchVelocity> > plain(ECS_BENCH_ENTITIES);
+    for (uint32_t i = 0; i < ECS_BENCH_ENTITIES; i++) {
+        BenchPosition position = { static_cast<float>(i), 0.0f, 0.0f };
+        BenchVelocity velocity = { 1.0f, 2.0f, 3.0f };
+        plain[i] = { position, velocity };
+        if (i % 2)
+            world.Create(position, velocity, BenchHealth{ 100.0f });
+        else
+            world.Create(position, velocity);
+    }
+    printf("%u entities, %zu archetypes\n", world.GetEntityCount(), world.GetArchetypeCount());
+
+    _print("array of structs", bench_best([&plain, dt]() {
+        for (size_t i = 0; i < plain.size(); i++)
+            _integrate(plain[i].first, plain[i].second, dt);
+    }));
+
+    _print("World::Each", bench_best([&world, dt]() {
+        world.Each<BenchPosition, const BenchVelocity>([dt](Pegasus::Entity, BenchPosition& position, const BenchVelocity& velocity) {
+            _integrate(position, velocity, dt);
+        });
+    }));
+
+    _print("World::EachChunk", bench_best([&world, dt]() {
+        world.EachChunk<BenchPosition, const BenchVelocity>([dt](uint32_t count, Pegasus::Entity*, BenchPosition* positions, const BenchVelocity* velocities) {
+            for (uint32_t i = 0; i < count; i++)
+                _integrate(positions[i], velocities[i], dt);
+        });
+    }));
+
+    if (!JobSystem::Startup()) {
+        printf("Error: failed to start job system\n");
+        return;
+    }
+    _print("World::ParallelEach", bench_best([&world, dt]() {
+        world.ParallelEach<BenchPosition, const BenchVelocity>([dt](Pegasus::Entity, BenchPosition& position, const BenchVelocity& velocity) {
+            _integrate(position, velocity, dt);
+        });
+    }));
+    printf("(%u workers)\n", JobSystem::GetWorkerCount());
+    JobSystem::Shutdown();
+}
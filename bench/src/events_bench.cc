@@ -0,0 +1,70 @@
+#include "bench.hh"
+#include "core/event_channel.hh"
+#include "core/events.hh"
+
+#include <vector>
+
+// Events fired per timed run
+#define EVENTS_BENCH_FIRES 100000
+// Code the EventHandler side fires, outside of the ones the engine uses
+#define EVENTS_BENCH_CODE 0x100
+
+struct BenchEvent {
+    uint32_t value;
+};
+
+// Listeners never handle the event, so every fire reaches all of them
+static bool
+_on_channel(void* context, const BenchEvent& event) {
+    *static_cast<uint32_t*>(context) += event.value;
+    return false;
+}
+
+// EventChannel<BenchEvent>::Fire against EventHandler::Fire with the same listeners
+static void
+_bench_listeners(uint32_t listeners) {
+    std::vector<uint32_t> sums(listeners, 0);
+
+    bool full = false;
+    for (uint32_t i = 0; i < listeners; i++)
+        full |= !EventChannel<BenchEvent>::Register(&_on_channel, &sums[i]);
+    double channel = full ? 0.0 : bench_best([]() {
+        for (uint32_t i = 0; i < EVENTS_BENCH_FIRES; i++)
+            EventChannel<BenchEvent>::Fire({ 1 });
+    });
+    for (uint32_t i = 0; i < listeners; i++)
+        EventChannel<BenchEvent>::Unregister(&_on_channel, &sums[i]);
+    if (full) {
+        printf("Error: %u listeners do not fit in a channel\n", listeners);
+        return;
+    }
+
+    EventHandler::Startup();
+    for (uint32_t i = 0; i < listeners; i++) {
+        EventHandler::Register(EVENTS_BENCH_CODE, &sums[i], [](uint16_t, void*, void* listener, EventContext data) -> bool {
+            *static_cast<uint32_t*>(listener) += data.u32[0];
+            return false;
+        });
+    }
+    double handler = bench_best([]() {
+        EventContext context = {};
+        context.u32[0] = 1;
+        for (uint32_t i = 0; i < EVENTS_BENCH_FIRES; i++)
+            EventHandler::Fire(EVENTS_BENCH_CODE, nullptr, context);
+    });
+    EventHandler::Shutdown();
+
+    printf("%3u listeners  %8.1f ns/fire  %8.1f ns/fire  %5.2fx\n",
+            listeners,
+            channel * 1e9 / EVENTS_BENCH_FIRES,
+            handler * 1e9 / EVENTS_BENCH_FIRES,
+            handler / channel);
+}
+
+void
+events_bench() {
+    printf("               EventChannel  EventHandler\n");
+    _bench_listeners(1);
+    _bench_listeners(10);
+    _bench_listeners(100);
+}
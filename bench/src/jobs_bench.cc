@@ -0,0 +1,105 @@
+#include "bench.hh"
+#include "core/jobs.hh"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// Jobs started before each wait, kept below JOB_QUEUE_SIZE so that none of them run inline
+#define JOBS_BENCH_BATCH 512
+// Batches per timed run of the spawn benchmark
+#define JOBS_BENCH_BATCHES 64
+// Iterations the ParallelFor benchmark splits up, and the smallest chunk it may use
+#define JOBS_BENCH_RANGE (1u << 22)
+#define JOBS_BENCH_MIN_CHUNK 1024
+
+// What starting an empty job and waiting for it costs
+// One at a time is the round trip of a single dependency, batched is the cost per job when
+// many are started before waiting once (the way ParallelFor and the frame graph use it)
+static void
+_bench_spawn() {
+    double single = bench_best([]() {
+        for (uint32_t i = 0; i < JOBS_BENCH_BATCH; i++) {
+            JobCounter counter;
+            JobSystem::Run([]() {}, &counter);
+            JobSystem::Wait(counter);
+        }
+    });
+    double batched = bench_best([]() {
+        for (uint32_t b = 0; b < JOBS_BENCH_BATCHES; b++) {
+            JobCounter counter;
+            for (uint32_t i = 0; i < JOBS_BENCH_BATCH; i++)
+                JobSystem::Run([]() {}, &counter);
+            JobSystem::Wait(counter);
+        }
+    });
+
+    printf("spawn, one at a time  %8.1f ns/job\n", single * 1e9 / JOBS_BENCH_BATCH);
+    printf("spawn, batched        %8.1f ns/job\n", batched * 1e9 / (JOBS_BENCH_BATCH * JOBS_BENCH_BATCHES));
+}
+
+// Empty jobs queued on the main thread, which then waits without running any of them, so
+// every job has to be stolen by a worker. Includes waking the workers up
+static void
+_bench_steal() {
+    JobStats before = JobSystem::GetStats();
+    double seconds = bench_best([]() {
+        JobCounter counter;
+        for (uint32_t i = 0; i < JOBS_BENCH_BATCH; i++)
+            JobSystem::Run([]() {}, &counter);
+        while (!counter.IsDone())
+            std::this_thread::yield();
+    });
+    JobStats after = JobSystem::GetStats();
+
+    printf("steal                 %8.1f ns/job (%llu of %u jobs stolen)\n",
+            seconds * 1e9 / JOBS_BENCH_BATCH,
+            static_cast<unsigned long long>(after.stolen - before.stolen),
+            JOBS_BENCH_BATCH * BENCH_RUNS);
+}
+
+// The same loop split with ParallelFor over 1..N workers, against running it on this thread
+static void
+_bench_parallel_for() {
+    std::vector<float> data(JOBS_BENCH_RANGE);
+    for (uint32_t i = 0; i < JOBS_BENCH_RANGE; i++)
+        data[i] = static_cast<float>(i);
+
+    // A few square roots per element, so the loop is bound by compute rather than memory
+    auto work = [&data](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            float x = data[i];
+            for (uint32_t k = 0; k < 8; k++)
+                x = std::sqrt(x + 1.0f);
+            data[i] = x;
+        }
+    };
+
+    double serial = bench_best([&work]() { work(0, JOBS_BENCH_RANGE); });
+    printf("parallel for, %u iterations\n", JOBS_BENCH_RANGE);
+    printf("  no job system  %8.2f ms\n", serial * 1e3);
+
+    uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t maxWorkers = std::max(1u, cores - 1);
+    for (uint32_t workers = 1; workers <= maxWorkers; workers++) {
+        if (!JobSystem::Startup(workers))
+            return;
+        double seconds = bench_best([&work]() { JobSystem::ParallelFor(JOBS_BENCH_RANGE, work, JOBS_BENCH_MIN_CHUNK); });
+        JobSystem::Shutdown();
+
+        printf("  %2u workers     %8.2f ms  %5.2fx\n", workers, seconds * 1e3, serial / seconds);
+    }
+}
+
+void
+jobs_bench() {
+    if (!JobSystem::Startup()) {
+        printf("Error: failed to start job system\n");
+        return;
+    }
+    _bench_spawn();
+    _bench_steal();
+    JobSystem::Shutdown();
+
+    _bench_parallel_for();
+}
@@ -0,0 +1,30 @@
+#include "bench.hh"
+#include <cstring>
+
+// Runs every suite, or the ones named on the command line (ie bench jobs)
+int main(int argc, char** argv) {
+    struct Suite {
+        const char* name;
+        void (*run)();
+    };
+    const Suite suites[] = {
+        { "jobs", &jobs_bench },
+        { "ecs", &ecs_bench },
+        { "events", &events_bench },
+        { "render_queue", &render_queue_bench },
+        { "transforms", &transforms_bench },
+    };
+
+    for (const Suite& suite : suites) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++)
+            selected = strcmp(argv[i], suite.name) == 0;
+        if (!selected)
+            continue;
+
+        printf("== %s ==\n", suite.name);
+        suite.run();
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "bench.hh"
+#include "renderer/render_queue.hh"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Draws per frame
+#define RENDER_QUEUE_BENCH_DRAWS 100000
+
+// Seconds the fastest sort of keys took, the queue is refilled before each (untimed)
+static double
+_best_sort(RenderQueue& queue, const std::vector<uint64_t>& keys) {
+    double best = 1e30;
+    for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+        queue.Clear();
+        for (size_t i = 0; i < keys.size(); i++)
+            queue.Push(keys[i], static_cast<uint32_t>(i));
+
+        auto start = std::chrono::steady_clock::now();
+        queue.Sort();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+    }
+    return best;
+}
+
+static double
+_best_std_sort(const std::vector<uint64_t>& keys) {
+    double best = 1e30;
+    std::vector<RenderItem> items(keys.size());
+    for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+        for (size_t i = 0; i < keys.size(); i++)
+            items[i] = { keys[i], static_cast<uint32_t>(i) };
+
+        auto start = std::chrono::steady_clock::now();
+        std::stable_sort(items.begin(), items.end(), [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+    }
+    return best;
+}
+
+static void
+_print(const char* name, double sort, double stdSort) {
+    printf("%-22s %8.3f ms  (std::stable_sort %8.3f ms)\n", name, sort * 1e3, stdSort * 1e3);
+}
+
+// RenderQueue::Sort over a frame's worth of draws
+// Scene keys come from MakeKey the way the backend builds them: a few pipelines, a few
+// hundred meshes, a tenth of the draws transparent, depth spread over the whole range
+void
+render_queue_bench() {
+    std::mt19937_64 random(1234);
+    std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+    std::vector<uint64_t> scene(RENDER_QUEUE_BENCH_DRAWS);
+    for (size_t i = 0; i < scene.size(); i++) {
+        RenderLayer layer = (random() % 10 == 0) ? RENDER_LAYER_TRANSPARENT : RENDER_LAYER_OPAQUE;
+        scene[i] = RenderQueue::MakeKey(layer, random() % 16, 0, random() % 500, depth(random));
+    }
+    std::vector<uint64_t> uniform(RENDER_QUEUE_BENCH_DRAWS);
+    for (size_t i = 0; i < uniform.size(); i++)
+        uniform[i] = random();
+
+    RenderQueue queue;
+    queue.Reserve(RENDER_QUEUE_BENCH_DRAWS);
+    printf("%u draws\n", RENDER_QUEUE_BENCH_DRAWS);
+    _print("scene keys", _best_sort(queue, scene), _best_std_sort(scene));
+    _print("random keys", _best_sort(queue, uniform), _best_std_sort(uniform));
+}
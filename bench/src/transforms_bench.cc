@@ -0,0 +1,89 @@
+#include "bench.hh"
+#include "core/jobs.hh"
+#include "engine/transform.hh"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// 1000 roots with 9 children each, and 10 children under each of those: 100k nodes over
+// three depths
+#define TRANSFORMS_BENCH_ROOTS 1000
+#define TRANSFORMS_BENCH_CHILDREN 9
+#define TRANSFORMS_BENCH_GRANDCHILDREN 10
+
+struct TransformsBenchScene {
+    Pegasus::TransformHierarchy hierarchy;
+    std::vector<Pegasus::TransformHandle> roots;
+    std::vector<Pegasus::TransformHandle> nodes;
+    float time = 0.0f;
+};
+
+// Move the roots, or every node, a little further than last time
+static void
+_move(TransformsBenchScene& scene, const std::vector<Pegasus::TransformHandle>& nodes) {
+    scene.time += 0.01f;
+    for (size_t i = 0; i < nodes.size(); i++)
+        scene.hierarchy.SetPosition(nodes[i], glm::vec3(scene.time, static_cast<float>(i % 7), 1.0f));
+}
+
+// Seconds the fastest Update took, nodes are moved before each (untimed)
+static double
+_best_update(TransformsBenchScene& scene, const std::vector<Pegasus::TransformHandle>& moved) {
+    double best = 1e30;
+    for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+        _move(scene, moved);
+        auto start = std::chrono::steady_clock::now();
+        scene.hierarchy.Update();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+    }
+    return best;
+}
+
+static void
+_print(const char* name, double seconds) {
+    printf("%-30s %8.3f ms\n", name, seconds * 1e3);
+}
+
+// TransformHierarchy::Update over 100k nodes
+// Roots moving recomputes every world matrix but only the roots' local ones, fully dirty
+// recomputes both for every node. Fully dirty is also run over 1..N workers
+void
+transforms_bench() {
+    TransformsBenchScene scene;
+    for (uint32_t r = 0; r < TRANSFORMS_BENCH_ROOTS; r++) {
+        Pegasus::TransformHandle root = scene.hierarchy.Create();
+        scene.roots.push_back(root);
+        scene.nodes.push_back(root);
+        for (uint32_t c = 0; c < TRANSFORMS_BENCH_CHILDREN; c++) {
+            Pegasus::TransformHandle child = scene.hierarchy.Create(root);
+            scene.nodes.push_back(child);
+            for (uint32_t g = 0; g < TRANSFORMS_BENCH_GRANDCHILDREN; g++)
+                scene.nodes.push_back(scene.hierarchy.Create(child));
+        }
+    }
+    // Builds the order once, so it is not part of any timing
+    scene.hierarchy.Update();
+    printf("%zu nodes, %u depths, %s\n",
+            scene.hierarchy.GetCount(),
+            scene.hierarchy.GetDepthCount(),
+            Pegasus::TransformHierarchy::IsAccelerated() ? "AVX2" : "scalar");
+
+    std::vector<Pegasus::TransformHandle> none;
+    _print("nothing moved", _best_update(scene, none));
+    _print("roots moving, no job system", _best_update(scene, scene.roots));
+    _print("fully dirty, no job system", _best_update(scene, scene.nodes));
+
+    uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t maxWorkers = std::max(1u, cores - 1);
+    for (uint32_t workers = 1; workers <= maxWorkers; workers++) {
+        if (!JobSystem::Startup(workers))
+            return;
+        double roots = _best_update(scene, scene.roots);
+        double dirty = _best_update(scene, scene.nodes);
+        JobSystem::Shutdown();
+
+        printf("%2u workers: roots moving %8.3f ms, fully dirty %8.3f ms\n", workers, roots * 1e3, dirty * 1e3);
+    }
+}
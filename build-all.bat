@@ -11,6 +11,10 @@ REM Testbed
 make -f "Makefile.testbed.windows.mak" All
 IF %ERRORLEVEL% NEQ 0 (echo Error: %ERRORLEVEL% && exit)
 
+REM Benchmarks
+make -f "Makefile.bench.windows.mak" All
+IF %ERRORLEVEL% NEQ 0 (echo Error: %ERRORLEVEL% && exit)
+
 @REM PUSHD engine
 @REM CALL build.bat
 @REM POPD
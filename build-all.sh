@@ -18,5 +18,13 @@ then
     echo "Error: $ERRORLEVEL" && exit
 fi
 
+# Benchmarks
+make -f "Makefile.bench.linux.mak" all
+errorlevel=$?
+if [ $ERRORLEVEL -ne 0 ]
+then
+    echo "Error: $ERRORLEVEL" && exit
+fi
+
 echo "All assemblies built successfully"
 
@@ -8,3 +8,7 @@ IF %ERRORLEVEL% NEQ 0 (echo Error: %ERRORLEVEL% && exit)
 REM Testbed
 make -f "Makefile.testbed.windows.mak" clean
 IF %ERRORLEVEL% NEQ 0 (echo Error: %ERRORLEVEL% && exit)
+
+REM Benchmarks
+make -f "Makefile.bench.windows.mak" clean
+IF %ERRORLEVEL% NEQ 0 (echo Error: %ERRORLEVEL% && exit)
\ No newline at end of file
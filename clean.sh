@@ -5,3 +5,6 @@ make -f "Makefile.engine.linux.mak" clean
 
 # Testbed
 make -f "Makefile.testbed.linux.mak" clean
+
+# Benchmarks
+make -f "Makefile.bench.linux.mak" clean
@@ -1,8 +1,11 @@
 #include "application.hh"
 #include "core/events.hh"
+#include "core/filesystem.hh"
+#include "core/jobs.hh"
 // #include "renderer/vulkan/renderer.hh"
 #include "renderer/renderer_frontend.hh"
 #include "game_types.hh"
+#include <atomic>
 #include <chrono>
 
 #define GLM_FORCE_RADIANS
@@ -11,6 +14,13 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// Longest the loop sleeps while suspended, so events posted from other threads still get
+// dispatched without input coming in
+#define APPLICATION_SUSPENDED_WAIT 0.25
+
+// Radians the camera orbits by per pixel the mouse moves horizontally
+#define CAMERA_MOUSE_SENSITIVITY 0.01f
+
 static Settings settings = {};
 
 struct ApplicationState {
@@ -18,31 +28,112 @@ struct ApplicationState {
     uint32_t height = 0;
     bool is_running = false;
     bool is_suspended = true;
+    bool is_focused = true;
     bool initialized = false;
+    // Read by the camera late latch on the render thread
+    std::atomic<float> aspect{1.0f};
+    // Set from the mouse on the main thread, read by the camera late latch
+    std::atomic<float> cameraYaw{0.0f};
+    std::chrono::steady_clock::time_point startTime;
 };
 
 static ApplicationState app_state = {};
 
+// Handed along between the jobs of a frame
+struct FrameData {
+    std::chrono::steady_clock::time_point sampleTime;
+    float time = 0.0f;
+    float delta = 0.0f;
+    float alpha = 1.0f;
+    RenderPacket packet = {};
+};
+
+// What a simulation step works on, passed to it through the timer
+struct SimulationContext {
+    Pegasus::Game* game;
+    Pegasus::TransformHierarchy* transforms;
+    Pegasus::TransformHandle spin;
+    StepTimer* timer;
+};
+
+// Camera, models bring their own world matrix
+// Orbits the origin around the z axis by yaw
+static glm::mat4
+camera_projection_view(float aspect, float yaw) {
+    float c = glm::cos(yaw);
+    float s = glm::sin(yaw);
+    glm::mat4 view = glm::lookAt(
+        glm::vec3(2.0f * (c - s), 2.0f * (s + c), 2.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f));
+
+    glm::mat4 proj = glm::perspective(
+        // 1.f + glm::cos(0.7f * time) *
+        glm::radians(45.0f),
+        aspect, 0.1f, 10.0f);
+
+    return proj * view;
+}
+
+// The frame rate limit, lowered while the window is in the background
+static double
+frame_rate_limit() {
+    bool throttled = !app_state.is_focused && settings.unfocusedFrameRate > 0.0
+        && (settings.targetFrameRate <= 0.0 || settings.unfocusedFrameRate < settings.targetFrameRate);
+    return throttled ? settings.unfocusedFrameRate : settings.targetFrameRate;
+}
+
+static float
+seconds_since_start(std::chrono::steady_clock::time_point now) {
+    return std::chrono::duration<float, std::chrono::seconds::period>(now - app_state.startTime).count();
+}
+
+// One step of the simulation, run by the timer as many times as the frame needs
+// Runs on simulated time, so the result does not depend on the frame rate
+static void
+simulate_step(void* context) {
+    SimulationContext* simulation = static_cast<SimulationContext*>(context);
+    float delta = static_cast<float>(simulation->timer->GetElapsedSeconds());
+    float time = static_cast<float>(simulation->timer->GetTotalSeconds());
+    simulation->game->Update(delta);
+
+    simulation->transforms->SetRotation(simulation->spin, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    simulation->transforms->Update();
+}
+
 Application::Application(Pegasus::Game& game, std::string name, uint32_t width, uint32_t height, std::string assetPath)
             : m_game(game),
             m_name(name), 
             m_assetPath(assetPath), 
             m_width(width),
             m_height(height),
-            m_timer{} {
+            m_timer{},
+            m_pacer{} {
     // Application Init steps
     settings = {};
 
     app_state.width = width;
     app_state.height = height;
+    app_state.aspect.store(static_cast<float>(width) / static_cast<float>(height));
 
     // TODO: set this to be configurable
     settings.enableValidation = true;
-    settings.enableVsync = false; // disable vsync for higher fps
+    // Vsync with one frame of queue keeps power use and input latency down. For uncapped
+    // benchmarking use PRESENT_MODE_MAILBOX or PRESENT_MODE_IMMEDIATE
+    settings.presentMode = PRESENT_MODE_FIFO;
+    settings.targetFrameRate = 0.0;
+    settings.maxQueuedFrames = 1;
+    m_pacer.SetTargetFrameRate(frame_rate_limit());
+    if (settings.simulationRate > 0.0) {
+        m_timer.SetFixedTimeStep(true);
+        m_timer.SetTargetElapsedSeconds(1.0 / settings.simulationRate);
+        m_timer.SetMaxUpdatesPerTick(settings.maxSimulationSteps);
+    }
 
     // Startup subsystems
     /* TODO: Logging startup */
     InputHandler::Startup();
+    InputHandler::SetResizeDebounce(settings.resizeDebounce);
 
     app_state.is_running = true;
     app_state.is_suspended = false;
@@ -53,6 +144,11 @@ Application::Application(Pegasus::Game& game, std::string name, uint32_t width,
     }
     std::cout << "Event System created..." << std::endl;
 
+    if (!JobSystem::Startup(settings.jobWorkers, settings.pinJobWorkers)) {
+        std::cout << "Error: failed to start job system" << std::endl;
+        return;
+    }
+
     // Register for events
     EventHandler::Register(EVENT_CODE_APPLICATION_QUIT, nullptr, [&, this](uint16_t code, void* sender, void* listener, EventContext data) -> bool {
             this->OnEvent(code, sender, listener, data);
@@ -74,6 +170,10 @@ Application::Application(Pegasus::Game& game, std::string name, uint32_t width,
         this->OnKey(code, sender, listener, data);
         return true;});
 
+    EventHandler::Register(EVENT_CODE_FOCUS_CHANGED, nullptr, [&, this](uint16_t code, void* sender, void* listener, EventContext data) -> bool {
+        this->OnEvent(code, sender, listener, data);
+        return true;});
+
     // Init the platform
     if (!Platform::Startup(name, width, height)) {
         std::cout << "Error: failed to initialize Platform Layer" << std::endl;
@@ -81,7 +181,19 @@ Application::Application(Pegasus::Game& game, std::string name, uint32_t width,
     }
     std::cout << "Platform created" << std::endl;
 
-    if (!Renderer::Initialize(name, assetPath, width, height, {true, false})) {
+    // Mount the asset root. Loose files override anything in the pack so assets can be
+    // edited during development without rebuilding it
+    FileSystem::Startup(assetPath, true);
+    if (FileSystem::MountPack(assetPath + "/assets.pak")) {
+        std::cout << "Asset pack mounted" << std::endl;
+    }
+
+    RendererSettings rendererSettings = {};
+    rendererSettings.enable_validation = settings.enableValidation;
+    rendererSettings.present_mode = settings.presentMode;
+    rendererSettings.max_queued_frames = settings.maxQueuedFrames;
+    rendererSettings.render_thread = settings.renderThread;
+    if (!Renderer::Initialize(name, assetPath, width, height, rendererSettings)) {
         std::cout << "Error: failed to initialize Renderer Subsystem" << std::endl;
         exit(1);
     }
@@ -101,19 +213,19 @@ bool
 Application::run() {
     // create temporary objects using the renderer API
     // TODO: remove these and do this through UI
-    Pegasus::GameObject obj = Pegasus::Game::NewGameObject();
-    Pegasus::GameObject obj2 = Pegasus::Game::NewGameObject();
-    
-    obj.vertices = {
+    Pegasus::World& world = Pegasus::Game::GetWorld();
+    Pegasus::TransformHierarchy& transforms = Pegasus::Game::GetTransforms();
+
+    std::vector<Vertex> vertices = {
         {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.87f, 0.0f}},
         {{0.5f, -0.5f, 0.0f}, {0.51f, 1.0f, 0.0f}},
         {{0.5f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.43f}},
         {{-0.5f, 0.5f, 0.0f}, {1.0f, 0.5f, 0.0f}}
     };
-    obj.indices = {
+    std::vector<uint32_t> indices = {
         0, 1, 2, 2, 3, 0
     };
-    // obj.vertices = {
+    // vertices = {
     //     { {-0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 1.0f} },
     //     { {0.5f,  -0.5f,  0.5f}, {1.0f, 0.0f, 1.0f} },
     //     { {-0.5f, 0.5f,  0.5f}, {1.0f, 1.0f, 0.0f} },
@@ -123,7 +235,7 @@ Application::run() {
     //     { {-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f} },
     //     { {0.5f,  -0.5f, -0.5f}, {0.0f, 0.0f, 0.0f} },
     // };
-    // obj.vertices = {
+    // vertices = {
     //     { {-0.5f, -0.5f, -0.49f}, {0.5f, 0.f, 0.f} },
     //     { {0.5f, -0.5f, -0.5f}, {0.f, 0.f, 0.f} },
     //     { {0.5f,  0.5f, -0.49f}, {0.5f, 0.5f, 0.f} },
@@ -133,7 +245,7 @@ Application::run() {
     //     { {0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f} },
     //     { {-0.5f,  0.5f,  0.5f}, {0.f, 0.5f, 0.5f} },
     // };
-    // obj.indices = {
+    // indices = {
     //     0, 1, 2, 2, 3, 0,
     //     4, 5, 6, 6, 7, 4,
     //     0, 4, 7, 7, 3, 0,
@@ -142,62 +254,115 @@ Application::run() {
     //     0, 1, 5, 5, 4, 0,
     // };
     
-    obj2.vertices = {
+    std::vector<Vertex> vertices2 = {
         {{-0.5f, -0.5f, 0.5f}, {0.3f, 0.87f, 0.0f}},
         {{0.5f, -0.5f, 0.5f}, {0.81f, 1.0f, 0.9f}},
         {{0.5f, 0.5f, 0.5f}, {1.0f, 0.0f, 0.43f}},
         {{-0.5f, 0.5f, 0.5f}, {1.0f, 0.5f, 0.0f}}
     };
-    obj2.indices = {
+    std::vector<uint32_t> indices2 = {
         0, 1, 2, 3, 0, 2
     };
 
-    Renderer::CreateModel(obj);
-    Renderer::CreateModel(obj2);
+    // Both quads hang off a node that spins them around the z axis
+    Pegasus::TransformHandle spin = transforms.Create();
+    world.Create(Pegasus::Color{}, Pegasus::Renderable{ Renderer::CreateModel(vertices, indices) }, Pegasus::Transform{ transforms.Create(spin) });
+    world.Create(Pegasus::Color{}, Pegasus::Renderable{ Renderer::CreateModel(vertices2, indices2) }, Pegasus::Transform{ transforms.Create(spin) });
+    SimulationContext simulation = { &m_game, &transforms, spin, &m_timer };
+
+    app_state.startTime = std::chrono::steady_clock::now();
+
+    // Rebuild the camera right before each frame is submitted, so the frame shows where
+    // the camera is by then rather than where it was when the frame was simulated
+    // The mouse keeps moving the camera while the render thread works on the frame, since the
+    // main thread goes on to pump the next frame's messages. Without a render thread the frame
+    // is submitted right after it is built, and the latch sees the same input as the packet
+    if (settings.lateLatch) {
+        Renderer::SetLateLatch([](const RenderPacket&, UBO& ubo, std::chrono::steady_clock::time_point& sampleTime) -> bool {
+            sampleTime = std::chrono::steady_clock::now();
+            ubo.projectionView = camera_projection_view(app_state.aspect.load(), app_state.cameraYaw.load());
+            return true;
+        });
+    }
+
+    // When the last frame was sampled, for the time between frames Render is given
+    std::chrono::steady_clock::time_point lastSampleTime = app_state.startTime;
 
     // Application Event loop
     while (app_state.is_running) {
         if (!Platform::pump_messages())
             app_state.is_running = false;
 
-        if (!app_state.is_suspended) {
-            // Update timer
-            m_timer.Tick(nullptr);
-            static auto startTime = std::chrono::high_resolution_clock::now();
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
-            UBO ubo{};
-            glm::mat4 model = glm::rotate(
-                glm::mat4(1.0f), 
-                time * glm::radians(90.0f),
-                glm::vec3(0.0f, 0.0f, 1.0f));
-
-            glm::mat4 view = glm::lookAt(
-                glm::vec3(2.0f, 2.0f, 2.0f),
-                glm::vec3(0.0f, 0.0f, 0.0f),
-                glm::vec3(0.0f, 0.0f, 1.0f));
-
-            glm::mat4 proj = glm::perspective(
-                // 1.f + glm::cos(0.7f * time) *
-                glm::radians(45.0f),
-                static_cast<float>(app_state.width) / static_cast<float>(app_state.height), 0.1f, 10.0f);
-
-            ubo.projectionView = proj * view * model;
-
-            // Update FPS and framecount
-            snprintf(m_lastFPS, static_cast<size_t>(32), "%u fps", m_timer.GetFPS());
-            m_framecounter++;
-
-            // Render a frame
-            RenderPacket packet = {};
-            packet.ubo = ubo;
-            Renderer::DrawFrame(packet);
+        // Events other threads posted since the last frame
+        EventHandler::DispatchQueued();
+
+        // Apply the latest window size once, however many resizes came in since the last frame
+        InputHandler::FlushResize();
+
+        // Nothing to draw, sleep until the window is restored (or something is posted)
+        if (app_state.is_suspended) {
+            Platform::wait_messages(APPLICATION_SUSPENDED_WAIT);
+            continue;
         }
-        
+
+        // Frame limited, wait for the next frame in a way that input can cut short, so it is
+        // handled as it comes in rather than all at once when the frame starts
+        // Once the wait comes back without messages, the pacer sleeps out whatever is left
+        double idle = m_pacer.GetIdleSeconds();
+        if (idle > 0.0 && Platform::wait_messages(idle))
+            continue;
+        // Hold the loop to the target frame rate
+        m_pacer.Wait();
+
+        // Scratch memory from last frame's main thread code
+        JobSystem::ResetFrameAllocator();
+
+        // The frame is a small job graph: simulate, then build the render packet from the
+        // result. The main thread runs jobs while it waits for the end of the graph, then
+        // hands the packet to the renderer itself
+        FrameData frame = {};
+        JobCounter simulated;
+        JobCounter built;
+
+        JobSystem::Run([this, &frame, &simulation, &lastSampleTime]() {
+            // Runs as many fixed steps as the time since the last frame holds, possibly none
+            m_timer.Tick(simulate_step, &simulation);
+            frame.sampleTime = std::chrono::steady_clock::now();
+            frame.time = seconds_since_start(frame.sampleTime);
+            // Wall clock time since the last frame, the step length only matters to Update
+            frame.delta = std::chrono::duration<float, std::chrono::seconds::period>(frame.sampleTime - lastSampleTime).count();
+            lastSampleTime = frame.sampleTime;
+            frame.alpha = static_cast<float>(m_timer.GetInterpolationAlpha());
+        }, &simulated);
+
+        JobSystem::Run([this, &frame, &simulated, &world, &transforms]() {
+            JobSystem::Wait(simulated);
+
+            frame.packet.ubo.projectionView = camera_projection_view(app_state.aspect.load(), app_state.cameraYaw.load());
+            world.Each<const Pegasus::Transform, const Pegasus::Renderable>(
+                [&frame, &transforms](Pegasus::Entity, const Pegasus::Transform& transform, const Pegasus::Renderable& renderable) {
+                    frame.packet.transforms.push_back({ renderable.model, transforms.GetPreviousWorld(transform.node), transforms.GetWorld(transform.node) });
+                });
+            frame.packet.time = frame.time;
+            frame.packet.sampleTime = frame.sampleTime;
+            frame.packet.alpha = frame.alpha;
+            m_game.Render(frame.delta, frame.alpha);
+        }, &built);
+
+        JobSystem::Wait(built);
+
+        // Update FPS and framecount
+        snprintf(m_lastFPS, static_cast<size_t>(32), "%u fps", m_timer.GetFPS());
+        m_framecounter++;
+
+        // Render a frame
+        Renderer::DrawFrame(frame.packet);
+
         if (m_framecounter % 300 == 0) {
+            char latency[48];
+            snprintf(latency, sizeof(latency), "%.1f ms input to submit", Renderer::GetLatencyStats().averageInputToSubmit * 1000.0);
             Platform::set_title(
-                m_name + " - " + std::string(m_lastFPS)
+                m_name + " - " + std::string(m_lastFPS) + " - " + std::string(latency)
             );
         }
     }
@@ -208,10 +373,15 @@ Application::run() {
     EventHandler::Unregister(EVENT_CODE_KEY_PRESSED, nullptr);
     EventHandler::Unregister(EVENT_CODE_KEY_RELEASED, nullptr);
     EventHandler::Unregister(EVENT_CODE_RESIZED, nullptr);
+    EventHandler::Unregister(EVENT_CODE_MOUSE_MOVED, nullptr);
+    EventHandler::Unregister(EVENT_CODE_FOCUS_CHANGED, nullptr);
 
     EventHandler::Shutdown();
     InputHandler::Shutdown();
     Renderer::Shutdown();
+    // Pending file reads still use the mounted packs
+    JobSystem::Shutdown();
+    FileSystem::Shutdown();
     Platform::Shutdown();
     std::cout << "Application shutdown successfully" << std::endl;
     return true; 
@@ -234,6 +404,14 @@ Application::OnEvent(uint16_t code, void* sender, void* listener, EventContext c
             app_state.is_running = false;
             return true;
         }; break;
+        case EVENT_CODE_FOCUS_CHANGED: {
+            bool focused = context.u8[0] != 0;
+            if (focused != app_state.is_focused) {
+                app_state.is_focused = focused;
+                m_pacer.SetTargetFrameRate(frame_rate_limit());
+            }
+            return true;
+        }; break;
         default:
             break;
     }
@@ -241,16 +419,14 @@ Application::OnEvent(uint16_t code, void* sender, void* listener, EventContext c
     return false;
 }
 
-// TODO: register an event for when the mouse moves
-//       print out the location of the mouse
+// Horizontal mouse movement orbits the camera
 bool 
 Application::OnMouseMove(uint16_t code, void* sender, void* listener, EventContext context) {
-    (void)context;
     (void)listener;
     (void)sender;
     switch(code) {
         case EVENT_CODE_MOUSE_MOVED: {
-            printf("X: %i, Y: %i\n", context.u16[0], context.u16[1]);
+            app_state.cameraYaw.store(static_cast<float>(context.u16[0]) * CAMERA_MOUSE_SENSITIVITY);
             return true;
         }; break;
         default:
@@ -277,6 +453,8 @@ Application::OnResize(uint16_t code, void* sender, void* listener, EventContext
             printf("[%i, %i] != [%i, %i]\n", app_state.width, app_state.height, w, h);
             app_state.width = w;
             app_state.height = h;
+            if (w != 0 && h != 0)
+                app_state.aspect.store(static_cast<float>(w) / static_cast<float>(h));
 
             // Handle minimization
             if (w == 0 || h == 0) {
@@ -289,6 +467,9 @@ Application::OnResize(uint16_t code, void* sender, void* listener, EventContext
                 if (app_state.is_suspended) {
                     std::cout << "Window restored. Resuming application" << std::endl;
                     app_state.is_suspended = false;
+                    m_pacer.Reset();
+                    // Do not try to simulate the time spent minimized
+                    m_timer.ResetElapsedTime();
                 }
                 Renderer::OnResize(w, h);
             }
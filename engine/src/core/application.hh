@@ -4,11 +4,23 @@
 #include "events.hh"
 #include "platform/platform_timer.hh"
 #include "game_types.hh"
+#include "core/frame_pacer.hh"
+#include "renderer/vulkan/vulkan_backend.hh"
 #include <cstdint>
 
 struct Settings {
     bool enableValidation = false;
-    bool enableVsync = false;
+    PresentMode presentMode = PRESENT_MODE_FIFO;
+    double targetFrameRate = 0.0; // frames per second, 0 for no limit
+    double unfocusedFrameRate = 15.0; // frames per second while the window does not have focus, 0 for no change
+    uint32_t maxQueuedFrames = 2; // frames the CPU may run ahead of the GPU
+    double resizeDebounce = 0.0; // seconds a resize has to settle before the swapchain is rebuilt
+    bool renderThread = true;    // render on a separate thread while the next frame is simulated
+    bool lateLatch = true;       // sample the camera again right before each frame is submitted
+    uint32_t jobWorkers = 0;     // job system worker threads, 0 for one per core
+    bool pinJobWorkers = true;   // lock each job worker to its own core
+    double simulationRate = 60.0;   // fixed simulation steps per second, 0 for one variable step per frame
+    uint32_t maxSimulationSteps = 5; // steps one frame may run to catch up, the rest is dropped
 };
 
 class  QAPI Application {
@@ -31,6 +43,7 @@ class  QAPI Application {
         uint32_t m_height;
 
         StepTimer m_timer;
+        FramePacer m_pacer;
 
         uint64_t m_framecounter;
         char m_lastFPS[32]; // string to hold frames per second
@@ -0,0 +1,286 @@
+#pragma once
+/*
+ *  This file holds the asset cache
+ *
+ *  An AssetCache<T> owns every loaded asset of one type and hands out typed handles to them.
+ *  Assets are keyed by a 64 bit id, either the hash of their path (for assets loaded through the
+ *  file system) or the hash of their contents (for assets built in memory, like meshes). Asking
+ *  for an asset that is already known only bumps its reference count, so loading the same asset
+ *  twice is free.
+ *
+ *  Loads from the file system are asynchronous:
+ *      QUEUED -> LOADING (file is being read / decompressed off thread)
+ *             -> RESIDENT (the loader turned the file into a T on the main thread in Update)
+ *             -> FAILED (file missing or the loader rejected it)
+ *
+ *  Assets whose reference count drops to zero are not destroyed right away. They stay resident
+ *  and move to a least recently used list, and are only evicted once the resident size goes over
+ *  the memory budget. Acquiring them again before that brings them back for free.
+ */
+
+#include "stdafx.hh"
+#include "core/filesystem.hh"
+#include "core/hash.hh"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+enum AssetState {
+    ASSET_STATE_INVALID,
+    ASSET_STATE_QUEUED,
+    ASSET_STATE_LOADING,
+    ASSET_STATE_RESIDENT,
+    ASSET_STATE_FAILED,
+};
+
+// Typed reference to an asset owned by an AssetCache<T>
+template <typename T>
+struct AssetHandle {
+    uint64_t id = 0;
+
+    bool IsValid() const { return id != 0; }
+    bool operator==(const AssetHandle& other) const { return id == other.id; }
+    bool operator!=(const AssetHandle& other) const { return id != other.id; }
+};
+
+struct AssetCacheStats {
+    uint64_t hits = 0;          // requests served by an asset that was already known
+    uint64_t misses = 0;        // requests that had to load or create the asset
+    uint64_t evictions = 0;     // unreferenced assets destroyed to stay under budget
+    uint64_t residentBytes = 0;
+    uint32_t residentCount = 0;
+};
+
+template <typename T>
+class AssetCache {
+    public:
+        // Turns the contents of a file into an asset. Set bytes to the memory the asset holds
+        using LoadFunc = std::function<std::unique_ptr<T> (const FileData& file, size_t& bytes)>;
+        // Releases anything the asset holds outside of its own memory (ie GPU resources)
+        using UnloadFunc = std::function<void (T& asset)>;
+
+        AssetCache(LoadFunc loader = nullptr, UnloadFunc unloader = nullptr, uint64_t budgetBytes = UINT64_MAX)
+            : m_loader(loader), m_unloader(unloader), m_budget(budgetBytes) {}
+        ~AssetCache() { Clear(); }
+        AssetCache(const AssetCache&) = delete;
+        AssetCache& operator= (const AssetCache&) = delete;
+
+        // Request an asset from the file system. Returns immediately; the asset is
+        // resident once GetState reports ASSET_STATE_RESIDENT
+        AssetHandle<T> Load(const std::string& path) {
+            std::string normalized = FileSystem::NormalizePath(path);
+            AssetHandle<T> handle = { _make_id(HashString(normalized)) };
+            if (_acquire_existing(handle.id))
+                return handle;
+
+            Entry& entry = m_entries[handle.id];
+            entry.path = normalized;
+            entry.refs = 1;
+            entry.state = ASSET_STATE_QUEUED;
+            m_pending.push_back(handle.id);
+            return handle;
+        }
+
+        // Add an asset that was built in memory, keyed by a hash of its contents
+        // If an asset with the same key already exists, the new one is dropped and the
+        // existing one is returned instead
+        AssetHandle<T> Add(uint64_t contentHash, std::unique_ptr<T> asset, size_t bytes) {
+            AssetHandle<T> handle = { _make_id(contentHash) };
+            if (_acquire_existing(handle.id)) {
+                if (asset && m_unloader)
+                    m_unloader(*asset);
+                return handle;
+            }
+
+            Entry& entry = m_entries[handle.id];
+            entry.refs = 1;
+            _make_resident(entry, std::move(asset), bytes);
+            _evict();
+            return handle;
+        }
+
+        // Same as Add, but the asset is only built when the key is not already cached
+        AssetHandle<T> FindOrCreate(uint64_t contentHash, const std::function<std::unique_ptr<T> (size_t& bytes)>& create) {
+            AssetHandle<T> handle = { _make_id(contentHash) };
+            if (_acquire_existing(handle.id))
+                return handle;
+
+            size_t bytes = 0;
+            std::unique_ptr<T> asset = create(bytes);
+            Entry& entry = m_entries[handle.id];
+            entry.refs = 1;
+            _make_resident(entry, std::move(asset), bytes);
+            _evict();
+            return handle;
+        }
+
+        // Add a reference to an asset the caller already has a handle to
+        void Acquire(AssetHandle<T> handle) {
+            auto it = m_entries.find(handle.id);
+            if (it == m_entries.end())
+                return;
+            if (it->second.refs++ == 0 && it->second.inLru) {
+                m_lru.erase(it->second.lruIt);
+                it->second.inLru = false;
+            }
+        }
+
+        // Drop a reference. Unreferenced assets stay cached until they are evicted
+        void Release(AssetHandle<T> handle) {
+            auto it = m_entries.find(handle.id);
+            if (it == m_entries.end() || it->second.refs == 0)
+                return;
+
+            if (--it->second.refs == 0)
+                _unreferenced(it);
+        }
+
+        // Returns the asset if it is resident, nullptr otherwise
+        T* Get(AssetHandle<T> handle) {
+            auto it = m_entries.find(handle.id);
+            if (it == m_entries.end() || it->second.state != ASSET_STATE_RESIDENT)
+                return nullptr;
+            return it->second.asset.get();
+        }
+
+        AssetState GetState(AssetHandle<T> handle) const {
+            auto it = m_entries.find(handle.id);
+            return it == m_entries.end() ? ASSET_STATE_INVALID : it->second.state;
+        }
+
+        // Advance pending loads. Must be called from the thread that owns the assets
+        // (the loader may create GPU resources)
+        void Update() {
+            for (size_t i = 0; i < m_pending.size();) {
+                auto it = m_entries.find(m_pending[i]);
+                if (it == m_entries.end()) {
+                    m_pending.erase(m_pending.begin() + i);
+                    continue;
+                }
+
+                Entry& entry = it->second;
+                if (entry.state == ASSET_STATE_QUEUED) {
+                    entry.pendingFile = FileSystem::ReadAsync(entry.path);
+                    entry.state = ASSET_STATE_LOADING;
+                }
+
+                if (entry.pendingFile.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    i++;
+                    continue;
+                }
+
+                FileData file = entry.pendingFile.get();
+                size_t bytes = file.Size();
+                std::unique_ptr<T> asset = (file.IsValid() && m_loader) ? m_loader(file, bytes) : nullptr;
+                if (asset) {
+                    _make_resident(entry, std::move(asset), bytes);
+                } else {
+                    std::cerr << "Error: failed to load asset " << entry.path << std::endl;
+                    entry.state = ASSET_STATE_FAILED;
+                }
+
+                m_pending.erase(m_pending.begin() + i);
+
+                // Everyone let go of it while it was loading
+                if (entry.refs == 0)
+                    _unreferenced(it);
+            }
+
+            _evict();
+        }
+
+        void SetBudget(uint64_t budgetBytes) { m_budget = budgetBytes; _evict(); }
+        const AssetCacheStats& GetStats() const { return m_stats; }
+
+        // Destroy every asset regardless of references
+        void Clear() {
+            for (auto& it : m_entries) {
+                if (it.second.state == ASSET_STATE_LOADING)
+                    it.second.pendingFile.wait();
+                if (it.second.asset && m_unloader)
+                    m_unloader(*it.second.asset);
+            }
+            m_entries.clear();
+            m_lru.clear();
+            m_pending.clear();
+            m_stats.residentBytes = 0;
+            m_stats.residentCount = 0;
+        }
+
+    private:
+        struct Entry {
+            std::unique_ptr<T> asset;
+            std::string path;
+            AssetState state = ASSET_STATE_INVALID;
+            uint32_t refs = 0;
+            size_t bytes = 0;
+            std::future<FileData> pendingFile;
+            typename std::list<uint64_t>::iterator lruIt;
+            bool inLru = false;
+        };
+
+        // 0 is reserved for invalid handles
+        static uint64_t _make_id(uint64_t hash) { return hash == 0 ? 1 : hash; }
+
+        bool _acquire_existing(uint64_t id) {
+            if (m_entries.find(id) == m_entries.end()) {
+                m_stats.misses++;
+                return false;
+            }
+            m_stats.hits++;
+            Acquire(AssetHandle<T>{ id });
+            return true;
+        }
+
+        // Resident assets are kept around for reuse, anything else is dropped
+        // Assets that are still loading are dealt with once the load finishes
+        void _unreferenced(typename std::unordered_map<uint64_t, Entry>::iterator it) {
+            Entry& entry = it->second;
+            if (entry.state == ASSET_STATE_RESIDENT) {
+                entry.lruIt = m_lru.insert(m_lru.end(), it->first);
+                entry.inLru = true;
+                _evict();
+            } else if (entry.state == ASSET_STATE_FAILED) {
+                m_entries.erase(it);
+            }
+        }
+
+        void _make_resident(Entry& entry, std::unique_ptr<T> asset, size_t bytes) {
+            entry.asset = std::move(asset);
+            entry.bytes = bytes;
+            entry.state = ASSET_STATE_RESIDENT;
+            m_stats.residentBytes += bytes;
+            m_stats.residentCount++;
+        }
+
+        // Destroy least recently released assets until we are back under budget
+        void _evict() {
+            while (m_stats.residentBytes > m_budget && !m_lru.empty()) {
+                auto it = m_entries.find(m_lru.front());
+                m_lru.pop_front();
+                if (it == m_entries.end())
+                    continue;
+
+                Entry& entry = it->second;
+                if (m_unloader)
+                    m_unloader(*entry.asset);
+                m_stats.residentBytes -= entry.bytes;
+                m_stats.residentCount--;
+                m_stats.evictions++;
+                m_entries.erase(it);
+            }
+        }
+
+        LoadFunc m_loader;
+        UnloadFunc m_unloader;
+        uint64_t m_budget;
+
+        std::unordered_map<uint64_t, Entry> m_entries;
+        std::list<uint64_t> m_lru;          // unreferenced resident assets, oldest first
+        std::vector<uint64_t> m_pending;    // queued or loading assets
+        AssetCacheStats m_stats;
+};
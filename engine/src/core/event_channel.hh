@@ -0,0 +1,129 @@
+#pragma once
+/*
+ *  This file holds typed event channels
+ *
+ *  An EventChannel<E> carries one event type E, which is any struct. Listeners are a plain
+ *  function pointer plus a context pointer, kept in two fixed size arrays, so registering
+ *  never allocates and firing is a loop of direct calls with the event passed by reference.
+ *  Compare EventHandler, where every listener is a std::function and every payload has to
+ *  fit in the 16 bytes of EventContext.
+ *
+ *  Like EventHandler::Fire, channels are fired and listened to on the main thread only, and
+ *  a listener that returns true stops the event from reaching the ones after it.
+ *
+ *  Each event type gets its own static listener table. On Windows that table is per module,
+ *  so fire and listen from the same side of the engine DLL.
+ */
+
+#include "stdafx.hh"
+#include <cstdint>
+
+// Listeners one channel can hold
+#define EVENT_CHANNEL_CAPACITY 128
+
+template <typename E>
+class EventChannel {
+    public:
+        using ListenerFunc = bool (*)(void* context, const E& event);
+
+        // The same func/context pair is only registered once
+        // Returns false if it already is, or the channel is full
+        static bool Register(ListenerFunc func, void* context = nullptr) {
+            Table& table = _table();
+            if (table.count == EVENT_CHANNEL_CAPACITY || _find(func, context) != UINT32_MAX)
+                return false;
+
+            table.funcs[table.count] = func;
+            table.contexts[table.count] = context;
+            table.count++;
+            return true;
+        }
+
+        // Register object->Method(event)
+        template <typename T, bool (T::*Method)(const E&)>
+        static bool Register(T* object) {
+            return Register(&_call_member<T, Method>, object);
+        }
+
+        // Safe from inside a listener: the slot is cleared now and compacted after the fire
+        static bool Unregister(ListenerFunc func, void* context = nullptr) {
+            Table& table = _table();
+            uint32_t index = _find(func, context);
+            if (index == UINT32_MAX)
+                return false;
+
+            table.funcs[index] = nullptr;
+            table.removed = true;
+            if (table.firing == 0)
+                _compact(table);
+            return true;
+        }
+
+        template <typename T, bool (T::*Method)(const E&)>
+        static bool Unregister(T* object) {
+            return Unregister(&_call_member<T, Method>, object);
+        }
+
+        // Returns true if a listener handled the event
+        // Listeners registered while firing get the next event, not this one
+        static bool Fire(const E& event) {
+            Table& table = _table();
+            uint32_t count = table.count;
+            bool handled = false;
+
+            table.firing++;
+            for (uint32_t i = 0; i < count; i++) {
+                ListenerFunc func = table.funcs[i];
+                if (func && func(table.contexts[i], event)) {
+                    handled = true;
+                    break;
+                }
+            }
+            if (--table.firing == 0 && table.removed)
+                _compact(table);
+            return handled;
+        }
+
+        static uint32_t GetListenerCount() { return _table().count; }
+
+    private:
+        struct Table {
+            ListenerFunc funcs[EVENT_CHANNEL_CAPACITY];
+            void* contexts[EVENT_CHANNEL_CAPACITY];
+            uint32_t count = 0;
+            uint32_t firing = 0; // nested Fire calls in progress
+            bool removed = false;
+        };
+
+        static Table& _table() { return s_table; }
+
+        static inline Table s_table = {};
+
+        static uint32_t _find(ListenerFunc func, void* context) {
+            Table& table = _table();
+            for (uint32_t i = 0; i < table.count; i++) {
+                if (table.funcs[i] == func && table.contexts[i] == context)
+                    return i;
+            }
+            return UINT32_MAX;
+        }
+
+        // Close the gaps left by Unregister, keeping the order listeners registered in
+        static void _compact(Table& table) {
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < table.count; i++) {
+                if (table.funcs[i]) {
+                    table.funcs[kept] = table.funcs[i];
+                    table.contexts[kept] = table.contexts[i];
+                    kept++;
+                }
+            }
+            table.count = kept;
+            table.removed = false;
+        }
+
+        template <typename T, bool (T::*Method)(const E&)>
+        static bool _call_member(void* object, const E& event) {
+            return (static_cast<T*>(object)->*Method)(event);
+        }
+};
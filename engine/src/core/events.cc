@@ -1,96 +1,321 @@
 #include "events.hh"
 
+#include <chrono>
+
 static EventState event_state = {};
 
+static void _reset_queue();
+static void _reset_registered();
+static EventCodeEntry* _find_entry(uint16_t code);
+static bool _add_listener(uint16_t code, void* listener, const CallbackFunc& callback);
+static void _remove_listener(EventCodeEntry& entry, size_t index);
+static void _flush_deferred();
+
 bool EventHandler::Startup() {
     if (event_state.initialized)
         return false;
 
-    for (size_t i = 0; i < MAX_MESSAGE_CODES; i++)
-        event_state.registered[i].events.clear();
+    _reset_registered();
+    _reset_queue();
 
     event_state.initialized = true;
     return true;
 }
 
 void EventHandler::Shutdown() {
-    for (size_t i = 0; i < MAX_MESSAGE_CODES; i++) {
-        event_state.registered[i].events.clear();
-    }
+    _reset_registered();
+    // Anything still queued is dropped
+    _reset_queue();
 
     event_state.initialized = false;
 }
 
 // Registers to listen to events that are sent with the specified code
 // listener/callback combos won't be registered twice, and will return 'false' if that is attempted
+// While an event is firing the listener is only added once the outermost Fire returns, so
+// it gets the next event rather than this one
 bool EventHandler::Register(
         uint16_t code,
         void* listener,
         CallbackFunc callback
         ) {
-    // Check if the listener has already been registered
-    size_t registered_count = event_state.registered[code].events.size();
-    for (size_t i = 0; i < registered_count; i++) {
-        if (event_state.registered[code].events[i].listener == listener)
+    if (code >= MAX_MESSAGE_CODES || !callback)
+        return false;
+
+    if (event_state.firing == 0)
+        return _add_listener(code, listener, callback);
+
+    EventCodeEntry* entry = _find_entry(code);
+    if (entry != nullptr && entry->slots.count(listener))
+        return false;
+    for (const auto& pending : event_state.pending) {
+        if (pending.first == code && pending.second.listener == listener)
             return false;
     }
 
-    // Proceed with registration since it has not been registered yet
     RegisteredEvent event = {};
     event.listener = listener;
-    event.callback = callback;
-    event_state.registered[code].events.push_back(event);
+    event.callback = std::move(callback);
+    event_state.pending.push_back({ code, std::move(event) });
     return true;
 }
 
 // Unregister an event with the specified code from the listener
-// bool Unregister(uint16_t code, void* listener, PFN_on_event on_event);
-// bool Unregister(uint16_t code, void* listener, bool (T::*)(uint16_t, void*, void*, EventContext));
+// The last listener of the code takes its place, so listeners are not called in the order
+// they registered in
 bool EventHandler::Unregister(
         uint16_t code,
         void* listener
         ) {
-    // Check that the listener is actually registered for the event
-    if (event_state.registered[code].events.size() == 0)
-        return false;
-
-    // Iterate through the list of listeners registered for the event
-    // and check if both the listener and the specified callback function
-    // match. If they match, remove the listener from the vector
-    // Removing element from vector at an index is obviously not efficient, but for
-    // the sake of prototyping this is fine for now. Also there are not too many elements
-    // that would be registered for an event, so even in worst case it is not that bad
-    size_t registered_count = event_state.registered[code].events.size();
-    for (size_t i = 0; i < registered_count; i++) {
-        RegisteredEvent ev = event_state.registered[code].events[i];
-        if (ev.listener == listener) {
-            event_state.registered[code].events.erase(event_state.registered[code].events.begin() + i);
+    // Registered during the Fire in progress, and not added yet
+    std::vector<std::pair<uint16_t, RegisteredEvent> >& pending = event_state.pending;
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i].first == code && pending[i].second.listener == listener) {
+            pending.erase(pending.begin() + i);
             return true;
         }
     }
 
-    return false;
+    EventCodeEntry* entry = _find_entry(code);
+    if (entry == nullptr)
+        return false;
+
+    auto slot = entry->slots.find(listener);
+    if (slot == entry->slots.end())
+        return false;
+
+    size_t index = slot->second;
+    entry->slots.erase(slot);
+    if (event_state.firing > 0) {
+        // Moving listeners around would make the Fire in progress skip one, and the
+        // callback may be the one running, so it is only marked and removed once Fire returns
+        entry->events[index].removed = true;
+        event_state.removed = true;
+    } else {
+        _remove_listener(*entry, index);
+    }
+    return true;
 }
 
 // Fire an event with the input code
 // If the handler returns true, the event is considered handled
 // If not, the handler passes on to any more listeners
+// Listeners are added and removed only once the outermost Fire returns, so they are called
+// in place: nothing moves while a callback runs
 bool EventHandler::Fire(uint16_t code, void* sender, EventContext context) {
-    if (event_state.registered[code].events.size() == 0) {
+    EventCodeEntry* entry = _find_entry(code);
+    if (entry == nullptr || entry->events.empty()) {
         return false;
     }
 
-    for (size_t i = 0; i < event_state.registered[code].events.size(); i++) {
-        RegisteredEvent ev = event_state.registered[code].events[i];
-        auto func = ev.callback;
-        if (ev.callback(code, sender, ev.listener, context)) {
+    const std::vector<RegisteredEvent>& events = entry->events;
+    bool handled = false;
+
+    event_state.firing++;
+    for (size_t i = 0; i < events.size(); i++) {
+        const RegisteredEvent& ev = events[i];
+        if (!ev.removed && ev.callback(code, sender, ev.listener, context)) {
             // message was handled if callback returned true
-            return true;
+            handled = true;
+            break;
+        }
+    }
+    if (--event_state.firing == 0 && (event_state.removed || !event_state.pending.empty()))
+        _flush_deferred();
+
+    return handled;
+}
+
+bool EventHandler::Post(uint16_t code, void* sender, EventContext context) {
+    EventQueue& queue = event_state.queue;
+    uint64_t position = queue.tail.load(std::memory_order_relaxed);
+    QueuedEvent* slot = nullptr;
+    for (;;) {
+        slot = &queue.slots[position & (EVENT_QUEUE_SIZE - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0) {
+            // The slot is free for this position, claim it
+            if (queue.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            // The slot still holds the event from a lap ago, the queue is full
+            event_state.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            // Another producer took this position
+            position = queue.tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->code = code;
+    slot->sender = sender;
+    slot->context = context;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Events are copied out in batches and their slots handed back before any callback runs,
+// so producers are never held up by a slow listener
+void EventHandler::DispatchQueued() {
+    auto start = std::chrono::steady_clock::now();
+    EventQueue& queue = event_state.queue;
+    EventQueueStats& stats = event_state.stats;
+
+    uint64_t end = queue.tail.load(std::memory_order_acquire);
+    stats.depth = static_cast<uint32_t>(end - queue.head);
+    stats.maxDepth = std::max(stats.maxDepth, stats.depth);
+
+    struct {
+        uint16_t code;
+        void* sender;
+        EventContext context;
+    } events[EVENT_DISPATCH_BATCH];
+
+    while (queue.head < end) {
+        uint32_t count = 0;
+        while (count < EVENT_DISPATCH_BATCH && queue.head < end) {
+            QueuedEvent& slot = queue.slots[queue.head & (EVENT_QUEUE_SIZE - 1)];
+            // Claimed but not written yet, it goes out with the next dispatch
+            if (slot.sequence.load(std::memory_order_acquire) != queue.head + 1) {
+                end = queue.head;
+                break;
+            }
+            events[count].code = slot.code;
+            events[count].sender = slot.sender;
+            events[count].context = slot.context;
+            count++;
+            slot.sequence.store(queue.head + EVENT_QUEUE_SIZE, std::memory_order_release);
+            queue.head++;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            Fire(events[i].code, events[i].sender, events[i].context);
         }
+        stats.dispatched += count;
     }
 
-    return false;
+    stats.dispatchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.averageDispatchSeconds = (stats.averageDispatchSeconds == 0.0)
+        ? stats.dispatchSeconds
+        : stats.averageDispatchSeconds * 0.9 + stats.dispatchSeconds * 0.1;
+}
+
+EventQueueStats EventHandler::GetQueueStats() {
+    EventQueueStats stats = event_state.stats;
+    stats.dropped = event_state.dropped.load(std::memory_order_relaxed);
+    stats.posted = event_state.queue.tail.load(std::memory_order_relaxed);
+    return stats;
 }
 
 // Accessors
 bool EventHandler::GetInitialized() { return event_state.initialized; }
+
+//
+// PRIVATE
+//
+
+// Every slot starts out free for the position of the first lap
+static void
+_reset_queue() {
+    EventQueue& queue = event_state.queue;
+    for (uint64_t i = 0; i < EVENT_QUEUE_SIZE; i++) {
+        queue.slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    queue.tail.store(0, std::memory_order_relaxed);
+    queue.head = 0;
+    event_state.dropped.store(0, std::memory_order_relaxed);
+    event_state.stats = {};
+}
+
+// Only touches the pages that were used, never the whole code space
+static void
+_reset_registered() {
+    for (size_t i = 0; i < MAX_MESSAGE_CODES / EVENT_CODE_PAGE_SIZE; i++) {
+        event_state.pages[i].reset();
+    }
+    event_state.registered.clear();
+    event_state.registered.shrink_to_fit();
+    event_state.pending.clear();
+    event_state.firing = 0;
+    event_state.removed = false;
+}
+
+// Returns nullptr if the code never had a listener
+static EventCodeEntry*
+_find_entry(uint16_t code) {
+    if (code >= MAX_MESSAGE_CODES)
+        return nullptr;
+
+    const std::unique_ptr<uint16_t[]>& page = event_state.pages[code / EVENT_CODE_PAGE_SIZE];
+    if (!page)
+        return nullptr;
+
+    uint16_t index = page[code % EVENT_CODE_PAGE_SIZE];
+    return (index == EVENT_CODE_NONE) ? nullptr : &event_state.registered[index];
+}
+
+// Returns false if the listener already is registered for the code
+static bool
+_add_listener(uint16_t code, void* listener, const CallbackFunc& callback) {
+    EventCodeEntry* entry = _find_entry(code);
+    if (entry == nullptr) {
+        // First listener of this code, give it an entry
+        std::unique_ptr<uint16_t[]>& page = event_state.pages[code / EVENT_CODE_PAGE_SIZE];
+        if (!page) {
+            page.reset(new uint16_t[EVENT_CODE_PAGE_SIZE]);
+            std::fill(page.get(), page.get() + EVENT_CODE_PAGE_SIZE, EVENT_CODE_NONE);
+        }
+        page[code % EVENT_CODE_PAGE_SIZE] = static_cast<uint16_t>(event_state.registered.size());
+        event_state.registered.push_back({ code, {}, {} });
+        entry = &event_state.registered.back();
+    }
+
+    // Check if the listener has already been registered
+    if (entry->slots.count(listener))
+        return false;
+
+    RegisteredEvent event = {};
+    event.listener = listener;
+    event.callback = callback;
+    entry->slots[listener] = static_cast<uint32_t>(entry->events.size());
+    entry->events.push_back(event);
+    return true;
+}
+
+// Swap with the last listener and pop, nothing after it has to move
+// A removed listener is no longer in slots (and may have registered again elsewhere), so
+// only one that is not removed gets its slot updated when it moves
+static void
+_remove_listener(EventCodeEntry& entry, size_t index) {
+    std::vector<RegisteredEvent>& events = entry.events;
+    if (index != events.size() - 1) {
+        events[index] = std::move(events.back());
+        if (!events[index].removed)
+            entry.slots[events[index].listener] = static_cast<uint32_t>(index);
+    }
+    events.pop_back();
+}
+
+// Removes the listeners Unregister marked while an event was firing, then adds the ones
+// registered meanwhile, in the order they registered in
+static void
+_flush_deferred() {
+    if (event_state.removed) {
+        for (EventCodeEntry& entry : event_state.registered) {
+            for (size_t i = 0; i < entry.events.size();) {
+                if (!entry.events[i].removed)
+                    i++;
+                else
+                    _remove_listener(entry, i);
+            }
+        }
+        event_state.removed = false;
+    }
+
+    std::vector<std::pair<uint16_t, RegisteredEvent> > pending;
+    pending.swap(event_state.pending);
+    for (const auto& listener : pending) {
+        _add_listener(listener.first, listener.second.listener, listener.second.callback);
+    }
+}
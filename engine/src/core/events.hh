@@ -8,9 +8,20 @@
  */
 
 #include "stdafx.hh"
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 
 #define MAX_MESSAGE_CODES 16384
+// Codes are looked up in pages of this many, a page only exists once one of its codes has a listener
+#define EVENT_CODE_PAGE_SIZE 256
+// Page entry for a code nobody listens to
+#define EVENT_CODE_NONE 0xFFFF
+// Slots in the queue behind Post, must be a power of two
+#define EVENT_QUEUE_SIZE 4096
+// Queued events are copied out of the ring this many at a time before they are dispatched
+#define EVENT_DISPATCH_BATCH 256
 
 struct EventContext {
     union {
@@ -57,6 +68,9 @@ enum EventCodes {
     //        uint16_t width = data.u16[0];
     //        uint16_t height = data.u16[1];
     EVENT_CODE_RESIZED = 0x08,
+
+    // Usage: bool focused = data.u8[0];
+    EVENT_CODE_FOCUS_CHANGED = 0x09,
     
     MAX_EVENT_CODE = 0xFF
 };
@@ -69,31 +83,81 @@ struct RegisteredEvent {
     void* listener;
 
     CallbackFunc callback;
+    // Unregistered while an event was firing, skipped until the listener is swept out
+    bool removed = false;
     // bool (T::*callback)(uint16_t code, void* sender, void* listener, EventContext data);
 };
 
 // Holds a vector of registered events
+// Only codes that have had a listener get an entry
+// slots maps each listener that is not removed to its index in events, so finding one never scans
 struct EventCodeEntry {
-    
+    uint16_t code;
     std::vector <RegisteredEvent>  events;
+    std::unordered_map<void*, uint32_t> slots;
+};
+
+// An event waiting in the queue
+// sequence says whose turn the slot is: equal to the slot's position when a producer may
+// claim it, one past that once the event is written, and a lap further once it is consumed
+struct QueuedEvent {
+    std::atomic<uint64_t> sequence{0};
+    uint16_t code;
+    void* sender;
+    EventContext context;
+};
+
+// Bounded multi-producer, single-consumer ring
+// Producers claim a position by bumping tail, the main thread consumes from head
+struct EventQueue {
+    QueuedEvent slots[EVENT_QUEUE_SIZE];
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) uint64_t head = 0;
+};
+
+struct EventQueueStats {
+    uint64_t posted = 0;             // events that made it into the queue
+    uint64_t dispatched = 0;
+    uint64_t dropped = 0;            // posts that found the queue full
+    uint32_t depth = 0;              // events waiting when the last dispatch started
+    uint32_t maxDepth = 0;
+    double dispatchSeconds = 0.0;    // last DispatchQueued
+    double averageDispatchSeconds = 0.0;
 };
 
-// Holds an array of events
-// One for each event code
+// Holds the listeners of every code that has them
+// pages[code / EVENT_CODE_PAGE_SIZE][code % EVENT_CODE_PAGE_SIZE] is the code's index in
+// registered, so the memory used follows the codes in use rather than MAX_MESSAGE_CODES
 struct EventState {
-    EventCodeEntry registered[MAX_MESSAGE_CODES];
+    std::unique_ptr<uint16_t[]> pages[MAX_MESSAGE_CODES / EVENT_CODE_PAGE_SIZE];
+    std::vector<EventCodeEntry> registered;
+    uint32_t firing = 0;  // nested Fire calls in progress
+    bool removed = false; // listeners were unregistered while firing
+    // Listeners registered while firing, by code. Added once the outermost Fire returns, so
+    // no listener moves while its callback runs
+    std::vector<std::pair<uint16_t, RegisteredEvent> > pending;
+    EventQueue queue;
+    std::atomic<uint64_t> dropped{0};
+    EventQueueStats stats;
     bool initialized = false;
 };
 
 // static EventState event_state = {};
 
-class EventHandler {
+class QAPI EventHandler {
     public:
         static bool Startup();
         static void Shutdown();
         static bool Register(uint16_t code, void* listener, CallbackFunc callback);
         static bool Unregister(uint16_t code, void* listener);
         static bool Fire(uint16_t code, void* sender, EventContext context);
+        // Queue the event for the next DispatchQueued instead of firing it right away
+        // Safe from any thread. Returns false, and drops the event, if the queue is full
+        static bool Post(uint16_t code, void* sender, EventContext context);
+        // Fire the events that were queued before the call, in the order they were posted
+        // Main thread only. Events posted while this runs wait for the next call
+        static void DispatchQueued();
+        static EventQueueStats GetQueueStats();
         static bool GetInitialized();
 //        static bool Startup() {
 //            if (event_state.initialized)
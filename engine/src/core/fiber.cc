@@ -0,0 +1,199 @@
+#include "fiber.hh"
+
+#include <cstdint>
+
+#if defined(Q_PLATFORM_LINUX) && defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Defined in the assembly below
+extern "C" void _fiber_switch(void** from, void* to);
+extern "C" void _fiber_start();
+
+// System V x86-64. Only the callee-saved state has to survive a switch, since the
+// switch is a normal function call as far as the compiler is concerned: rbx, rbp, r12-r15,
+// the MXCSR and the x87 control word. Everything is pushed on the old stack and only the
+// stack pointer is stored, so a suspended fiber costs a single pointer
+//
+// Suspended stack, lowest address first:
+//   | mxcsr 4 | x87 cw 4 | r15 | r14 | r13 | r12 | rbx | rbp | return address |
+//
+// A new fiber starts with a made up frame that returns into _fiber_start with the entry
+// function in rbx and its argument in r12
+asm(R"(
+    .pushsection .text
+    .globl _fiber_switch
+    .hidden _fiber_switch
+    .type _fiber_switch, @function
+    .p2align 4
+_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size _fiber_switch, .-_fiber_switch
+
+    .globl _fiber_start
+    .hidden _fiber_start
+    .type _fiber_start, @function
+    .p2align 4
+_fiber_start:
+    movq %r12, %rdi
+    callq *%rbx
+    ud2
+    .size _fiber_start, .-_fiber_start
+    .popsection
+)");
+
+// Default MXCSR (all exceptions masked, round to nearest) and x87 control word
+#define FIBER_DEFAULT_MXCSR  0x1F80ull
+#define FIBER_DEFAULT_X87_CW 0x037Full
+
+bool
+Fiber::Create(size_t stackSize, EntryFunc entry, void* arg) {
+    Destroy();
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    stackSize = (stackSize + page - 1) & ~(page - 1);
+
+    // One extra page at the bottom is left inaccessible, so overflowing the stack faults
+    // right away instead of writing over whatever is mapped below it
+    void* memory = mmap(nullptr, stackSize + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (memory == MAP_FAILED)
+        return false;
+    mprotect(memory, page, PROT_NONE);
+    m_stack = memory;
+    m_stackSize = stackSize + page;
+
+    // _fiber_start is entered with a return, it needs the stack 16 byte aligned after that
+    // so that the call into entry sees the alignment the ABI promises
+    uintptr_t top = (reinterpret_cast<uintptr_t>(memory) + m_stackSize) & ~static_cast<uintptr_t>(15);
+    uint64_t* frame = reinterpret_cast<uint64_t*>(top);
+    frame[-1] = 0;
+    frame[-2] = 0;
+    frame[-3] = reinterpret_cast<uint64_t>(&_fiber_start); // return address
+    frame[-4] = 0;                                        // rbp, ends the frame chain for debuggers
+    frame[-5] = reinterpret_cast<uint64_t>(entry);        // rbx
+    frame[-6] = reinterpret_cast<uint64_t>(arg);          // r12
+    frame[-7] = 0;                                        // r13
+    frame[-8] = 0;                                        // r14
+    frame[-9] = 0;                                        // r15
+    frame[-10] = FIBER_DEFAULT_MXCSR | (FIBER_DEFAULT_X87_CW << 32);
+    m_context = &frame[-10];
+    return true;
+}
+
+void
+Fiber::Destroy() {
+    if (m_stack)
+        munmap(m_stack, m_stackSize);
+    m_stack = nullptr;
+    m_stackSize = 0;
+    m_context = nullptr;
+}
+
+bool
+Fiber::ConvertThread() {
+    // The thread's registers are saved into m_context the first time it switches away
+    m_converted = true;
+    return true;
+}
+
+void
+Fiber::RevertThread() {
+    m_converted = false;
+    m_context = nullptr;
+}
+
+void
+Fiber::SwitchTo(Fiber& target) {
+    _fiber_switch(&m_context, target.m_context);
+}
+
+bool
+Fiber::IsSupported() {
+    return true;
+}
+
+#elif defined(Q_PLATFORM_WINDOWS)
+
+bool
+Fiber::Create(size_t stackSize, EntryFunc entry, void* arg) {
+    Destroy();
+
+    m_entry = entry;
+    m_arg = arg;
+    m_context = CreateFiberEx(0, stackSize, 0, &Fiber::_windows_entry, this);
+    m_stackSize = stackSize;
+    return m_context != nullptr;
+}
+
+void
+Fiber::Destroy() {
+    if (m_context && !m_converted)
+        DeleteFiber(m_context);
+    m_context = nullptr;
+    m_stackSize = 0;
+}
+
+bool
+Fiber::ConvertThread() {
+    m_context = ConvertThreadToFiber(nullptr);
+    // Somebody else already made this thread a fiber, use theirs
+    if (!m_context && GetLastError() == ERROR_ALREADY_FIBER)
+        m_context = GetCurrentFiber();
+    m_converted = m_context != nullptr;
+    return m_converted;
+}
+
+void
+Fiber::RevertThread() {
+    if (m_converted)
+        ConvertFiberToThread();
+    m_converted = false;
+    m_context = nullptr;
+}
+
+void
+Fiber::SwitchTo(Fiber& target) {
+    SwitchToFiber(target.m_context);
+}
+
+bool
+Fiber::IsSupported() {
+    return true;
+}
+
+void CALLBACK
+Fiber::_windows_entry(void* param) {
+    Fiber* fiber = static_cast<Fiber*>(param);
+    fiber->m_entry(fiber->m_arg);
+}
+
+#else
+
+bool Fiber::Create(size_t, EntryFunc, void*) { return false; }
+void Fiber::Destroy() {}
+bool Fiber::ConvertThread() { return false; }
+void Fiber::RevertThread() {}
+void Fiber::SwitchTo(Fiber&) {}
+bool Fiber::IsSupported() { return false; }
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * fiber.hh
+ *
+ * Minimal user space threads for the job system.
+ *
+ * A fiber is a stack plus the registers needed to resume it. Switching between fibers
+ * saves the callee-saved registers of the running fiber on its own stack and loads the
+ * other fiber's, which is a handful of instructions and never enters the kernel.
+ *
+ * On x86-64 Linux the switch is hand written (see fiber.cc), on Windows it uses the
+ * system fiber API. Anywhere else fibers are not supported and the job system waits
+ * without them.
+*/
+
+#include "stdafx.hh"
+#include <cstddef>
+
+#if (defined(Q_PLATFORM_LINUX) && defined(__x86_64__)) || defined(Q_PLATFORM_WINDOWS)
+#define FIBERS_SUPPORTED 1
+#endif
+
+class Fiber {
+    public:
+        using EntryFunc = void (*)(void* arg);
+
+        Fiber() {}
+        ~Fiber() { Destroy(); }
+        Fiber(const Fiber&) = delete;
+        Fiber& operator= (const Fiber&) = delete;
+
+        // Allocate a stack that runs entry(arg) the first time the fiber is switched to
+        // entry must never return, it has to switch to another fiber instead
+        bool Create(size_t stackSize, EntryFunc entry, void* arg);
+        void Destroy();
+
+        // Make the calling thread's own stack a fiber, so it can be switched away from and
+        // resumed later. Threads have to do this before switching to any other fiber
+        bool ConvertThread();
+        void RevertThread();
+
+        // Suspend this fiber, which must be the one running, and resume target
+        // Returns when something switches back to this fiber, possibly on another thread
+        void SwitchTo(Fiber& target);
+
+        static bool IsSupported();
+
+    private:
+        // Saved stack pointer on Linux, fiber handle on Windows
+        void* m_context = nullptr;
+        void* m_stack = nullptr;
+        size_t m_stackSize = 0;
+        bool m_converted = false;
+
+#if defined(Q_PLATFORM_WINDOWS)
+        EntryFunc m_entry = nullptr;
+        void* m_arg = nullptr;
+        static void CALLBACK _windows_entry(void* param);
+#endif
+};
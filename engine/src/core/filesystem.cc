@@ -0,0 +1,334 @@
+#include "filesystem.hh"
+#include "core/hash.hh"
+#include "core/jobs.hh"
+#include "core/lz4.hh"
+#include "platform/platform.hh"
+
+#include <fstream>
+#include <memory>
+
+struct MountedPack {
+    std::string path;
+    MappedFile file;
+    const PackEntry* entries = nullptr;
+    uint32_t entryCount = 0;
+};
+
+struct FileSystemState {
+    std::string root;
+    bool allowLooseFiles = true;
+    std::vector<MountedPack> packs;
+    bool initialized = false;
+};
+
+static FileSystemState fs_state = {};
+
+//
+// FileData
+//
+
+FileData
+FileData::View(const uint8_t* data, size_t size) {
+    FileData file;
+    file.m_data = data;
+    file.m_size = size;
+    return file;
+}
+
+FileData
+FileData::Own(std::vector<uint8_t>&& buffer) {
+    FileData file;
+    file.m_storage = std::move(buffer);
+    file.m_data = file.m_storage.data();
+    file.m_size = file.m_storage.size();
+    return file;
+}
+
+//
+// Helpers
+//
+
+static std::string
+_loose_path(const std::string& path) {
+    return fs_state.root + "/" + path;
+}
+
+static bool
+_read_loose(const std::string& fullPath, FileData& out) {
+    std::ifstream is(fullPath, std::ios::binary | std::ios::in | std::ios::ate);
+    if (!is.is_open())
+        return false;
+
+    std::streamsize size = is.tellg();
+    if (size <= 0)
+        return false;
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(size));
+    is.seekg(0, std::ios::beg);
+    is.read(reinterpret_cast<char*>(buffer.data()), size);
+    if (!is)
+        return false;
+
+    out = FileData::Own(std::move(buffer));
+    return true;
+}
+
+static bool
+_loose_exists(const std::string& path) {
+    if (!fs_state.allowLooseFiles)
+        return false;
+
+    std::ifstream is(_loose_path(path), std::ios::binary | std::ios::in);
+    return is.is_open();
+}
+
+// Find an entry in the mounted packs. Newer mounts shadow older ones
+static const PackEntry*
+_find_entry(const std::string& path, const MountedPack** pack) {
+    uint64_t hash = HashString(path);
+    for (size_t i = fs_state.packs.size(); i > 0; i--) {
+        const MountedPack& p = fs_state.packs[i - 1];
+        const PackEntry* end = p.entries + p.entryCount;
+        const PackEntry* it = std::lower_bound(p.entries, end, hash, [](const PackEntry& e, uint64_t h) {
+            return e.pathHash < h;
+        });
+
+        if (it != end && it->pathHash == hash) {
+            *pack = &p;
+            return it;
+        }
+    }
+
+    return nullptr;
+}
+
+// Turn a pack entry into file data, decompressing if needed
+static bool
+_read_entry(const MountedPack& pack, const PackEntry& entry, FileData& out) {
+    const uint8_t* stored = pack.file.data + entry.offset;
+
+    if (!(entry.flags & PACK_ENTRY_LZ4)) {
+        out = FileData::View(stored, static_cast<size_t>(entry.size));
+        return true;
+    }
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(entry.size));
+    int64_t written = LZ4DecompressBlock(stored, static_cast<size_t>(entry.storedSize), buffer.data(), buffer.size());
+    if (written != static_cast<int64_t>(entry.size)) {
+        std::cerr << "Error: corrupt LZ4 entry in pack " << pack.path << std::endl;
+        return false;
+    }
+
+    out = FileData::Own(std::move(buffer));
+    return true;
+}
+
+//
+// FileSystem
+//
+
+bool
+FileSystem::Startup(const std::string& root, bool allowLooseFiles) {
+    if (fs_state.initialized)
+        return false;
+
+    fs_state.root = root;
+    fs_state.allowLooseFiles = allowLooseFiles;
+    fs_state.packs.clear();
+    fs_state.initialized = true;
+    return true;
+}
+
+void
+FileSystem::Shutdown() {
+    for (size_t i = 0; i < fs_state.packs.size(); i++) {
+        Platform::unmap_file(fs_state.packs[i].file);
+    }
+    fs_state.packs.clear();
+    fs_state.initialized = false;
+}
+
+bool
+FileSystem::MountPack(const std::string& packPath) {
+    MountedPack pack = {};
+    pack.path = packPath;
+    if (!Platform::map_file(packPath, pack.file))
+        return false;
+
+    // Validate the header and the table of contents before trusting any offsets
+    if (pack.file.data == nullptr || pack.file.size < sizeof(PackHeader)) {
+        std::cerr << "Error: " << packPath << " is not a valid pack file" << std::endl;
+        Platform::unmap_file(pack.file);
+        return false;
+    }
+
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(pack.file.data);
+    uint64_t tocSize = static_cast<uint64_t>(header->entryCount) * sizeof(PackEntry);
+    bool valid = memcmp(header->magic, PACK_MAGIC, 4) == 0
+        && header->version == PACK_VERSION
+        && header->tocOffset % alignof(PackEntry) == 0
+        && header->tocOffset <= pack.file.size
+        && tocSize <= pack.file.size - header->tocOffset;
+
+    if (valid) {
+        pack.entries = reinterpret_cast<const PackEntry*>(pack.file.data + header->tocOffset);
+        pack.entryCount = header->entryCount;
+        for (uint32_t i = 0; i < pack.entryCount && valid; i++) {
+            const PackEntry& e = pack.entries[i];
+            // A compressed entry cannot claim more than its block could ever expand to,
+            // so a corrupt size does not turn into a huge allocation in _read_entry
+            valid = e.offset <= header->tocOffset
+                && e.storedSize <= header->tocOffset - e.offset
+                && ((e.flags & PACK_ENTRY_LZ4)
+                    ? e.size <= e.storedSize * LZ4_MAX_RATIO + 16
+                    : e.storedSize == e.size);
+        }
+    }
+
+    if (!valid) {
+        std::cerr << "Error: " << packPath << " is not a valid pack file" << std::endl;
+        Platform::unmap_file(pack.file);
+        return false;
+    }
+
+    fs_state.packs.push_back(pack);
+    std::cout << "Mounted pack " << packPath << " [" << pack.entryCount << " entries]" << std::endl;
+    return true;
+}
+
+bool
+FileSystem::Exists(const std::string& path) {
+    std::string normalized = NormalizePath(path);
+    const MountedPack* pack = nullptr;
+    return _loose_exists(normalized) || _find_entry(normalized, &pack) != nullptr;
+}
+
+bool
+FileSystem::Read(const std::string& path, FileData& out) {
+    std::string normalized = NormalizePath(path);
+
+    if (fs_state.allowLooseFiles && _read_loose(_loose_path(normalized), out))
+        return true;
+
+    const MountedPack* pack = nullptr;
+    const PackEntry* entry = _find_entry(normalized, &pack);
+    if (entry)
+        return _read_entry(*pack, *entry, out);
+
+    return false;
+}
+
+std::future<FileData>
+FileSystem::ReadAsync(const std::string& path) {
+    std::string normalized = NormalizePath(path);
+
+    // Loose files have to go to disk
+    if (_loose_exists(normalized)) {
+        std::shared_ptr<std::promise<FileData> > result = std::make_shared<std::promise<FileData> >();
+        std::future<FileData> future = result->get_future();
+        JobSystem::Run([result, normalized]() {
+            FileData data;
+            _read_loose(_loose_path(normalized), data);
+            result->set_value(std::move(data));
+        });
+        return future;
+    }
+
+    const MountedPack* pack = nullptr;
+    const PackEntry* entry = _find_entry(normalized, &pack);
+
+    // Compressed entries are decompressed off the calling thread
+    if (entry && (entry->flags & PACK_ENTRY_LZ4)) {
+        std::shared_ptr<std::promise<FileData> > result = std::make_shared<std::promise<FileData> >();
+        std::future<FileData> future = result->get_future();
+        JobSystem::Run([result, pack, entry]() {
+            FileData data;
+            _read_entry(*pack, *entry, data);
+            result->set_value(std::move(data));
+        });
+        return future;
+    }
+
+    // Uncompressed entries (or missing files) are available right away
+    std::promise<FileData> ready;
+    FileData data;
+    if (entry)
+        _read_entry(*pack, *entry, data);
+    ready.set_value(std::move(data));
+    return ready.get_future();
+}
+
+bool
+FileSystem::WritePack(const std::string& packPath, const std::vector<std::string>& paths) {
+    std::ofstream os(packPath, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!os.is_open())
+        return false;
+
+    PackHeader header = {};
+    memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.alignment = PACK_DEFAULT_ALIGNMENT;
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<PackEntry> entries;
+    uint64_t offset = sizeof(header);
+    const char padding[PACK_DEFAULT_ALIGNMENT] = {};
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::string normalized = NormalizePath(paths[i]);
+        FileData data;
+        if (!_read_loose(_loose_path(normalized), data)) {
+            std::cerr << "Error: could not read " << normalized << " while building " << packPath << std::endl;
+            return false;
+        }
+
+        // Start each entry on an aligned offset so SPIR-V and vertex data can be used in place
+        uint64_t aligned = (offset + PACK_DEFAULT_ALIGNMENT - 1) & ~static_cast<uint64_t>(PACK_DEFAULT_ALIGNMENT - 1);
+        os.write(padding, static_cast<std::streamsize>(aligned - offset));
+        os.write(reinterpret_cast<const char*>(data.Data()), static_cast<std::streamsize>(data.Size()));
+
+        PackEntry entry = {};
+        entry.pathHash = HashString(normalized);
+        entry.offset = aligned;
+        entry.storedSize = data.Size();
+        entry.size = data.Size();
+        entry.flags = PACK_ENTRY_NONE;
+        entries.push_back(entry);
+
+        offset = aligned + data.Size();
+    }
+
+    // Table of contents goes at the end, sorted so lookups can binary search it
+    std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) {
+        return a.pathHash < b.pathHash;
+    });
+    for (size_t i = 1; i < entries.size(); i++) {
+        if (entries[i].pathHash == entries[i - 1].pathHash) {
+            std::cerr << "Error: duplicate or colliding path while building " << packPath << std::endl;
+            return false;
+        }
+    }
+
+    uint64_t tocOffset = (offset + alignof(PackEntry) - 1) & ~static_cast<uint64_t>(alignof(PackEntry) - 1);
+    os.write(padding, static_cast<std::streamsize>(tocOffset - offset));
+    os.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(PackEntry)));
+
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.tocOffset = tocOffset;
+    os.seekp(0, std::ios::beg);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    return static_cast<bool>(os);
+}
+
+// Paths are stored with forward slashes and without a leading "./"
+std::string
+FileSystem::NormalizePath(const std::string& path) {
+    std::string normalized = path;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+    while (normalized.rfind("./", 0) == 0)
+        normalized.erase(0, 2);
+    while (!normalized.empty() && normalized[0] == '/')
+        normalized.erase(0, 1);
+    return normalized;
+}
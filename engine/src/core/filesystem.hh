@@ -0,0 +1,100 @@
+#pragma once
+/*
+ *  This file holds the interface for the virtual file system
+ *
+ *  Assets are addressed by a path relative to the asset root (ie "shaders/vert/triangle.vert.spv").
+ *  A path is resolved by first looking for a loose file under the root (when loose files are allowed,
+ *  which lets you iterate on an asset without rebuilding a pack), and then by looking it up in the
+ *  mounted pack files, newest mount first.
+ *
+ *  Pack files are memory mapped. Uncompressed entries are handed out as views straight into the
+ *  mapping, so reading them costs no syscalls and no copies. Entries compressed with LZ4 are
+ *  decompressed into a buffer owned by the returned FileData.
+ *
+ *  Pack layout:
+ *      PackHeader
+ *      entry data, each entry starting on a multiple of PackHeader::alignment
+ *      PackEntry[entryCount] (the table of contents, sorted by path hash)
+ */
+
+#include "stdafx.hh"
+#include <future>
+
+#define PACK_MAGIC "QPAK"
+#define PACK_VERSION 1
+#define PACK_DEFAULT_ALIGNMENT 16
+
+enum PackEntryFlags : uint32_t {
+    PACK_ENTRY_NONE = 0x00,
+    PACK_ENTRY_LZ4  = 0x01, // entry data is a single LZ4 block
+};
+
+struct PackHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t tocOffset;
+};
+
+struct PackEntry {
+    uint64_t pathHash;   // HashString of the normalized path
+    uint64_t offset;     // offset of the data from the start of the pack
+    uint64_t storedSize; // size of the data in the pack
+    uint64_t size;       // size of the data once decompressed
+    uint32_t flags;      // PackEntryFlags
+    uint32_t reserved;
+};
+
+static_assert(sizeof(PackHeader) == 24, "PackHeader layout must not change");
+static_assert(sizeof(PackEntry) == 40, "PackEntry layout must not change");
+
+// The contents of a file read through the file system
+// Either a view into a mapped pack or a buffer that it owns
+class FileData {
+    public:
+        FileData() = default;
+        FileData(FileData&&) = default;
+        FileData& operator= (FileData&&) = default;
+        FileData(const FileData&) = delete;
+        FileData& operator= (const FileData&) = delete;
+
+        // Wrap memory that outlives this object (ie a mounted pack)
+        static FileData View(const uint8_t* data, size_t size);
+        // Take ownership of a buffer
+        static FileData Own(std::vector<uint8_t>&& buffer);
+
+        const uint8_t* Data() const { return m_data; }
+        size_t Size() const { return m_size; }
+        bool IsValid() const { return m_data != nullptr; }
+        bool IsView() const { return m_data != nullptr && m_storage.empty(); }
+
+    private:
+        std::vector<uint8_t> m_storage;
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+};
+
+class FileSystem {
+    public:
+        static bool Startup(const std::string& root, bool allowLooseFiles = true);
+        static void Shutdown();
+
+        // Mount a pack file. Packs mounted later take priority over earlier ones
+        // Mounting is expected to happen during startup, before reads are issued from other threads
+        static bool MountPack(const std::string& packPath);
+
+        static bool Exists(const std::string& path);
+
+        // Read a whole file. Returns false if the path could not be resolved or the data is corrupt
+        static bool Read(const std::string& path, FileData& out);
+
+        // Read a whole file, doing any IO and decompression in a job off the calling thread
+        // Uncompressed pack entries are resolved immediately and the future is already ready
+        static std::future<FileData> ReadAsync(const std::string& path);
+
+        // Build an uncompressed pack from loose files under the root
+        static bool WritePack(const std::string& packPath, const std::vector<std::string>& paths);
+
+        static std::string NormalizePath(const std::string& path);
+};
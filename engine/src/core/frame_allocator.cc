@@ -0,0 +1,71 @@
+#include "frame_allocator.hh"
+
+#include <cstdlib>
+
+static void* _heap_alloc(size_t size, size_t align);
+static void _heap_free(void* memory);
+
+void
+FrameAllocator::Initialize(size_t capacity) {
+    Destroy();
+    m_memory = static_cast<unsigned char*>(malloc(capacity));
+    m_capacity = m_memory ? capacity : 0;
+    m_used = 0;
+}
+
+void
+FrameAllocator::Destroy() {
+    Reset();
+    free(m_memory);
+    m_memory = nullptr;
+    m_capacity = 0;
+}
+
+void*
+FrameAllocator::Allocate(size_t size, size_t align) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_memory);
+    uintptr_t aligned = (base + m_used + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    size_t end = static_cast<size_t>(aligned - base) + size;
+    if (m_memory && end <= m_capacity) {
+        m_used = end;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void* memory = _heap_alloc(size, align);
+    m_overflow.push_back(memory);
+    return memory;
+}
+
+void
+FrameAllocator::Reset(FrameMark mark) {
+    for (size_t i = mark.overflow; i < m_overflow.size(); i++) {
+        _heap_free(m_overflow[i]);
+    }
+    if (mark.overflow < m_overflow.size())
+        m_overflow.resize(mark.overflow);
+    m_used = std::min(mark.used, m_used);
+}
+
+//
+// PRIVATE
+//
+
+static void*
+_heap_alloc(size_t size, size_t align) {
+    align = std::max(align, sizeof(void*));
+#if defined(Q_PLATFORM_WINDOWS)
+    return _aligned_malloc(size, align);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+#endif
+}
+
+static void
+_heap_free(void* memory) {
+#if defined(Q_PLATFORM_WINDOWS)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+ * frame_allocator.hh
+ *
+ * Linear scratch allocator. Allocating bumps an offset into one block, and everything
+ * allocated after a mark is released at once by going back to it, so there is nothing
+ * to free one by one.
+ *
+ * Requests that do not fit in the block fall back to the heap and are released by the
+ * same reset, so running out of scratch space costs speed but never fails.
+*/
+
+#include "stdafx.hh"
+#include <cstddef>
+
+struct FrameMark {
+    size_t used = 0;
+    size_t overflow = 0;
+};
+
+class FrameAllocator {
+    public:
+        FrameAllocator() {}
+        ~FrameAllocator() { Destroy(); }
+        FrameAllocator(const FrameAllocator&) = delete;
+        FrameAllocator& operator= (const FrameAllocator&) = delete;
+
+        void Initialize(size_t capacity);
+        void Destroy();
+
+        // align has to be a power of two
+        void* Allocate(size_t size, size_t align = 16);
+        template <typename T>
+        T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+        FrameMark GetMark() const { return { m_used, m_overflow.size() }; }
+        // Release everything allocated since mark
+        void Reset(FrameMark mark);
+        void Reset() { Reset(FrameMark{}); }
+
+        size_t GetUsed() const { return m_used; }
+        size_t GetCapacity() const { return m_capacity; }
+
+    private:
+        unsigned char* m_memory = nullptr;
+        size_t m_capacity = 0;
+        size_t m_used = 0;
+        std::vector<void*> m_overflow;
+};
@@ -0,0 +1,79 @@
+#include "frame_pacer.hh"
+#include <thread>
+
+// Bounds for the spin window
+#define FRAME_PACER_MIN_SPIN std::chrono::microseconds(200)
+#define FRAME_PACER_MAX_SPIN std::chrono::milliseconds(4)
+
+FramePacer::FramePacer()
+    : m_targetFps(0.0),
+    m_period(Clock::duration::zero()),
+    m_deadline(Clock::now()),
+    m_spinWindow(std::chrono::milliseconds(1)),
+    m_lastWait(0.0) {
+}
+
+void
+FramePacer::SetTargetFrameRate(double fps) {
+    m_targetFps = fps > 0.0 ? fps : 0.0;
+    m_period = (m_targetFps > 0.0)
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFps))
+        : Clock::duration::zero();
+    Reset();
+}
+
+void
+FramePacer::Reset() {
+    m_deadline = Clock::now() + m_period;
+}
+
+double
+FramePacer::GetIdleSeconds() const {
+    if (m_targetFps <= 0.0)
+        return 0.0;
+
+    Clock::duration idle = m_deadline - m_spinWindow - Clock::now();
+    return (idle > Clock::duration::zero()) ? std::chrono::duration<double>(idle).count() : 0.0;
+}
+
+void
+FramePacer::Wait() {
+    if (m_targetFps <= 0.0) {
+        m_lastWait = 0.0;
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    // Fell more than a frame behind, start over from now instead of
+    // running a burst of unthrottled frames to catch up
+    if (start > m_deadline + m_period) {
+        m_deadline = start;
+    }
+
+    // Sleep for the bulk of the wait
+    Clock::time_point wake = m_deadline - m_spinWindow;
+    if (start < wake) {
+        std::this_thread::sleep_until(wake);
+
+        // Widen the window quickly when a sleep overshoots, and narrow it slowly otherwise
+        Clock::duration late = Clock::now() - wake;
+        if (late > m_spinWindow)
+            m_spinWindow = late + late / 4;
+        else
+            m_spinWindow -= (m_spinWindow - late) / 16;
+
+        if (m_spinWindow < FRAME_PACER_MIN_SPIN)
+            m_spinWindow = FRAME_PACER_MIN_SPIN;
+        if (m_spinWindow > FRAME_PACER_MAX_SPIN)
+            m_spinWindow = FRAME_PACER_MAX_SPIN;
+    }
+
+    // Spin for the rest
+    while (Clock::now() < m_deadline) {
+        std::this_thread::yield();
+    }
+
+    m_lastWait = std::chrono::duration<double>(Clock::now() - start).count();
+    m_deadline += m_period;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.hh"
+#include <chrono>
+#include <cstdint>
+
+// Caps the frame rate of the main loop
+//
+// Sleeping alone is not precise enough to hit a frame time (the OS can wake us up a millisecond
+// or more late), and spinning alone burns a whole core. The pacer sleeps until shortly before
+// the deadline and spins for the rest. The spin window follows how late sleeps have actually
+// been waking up, so it stays small on systems with a precise scheduler.
+//
+// A loop that has something better to do than sleep (like waiting for input) can do that for
+// GetIdleSeconds first, and Wait then only spins the rest.
+class FramePacer {
+    public:
+        FramePacer();
+
+        // 0 disables the limit
+        void SetTargetFrameRate(double fps);
+        double GetTargetFrameRate() const { return m_targetFps; }
+
+        // Block until the next frame is due. Call once per frame
+        void Wait();
+
+        // How long the caller may block on something else before it has to call Wait
+        // 0 once the frame is (nearly) due, or without a limit
+        double GetIdleSeconds() const;
+
+        // Forget the schedule (ie after being suspended) so we do not rush to catch up
+        void Reset();
+
+        // Seconds spent waiting in the last call to Wait
+        double GetLastWaitSeconds() const { return m_lastWait; }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        double m_targetFps;
+        Clock::duration m_period;
+        Clock::time_point m_deadline;
+        Clock::duration m_spinWindow; // how long before the deadline we stop sleeping
+        double m_lastWait;
+};
@@ -0,0 +1,47 @@
+#pragma once
+/*
+ *  This file holds small hashing helpers used across the engine
+ *
+ *  These are FNV-1a 64-bit hashes. They are not cryptographic, but they are fast,
+ *  stable across runs and platforms, and good enough to key caches and look up
+ *  files by path
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define HASH_FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define HASH_FNV_PRIME        0x100000001b3ULL
+
+// Hash a block of memory
+// Pass a previous result as the seed to continue hashing across several blocks
+inline uint64_t
+Hash64(const void* data, size_t size, uint64_t seed = HASH_FNV_OFFSET_BASIS) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint64_t>(bytes[i]);
+        hash *= HASH_FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hash a string (the terminating null is not included)
+inline uint64_t
+HashString(const std::string& str, uint64_t seed = HASH_FNV_OFFSET_BASIS) {
+    return Hash64(str.data(), str.size(), seed);
+}
+
+// Hash a single trivially copyable value
+template <typename T>
+inline uint64_t
+HashValue(const T& value, uint64_t seed = HASH_FNV_OFFSET_BASIS) {
+    return Hash64(&value, sizeof(T), seed);
+}
+
+// Mix a second hash into the first
+inline uint64_t
+HashCombine(uint64_t hash, uint64_t other) {
+    return Hash64(&other, sizeof(other), hash);
+}
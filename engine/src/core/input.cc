@@ -1,6 +1,8 @@
 #include "input.hh"
 #include "core/events.hh"
 
+#include <chrono>
+
 // State for the input handler
 struct InputState {
     bool initialized = false;
@@ -11,6 +13,13 @@ struct InputState {
     KeyboardState keyboardPrev;
     MouseState mouseCurrent;
     MouseState mousePrev;
+
+    // Latest size from the platform that has not been fired yet
+    bool resizePending = false;
+    uint32_t resizeWidth = 0;
+    uint32_t resizeHeight = 0;
+    std::chrono::steady_clock::time_point resizeTime;
+    double resizeDebounce = 0.0;
 };
 
 static InputState input_state = {};
@@ -38,13 +47,42 @@ InputHandler::Update(double deltaTime) {
     input_state.mousePrev = input_state.mouseCurrent;
 }
 
+// Dragging a window edge sends a resize for every step of the drag, so only the latest
+// size is recorded here and FlushResize fires it once
 void
 InputHandler::ProcessResize(uint32_t w, uint32_t h) {
+    input_state.resizePending = true;
+    input_state.resizeWidth = w;
+    input_state.resizeHeight = h;
+    input_state.resizeTime = std::chrono::steady_clock::now();
+}
+
+bool
+InputHandler::FlushResize() {
+    if (!input_state.resizePending)
+        return false;
+
+    // Minimizing is applied right away so the application can suspend
+    bool minimized = input_state.resizeWidth == 0 || input_state.resizeHeight == 0;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - input_state.resizeTime).count();
+    if (!minimized && elapsed < input_state.resizeDebounce)
+        return false;
+
+    input_state.resizePending = false;
+
+    EventChannel<WindowResizedEvent>::Fire({ input_state.resizeWidth, input_state.resizeHeight });
+
     EventContext data = {};
-    data.u32[0] = static_cast<uint32_t>(w);
-    data.u32[1] = static_cast<uint32_t>(h);
+    data.u32[0] = input_state.resizeWidth;
+    data.u32[1] = input_state.resizeHeight;
 
     EventHandler::Fire(EVENT_CODE_RESIZED, nullptr, data);
+    return true;
+}
+
+void
+InputHandler::SetResizeDebounce(double seconds) {
+    input_state.resizeDebounce = seconds;
 }
 
 void
@@ -53,7 +91,8 @@ InputHandler::ProcessKey(Keys key, bool pressed) {
     if (input_state.keyboardCurrent.keys[key] != pressed) {
         input_state.keyboardCurrent.keys[key] = pressed;
 
-        // TODO: Fire an event for immediate processing
+        EventChannel<KeyEvent>::Fire({ key, pressed });
+
         EventContext data = {};
         data.u16[0] = static_cast<uint16_t>(key);
         EventHandler::Fire(
@@ -70,7 +109,8 @@ InputHandler::ProcessMouseMove(int32_t x, int32_t y) {
         input_state.mouseCurrent.x = x;
         input_state.mouseCurrent.y = y;
 
-        // TODO: fire an event
+        EventChannel<MouseMovedEvent>::Fire({ x, y });
+
         EventContext data = {};
         data.u16[0] = x;
         data.u16[1] = y;
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/events.hh"
+#include "core/event_channel.hh"
 #include "stdafx.hh"
 
 // For mouse buttons
@@ -144,6 +145,20 @@ enum Keys : int {
     KEYS_MAX_KEY
 };
 
+// Typed input events for EventChannel
+// Fired right before the matching event codes go to EventHandler
+struct KeyEvent {
+    Keys key;
+    bool pressed;
+};
+struct MouseMovedEvent {
+    int32_t x;
+    int32_t y;
+};
+struct WindowResizedEvent {
+    uint32_t width;
+    uint32_t height;
+};
 
 struct KeyboardState {
     bool keys[256] = { false };
@@ -169,6 +184,14 @@ class InputHandler {
         static void GetMousePosition(int32_t& x, int32_t& y);
         static void ProcessResize(uint32_t w, uint32_t h);
 
+        // Resizes are not fired as they arrive. The latest size is kept and EVENT_CODE_RESIZED
+        // is fired once from here, which the application calls at the start of each frame
+        // Returns true if the event was fired
+        static bool FlushResize();
+        // Wait until the window has not been resized for this long before firing
+        // 0 fires on the next flush (ie once per frame at most)
+        static void SetResizeDebounce(double seconds);
+
 
     private:
         // EventHandler &m_eventHandler;
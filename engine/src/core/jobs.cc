@@ -0,0 +1,742 @@
+#include "jobs.hh"
+#include "core/fiber.hh"
+#include "core/frame_allocator.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(Q_PLATFORM_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define JOB_NOINLINE __declspec(noinline)
+#else
+#define JOB_NOINLINE __attribute__((noinline))
+#endif
+
+// Times an idle worker looks for work before it goes to sleep
+#define JOB_SPIN_COUNT 256
+
+// Chase-Lev work-stealing deque with a fixed capacity
+// Only the owning thread calls Push and Pop, any thread may call Steal
+// (Le, Pop, Cohen, Nardelli - "Correct and Efficient Work-Stealing for Weak Memory Models")
+class JobQueue {
+    public:
+        bool Push(Job* job) {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            int64_t top = m_top.load(std::memory_order_acquire);
+            if (bottom - top >= JOB_QUEUE_SIZE)
+                return false;
+
+            m_jobs[bottom & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Job* Pop() {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom) {
+                // Empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = m_jobs[bottom & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+            if (top == bottom) {
+                // Last job, race the thieves for it
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job* Steal() {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+                return nullptr;
+
+            Job* job = m_jobs[top & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_acquire);
+            // Lost to the owner or another thief
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+        bool IsEmpty() const {
+            return m_top.load() >= m_bottom.load();
+        }
+
+    private:
+        // Thieves only touch top and the owner mostly touches bottom, keep them on separate lines
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Job*> m_jobs[JOB_QUEUE_SIZE];
+};
+
+// Jobs are allocated round robin from a per thread ring
+struct JobPool {
+    Job jobs[JOB_QUEUE_SIZE];
+    uint32_t next = 0;
+};
+
+// Counters are only written by their own thread, apart from the shared slot used by
+// threads outside the system
+struct alignas(64) JobThreadStats {
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> stolen{0};
+    std::atomic<uint64_t> inlined{0};
+    std::atomic<uint64_t> parked{0};
+    std::atomic<uint64_t> inlineWaits{0};
+};
+
+// A stack jobs run on, and the scratch memory that goes wherever the stack goes
+struct JobFiber {
+    Fiber fiber;
+    FrameAllocator allocator;
+    JobCounter* waitingOn = nullptr; // set while parked
+    int32_t pinnedThread = -1;       // only this thread may resume it, -1 for any thread
+};
+
+enum SwitchAction {
+    SWITCH_NONE,
+    SWITCH_PARK, // the old fiber waits for its counter
+    SWITCH_FREE, // the old fiber was only running the scheduler and goes back to the pool
+};
+
+struct JobThread {
+    // The stack the thread started on. Workers leave it right away when fibers are
+    // supported, the main thread runs on it and only leaves it to wait
+    JobFiber base;
+    JobFiber* current = nullptr;
+
+    // A fiber cannot park or free itself, something else could pick it up while it is
+    // still running on its stack. The switch records what should happen to it and the
+    // fiber that runs next does it
+    JobFiber* previous = nullptr;
+    SwitchAction action = SWITCH_NONE;
+};
+
+struct JobState {
+    std::atomic<bool> initialized{false};
+    std::atomic<bool> stopping{false};
+    uint32_t workerCount = 0;
+    bool fibers = false;
+    uint32_t fiberCount = 0;
+
+    // One per thread in the system, the main thread is 0 and workers are 1..workerCount
+    std::unique_ptr<JobQueue[]> queues;
+    std::unique_ptr<JobPool[]> pools;
+    std::unique_ptr<JobThread[]> threadStates;
+    // One more than queues, the last is shared by every thread outside the system
+    std::unique_ptr<JobThreadStats[]> stats;
+    std::vector<std::thread> threads;
+
+    // Jobs started by threads outside the system
+    std::mutex injectedLock;
+    std::deque<Job*> injected;
+    std::atomic<uint32_t> injectedCount{0};
+
+    std::unique_ptr<JobFiber[]> fiberPool;
+    std::mutex fiberLock;
+    std::vector<JobFiber*> freeFibers;
+
+    // Fibers parked on a counter, in the order they started waiting
+    std::mutex waitLock;
+    std::vector<JobFiber*> waiting;
+    std::atomic<uint32_t> waitingCount{0};
+
+    // Only used by workers that ran out of work
+    // Waking is skipped entirely while nobody is asleep
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<uint32_t> sleepers{0};
+};
+
+static JobState job_state;
+
+// Index of the calling thread in the system, -1 for threads outside it
+static thread_local int32_t t_thread_index = -1;
+static thread_local uint32_t t_steal_seed = 0;
+// Scratch memory for jobs run by threads outside the system
+static thread_local FrameAllocator t_scratch;
+
+static int32_t _thread_index();
+static FrameAllocator& _current_allocator();
+static JobThreadStats& _thread_stats();
+static void _switch(JobFiber* from, JobFiber* to, SwitchAction action);
+static void _finish_switch();
+static JobFiber* _acquire_fiber();
+static void _release_fiber(JobFiber* fiber);
+static JobFiber* _take_ready(int32_t index);
+static bool _has_ready(int32_t index);
+static bool _has_work(int32_t index);
+static void _cpu_pause();
+static void _wake_one();
+static void _wake_all();
+static void _pin_thread(std::thread& thread, uint32_t core);
+
+bool
+JobSystem::Startup(uint32_t workerCount, bool pinThreads) {
+    if (job_state.initialized.load())
+        return false;
+
+    uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    if (workerCount == 0)
+        workerCount = cores - 1;
+    // At least one worker, so that jobs started by a thread that never waits still run
+    workerCount = std::min(std::max(workerCount, 1u), static_cast<uint32_t>(JOB_MAX_WORKERS));
+
+    uint32_t threadCount = workerCount + 1;
+    job_state.workerCount = workerCount;
+    job_state.queues.reset(new JobQueue[threadCount]);
+    job_state.pools.reset(new JobPool[threadCount]);
+    job_state.threadStates.reset(new JobThread[threadCount]);
+    job_state.stats.reset(new JobThreadStats[threadCount + 1]);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        JobThread& thread = job_state.threadStates[i];
+        thread.base.allocator.Initialize(JOB_FRAME_ALLOCATOR_SIZE);
+        thread.base.pinnedThread = static_cast<int32_t>(i);
+        thread.current = &thread.base;
+    }
+
+    // Every worker needs a fiber to start on, the rest are for jobs that wait
+    job_state.fibers = Fiber::IsSupported() && JOB_FIBER_COUNT > threadCount
+        && job_state.threadStates[0].base.fiber.ConvertThread();
+    if (job_state.fibers) {
+        job_state.fiberPool.reset(new JobFiber[JOB_FIBER_COUNT]);
+        for (uint32_t i = 0; i < JOB_FIBER_COUNT; i++) {
+            JobFiber& fiber = job_state.fiberPool[i];
+            if (!fiber.fiber.Create(JOB_FIBER_STACK_SIZE, &JobSystem::_fiber_main, nullptr))
+                continue;
+            fiber.allocator.Initialize(JOB_FRAME_ALLOCATOR_SIZE);
+            job_state.freeFibers.push_back(&fiber);
+        }
+        job_state.fiberCount = static_cast<uint32_t>(job_state.freeFibers.size());
+    }
+
+    job_state.stopping.store(false);
+    job_state.initialized.store(true);
+    t_thread_index = 0;
+
+    // The main thread is left free to move, workers take the other cores
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        job_state.threads.emplace_back(&JobSystem::_worker_main, i);
+        if (pinThreads && cores > 1)
+            _pin_thread(job_state.threads.back(), i % cores);
+    }
+
+    std::cout << "Job system started: [" << workerCount << " workers, "
+        << job_state.fiberCount << " fibers]" << std::endl;
+    return true;
+}
+
+void
+JobSystem::Shutdown() {
+    if (!job_state.initialized.load())
+        return;
+
+    std::cout << "Destroying job system...";
+    job_state.stopping.store(true);
+    _wake_all();
+    for (size_t i = 0; i < job_state.threads.size(); i++) {
+        job_state.threads[i].join();
+    }
+    job_state.threads.clear();
+
+    // Workers only leave once they find nothing left, but the last jobs they ran may have
+    // queued more on this thread
+    while (_run_one()) {}
+
+    job_state.initialized.store(false);
+    if (job_state.fibers)
+        job_state.threadStates[0].base.fiber.RevertThread();
+    job_state.fibers = false;
+    job_state.fiberCount = 0;
+    job_state.freeFibers.clear();
+    job_state.fiberPool.reset();
+    job_state.queues.reset();
+    job_state.pools.reset();
+    job_state.threadStates.reset();
+    job_state.stats.reset();
+    job_state.workerCount = 0;
+    t_thread_index = -1;
+    std::cout << "destroyed" << std::endl;
+}
+
+bool
+JobSystem::GetInitialized() {
+    return job_state.initialized.load(std::memory_order_acquire);
+}
+
+uint32_t
+JobSystem::GetWorkerCount() {
+    return job_state.workerCount;
+}
+
+// Parks the calling fiber and lets the thread run other jobs on a fresh one. Whichever
+// thread finds the counter done first picks the fiber back up, so the caller may continue
+// on a different thread than it started on
+void
+JobSystem::Wait(JobCounter& counter) {
+    if (counter.IsDone())
+        return;
+
+    int32_t index = _thread_index();
+    if (job_state.fibers && index >= 0) {
+        JobFiber* next = _acquire_fiber();
+        if (next) {
+            JobFiber* self = job_state.threadStates[index].current;
+            self->waitingOn = &counter;
+            _thread_stats().parked.fetch_add(1, std::memory_order_relaxed);
+            _switch(self, next, SWITCH_PARK);
+            return;
+        }
+    }
+
+    // No fibers here (or none left), help in place instead
+    _thread_stats().inlineWaits.fetch_add(1, std::memory_order_relaxed);
+    _wait_inline(counter);
+}
+
+void*
+JobSystem::FrameAlloc(size_t size, size_t align) {
+    return _current_allocator().Allocate(size, align);
+}
+
+void
+JobSystem::ResetFrameAllocator() {
+    _current_allocator().Reset();
+}
+
+JobStats
+JobSystem::GetStats() {
+    JobStats stats = {};
+    if (!GetInitialized())
+        return stats;
+
+    stats.workers = job_state.workerCount;
+    stats.fibers = job_state.fiberCount;
+    for (uint32_t i = 0; i < job_state.workerCount + 2; i++) {
+        stats.executed += job_state.stats[i].executed.load(std::memory_order_relaxed);
+        stats.stolen += job_state.stats[i].stolen.load(std::memory_order_relaxed);
+        stats.inlined += job_state.stats[i].inlined.load(std::memory_order_relaxed);
+        stats.parked += job_state.stats[i].parked.load(std::memory_order_relaxed);
+        stats.inlineWaits += job_state.stats[i].inlineWaits.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+//
+// PRIVATE
+//
+
+// Take the next slot of the calling thread's pool
+// Slots are only reused once the job in them has finished. Falling back to the heap only
+// happens when a thread has JOB_QUEUE_SIZE jobs in flight, or for threads outside the system
+Job*
+JobSystem::_allocate() {
+    int32_t index = _thread_index();
+    if (index >= 0 && GetInitialized()) {
+        JobPool& pool = job_state.pools[index];
+        Job* job = &pool.jobs[pool.next++ & (JOB_QUEUE_SIZE - 1)];
+        if (!job->busy.load(std::memory_order_acquire)) {
+            job->busy.store(true, std::memory_order_relaxed);
+            job->heap = false;
+            return job;
+        }
+    }
+
+    Job* job = new Job();
+    job->heap = true;
+    return job;
+}
+
+void
+JobSystem::_submit(Job* job) {
+    if (!GetInitialized()) {
+        _execute(job);
+        return;
+    }
+
+    int32_t index = _thread_index();
+    if (index < 0) {
+        {
+            std::lock_guard<std::mutex> lock(job_state.injectedLock);
+            job_state.injected.push_back(job);
+        }
+        job_state.injectedCount.fetch_add(1);
+        _wake_one();
+        return;
+    }
+
+    if (!job_state.queues[index].Push(job)) {
+        // Deque is full, which means there is plenty of work queued already
+        _thread_stats().inlined.fetch_add(1, std::memory_order_relaxed);
+        _execute(job);
+        return;
+    }
+    _wake_one();
+}
+
+// The job may wait and come back on another thread, so the allocator is looked up once
+// up front: it belongs to the fiber, not to the thread
+void
+JobSystem::_execute(Job* job) {
+    JobCounter* counter = job->counter;
+    FrameAllocator& allocator = _current_allocator();
+    FrameMark mark = allocator.GetMark();
+
+    job->invoke(*job);
+
+    allocator.Reset(mark);
+    if (job->heap)
+        delete job;
+    else
+        job->busy.store(false, std::memory_order_release);
+
+    if (GetInitialized())
+        _thread_stats().executed.fetch_add(1, std::memory_order_relaxed);
+    if (!counter)
+        return;
+
+    // The counter can be gone as soon as it reaches zero, only the result may be used
+    bool last = counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    if (last && job_state.waitingCount.load() > 0)
+        _wake_all();
+}
+
+// Own deque first (newest job, still warm in cache), then jobs from outside the system,
+// then steal the oldest job of a random other thread
+bool
+JobSystem::_run_one() {
+    int32_t index = _thread_index();
+    uint32_t threadCount = job_state.workerCount + 1;
+
+    Job* job = nullptr;
+    if (index >= 0)
+        job = job_state.queues[index].Pop();
+
+    if (!job && job_state.injectedCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(job_state.injectedLock);
+        if (!job_state.injected.empty()) {
+            job = job_state.injected.front();
+            job_state.injected.pop_front();
+            job_state.injectedCount.fetch_sub(1);
+        }
+    }
+
+    if (!job) {
+        // xorshift, only used to spread thieves over the victims
+        uint32_t seed = t_steal_seed;
+        if (seed == 0)
+            seed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&t_steal_seed)) | 1;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        t_steal_seed = seed;
+
+        for (uint32_t i = 0; i < threadCount && !job; i++) {
+            uint32_t victim = (seed + i) % threadCount;
+            if (static_cast<int32_t>(victim) == index)
+                continue;
+            job = job_state.queues[victim].Steal();
+        }
+        if (job)
+            _thread_stats().stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!job)
+        return false;
+
+    _execute(job);
+    return true;
+}
+
+// Continue a parked fiber whose counter is done
+// Only called from the scheduler, so the fiber running it has nothing worth keeping and
+// goes back to the pool
+bool
+JobSystem::_resume_ready() {
+    if (!job_state.fibers || job_state.waitingCount.load(std::memory_order_acquire) == 0)
+        return false;
+
+    int32_t index = _thread_index();
+    JobThread& thread = job_state.threadStates[index];
+    // A thread's own stack is never given up
+    if (thread.current == &thread.base)
+        return false;
+
+    JobFiber* ready = _take_ready(index);
+    if (!ready)
+        return false;
+
+    _switch(thread.current, ready, SWITCH_FREE);
+    return true;
+}
+
+// Run jobs until the system stops
+void
+JobSystem::_schedule() {
+    uint32_t idle = 0;
+    while (true) {
+        if (_resume_ready() || _run_one()) {
+            idle = 0;
+            continue;
+        }
+        // Parked fibers still have to finish before the workers can leave
+        if (job_state.stopping.load(std::memory_order_acquire) && job_state.waitingCount.load() == 0)
+            return;
+        if (++idle < JOB_SPIN_COUNT) {
+            _cpu_pause();
+            continue;
+        }
+
+        // Sleepers register before they look for work, and _submit publishes a job before it
+        // looks for sleepers (both sequentially consistent), so either the sleeper sees the
+        // job or the submitter sees the sleeper
+        {
+            int32_t index = _thread_index();
+            std::unique_lock<std::mutex> lock(job_state.sleepLock);
+            job_state.sleepers.fetch_add(1);
+            job_state.wake.wait(lock, [index]() { return job_state.stopping.load() || _has_work(index); });
+            job_state.sleepers.fetch_sub(1);
+        }
+        idle = 0;
+    }
+}
+
+void
+JobSystem::_wait_inline(JobCounter& counter) {
+    uint32_t idle = 0;
+    while (!counter.IsDone()) {
+        if (_run_one()) {
+            idle = 0;
+            continue;
+        }
+
+        // Whatever is left is already running on other threads
+        if (++idle < JOB_SPIN_COUNT)
+            _cpu_pause();
+        else
+            std::this_thread::yield();
+    }
+}
+
+void
+JobSystem::_worker_main(uint32_t index) {
+    t_thread_index = static_cast<int32_t>(index);
+    JobThread& thread = job_state.threadStates[index];
+
+    // Jobs run on pool fibers. The thread's own stack only waits here until the scheduler
+    // on the fiber sees the system stopping and switches back
+    if (job_state.fibers && thread.base.fiber.ConvertThread()) {
+        JobFiber* fiber = _acquire_fiber();
+        if (fiber) {
+            _switch(&thread.base, fiber, SWITCH_NONE);
+            thread.base.fiber.RevertThread();
+            return;
+        }
+        thread.base.fiber.RevertThread();
+    }
+
+    _schedule();
+}
+
+void
+JobSystem::_fiber_main(void*) {
+    _finish_switch();
+    while (true) {
+        _schedule();
+
+        // Stopping, hand the thread back to its own stack
+        JobThread& thread = job_state.threadStates[_thread_index()];
+        _switch(thread.current, &thread.base, SWITCH_FREE);
+    }
+}
+
+// Fibers can move between threads across a Wait, so code that may run on both sides of a
+// switch must not hold on to the address of a thread-local. Reading it through a function
+// the compiler cannot inline makes every use look it up again
+static JOB_NOINLINE int32_t
+_thread_index() {
+    return t_thread_index;
+}
+
+static JOB_NOINLINE FrameAllocator&
+_current_allocator() {
+    int32_t index = t_thread_index;
+    if (index >= 0 && JobSystem::GetInitialized())
+        return job_state.threadStates[index].current->allocator;
+
+    if (t_scratch.GetCapacity() == 0)
+        t_scratch.Initialize(JOB_FRAME_ALLOCATOR_SIZE);
+    return t_scratch;
+}
+
+static JobThreadStats&
+_thread_stats() {
+    int32_t index = _thread_index();
+    return job_state.stats[index >= 0 ? index : job_state.workerCount + 1];
+}
+
+// Returns once something switches back to from, which may be on another thread
+static void
+_switch(JobFiber* from, JobFiber* to, SwitchAction action) {
+    JobThread& thread = job_state.threadStates[_thread_index()];
+    thread.previous = from;
+    thread.action = action;
+    thread.current = to;
+    from->fiber.SwitchTo(to->fiber);
+
+    _finish_switch();
+}
+
+// Runs on the fiber that was switched to, once the previous one is off the CPU
+static void
+_finish_switch() {
+    JobThread& thread = job_state.threadStates[_thread_index()];
+    JobFiber* previous = thread.previous;
+    SwitchAction action = thread.action;
+    thread.previous = nullptr;
+    thread.action = SWITCH_NONE;
+
+    if (action == SWITCH_PARK) {
+        std::lock_guard<std::mutex> lock(job_state.waitLock);
+        job_state.waiting.push_back(previous);
+        job_state.waitingCount.fetch_add(1);
+    } else if (action == SWITCH_FREE) {
+        _release_fiber(previous);
+    }
+}
+
+static JobFiber*
+_acquire_fiber() {
+    std::lock_guard<std::mutex> lock(job_state.fiberLock);
+    if (job_state.freeFibers.empty())
+        return nullptr;
+
+    JobFiber* fiber = job_state.freeFibers.back();
+    job_state.freeFibers.pop_back();
+    return fiber;
+}
+
+static void
+_release_fiber(JobFiber* fiber) {
+    std::lock_guard<std::mutex> lock(job_state.fiberLock);
+    job_state.freeFibers.push_back(fiber);
+}
+
+// Oldest parked fiber that index may resume and whose counter is done
+static JobFiber*
+_take_ready(int32_t index) {
+    std::lock_guard<std::mutex> lock(job_state.waitLock);
+    for (size_t i = 0; i < job_state.waiting.size(); i++) {
+        JobFiber* fiber = job_state.waiting[i];
+        if (fiber->pinnedThread >= 0 && fiber->pinnedThread != index)
+            continue;
+        if (!fiber->waitingOn->IsDone())
+            continue;
+
+        job_state.waiting.erase(job_state.waiting.begin() + i);
+        job_state.waitingCount.fetch_sub(1);
+        fiber->waitingOn = nullptr;
+        return fiber;
+    }
+    return nullptr;
+}
+
+static bool
+_has_ready(int32_t index) {
+    if (job_state.waitingCount.load() == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(job_state.waitLock);
+    for (size_t i = 0; i < job_state.waiting.size(); i++) {
+        JobFiber* fiber = job_state.waiting[i];
+        if ((fiber->pinnedThread < 0 || fiber->pinnedThread == index) && fiber->waitingOn->IsDone())
+            return true;
+    }
+    return false;
+}
+
+static bool
+_has_work(int32_t index) {
+    if (job_state.injectedCount.load() > 0)
+        return true;
+    for (uint32_t i = 0; i < job_state.workerCount + 1; i++) {
+        if (!job_state.queues[i].IsEmpty())
+            return true;
+    }
+    return _has_ready(index);
+}
+
+static void
+_cpu_pause() {
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// The lock is taken before notifying so that a worker that just found nothing to do
+// cannot miss the wakeup before it starts waiting
+static void
+_wake_one() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (job_state.sleepers.load() == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(job_state.sleepLock);
+    }
+    job_state.wake.notify_one();
+}
+
+// Used when a parked fiber may have become ready. It can be pinned to one thread, so
+// waking any single worker is not enough
+static void
+_wake_all() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (job_state.sleepers.load() == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(job_state.sleepLock);
+    }
+    job_state.wake.notify_all();
+}
+
+static void
+_pin_thread(std::thread& thread, uint32_t core) {
+#if defined(Q_PLATFORM_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0)
+        std::cerr << "Warning: could not pin job worker to core " << core << std::endl;
+#elif defined(Q_PLATFORM_WINDOWS)
+    if (core < 64 && SetThreadAffinityMask(static_cast<HANDLE>(thread.native_handle()), static_cast<DWORD_PTR>(1) << core) == 0)
+        std::cerr << "Warning: could not pin job worker to core " << core << std::endl;
+#else
+    (void)thread;
+    (void)core;
+#endif
+}
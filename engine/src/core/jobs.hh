@@ -0,0 +1,207 @@
+#pragma once
+
+/**
+ * jobs.hh
+ *
+ * Work-stealing job system.
+ *
+ * Work is split into small jobs that run on a pool of worker threads, one per core.
+ * Every worker, and the main thread, owns a Chase-Lev deque of jobs. The owner pushes
+ * and pops at the bottom of its own deque without taking a lock, and a thread that runs
+ * out of work steals from the top of someone else's. Popping from the bottom keeps a
+ * thread on the jobs it just spawned (whose data is still in cache), and stealing from the
+ * top hands out the oldest jobs, which are usually the biggest pieces of a split.
+ *
+ * Dependencies are expressed with a JobCounter: a job started with a counter bumps it and
+ * drops it again when it finishes. Waiting on a counter does not block, the waiting
+ * thread runs other jobs until the counter reaches zero, so the main thread helps with the
+ * work it is waiting for instead of sitting idle.
+ *
+ * Jobs run on fibers where the platform supports them (see fiber.hh). A job that waits
+ * on an unfinished counter parks its fiber and the thread carries on with other jobs on
+ * a fresh one, so a long chain of jobs waiting on each other never ties up a worker.
+ * Parked fibers are picked up again by whichever thread finds their counter done, which
+ * means a job can continue on a different thread than it started on: thread-local values
+ * read before a Wait may be stale after it. The main thread is the exception, it is only
+ * ever resumed on itself.
+ *
+ * Every fiber carries a frame allocator (FrameAlloc) for scratch memory that lives until
+ * the job returns. Being tied to the fiber rather than the thread, it stays valid across a
+ * Wait.
+ *
+ * Threads that are not part of the system (ie the render thread) can start jobs too, they
+ * go through a shared queue that the workers drain. Their waits help in place instead of
+ * switching fibers.
+*/
+
+#include "stdafx.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bytes a job can keep inline, lambdas that capture more have to capture a pointer instead
+#define JOB_PAYLOAD_SIZE 64
+// Jobs one thread can have queued at once (power of two)
+// A thread that fills its deque runs further jobs itself instead of queueing them
+#define JOB_QUEUE_SIZE 1024
+// Upper bound on worker threads
+#define JOB_MAX_WORKERS 64
+// Fibers for jobs to run and wait on. When they run out waits help in place instead
+#define JOB_FIBER_COUNT 128
+// Reserved per fiber, pages are only committed once used
+#define JOB_FIBER_STACK_SIZE (512 * 1024)
+// Scratch memory per fiber before FrameAlloc falls back to the heap
+#define JOB_FRAME_ALLOCATOR_SIZE (64 * 1024)
+// ParallelFor aims for this many chunks per thread, so that stealing can even out
+// iterations that take uneven time
+#define JOB_CHUNKS_PER_THREAD 4
+
+// Number of unfinished jobs that were started with this counter
+class JobCounter {
+    public:
+        JobCounter() {}
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator= (const JobCounter&) = delete;
+
+        bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+        uint32_t GetPending() const { return m_pending.load(std::memory_order_acquire); }
+
+    private:
+        friend class JobSystem;
+        std::atomic<uint32_t> m_pending{0};
+};
+
+// A queued function call
+// The callable is constructed in place in the payload, so starting a job does not allocate
+struct Job {
+    void (*invoke)(Job& job) = nullptr; // calls and destroys the payload
+    JobCounter* counter = nullptr;
+    std::atomic<bool> busy{false};      // slot is in use by a job that has not finished
+    bool heap = false;                  // allocated because the thread's pool was exhausted
+    alignas(16) unsigned char payload[JOB_PAYLOAD_SIZE];
+};
+
+struct JobStats {
+    uint32_t workers = 0;
+    uint32_t fibers = 0;      // 0 when the platform has no fiber support
+    uint64_t executed = 0;    // jobs run, by any thread
+    uint64_t stolen = 0;      // jobs taken from another thread's deque
+    uint64_t inlined = 0;     // jobs run on the spot because a deque was full
+    uint64_t parked = 0;      // waits that suspended a fiber
+    uint64_t inlineWaits = 0; // waits that had to help in place
+};
+
+class QAPI JobSystem {
+    public:
+        // Start workerCount workers, or one per core (leaving one for the main thread) when 0
+        // Must be called from the main thread, which becomes part of the system
+        // pinThreads locks each worker to its own core
+        static bool Startup(uint32_t workerCount = 0, bool pinThreads = true);
+        // Run every job still queued, then stop the workers
+        static void Shutdown();
+        static bool GetInitialized();
+        static uint32_t GetWorkerCount();
+
+        // Queue func() to run on any thread
+        // If counter is given it is incremented now and decremented once func returns
+        // Runs func right away if the system is not running
+        template <typename F>
+        static void Run(F&& func, JobCounter* counter = nullptr);
+
+        // Return once counter reaches zero. The calling thread runs other jobs meanwhile
+        static void Wait(JobCounter& counter);
+
+        // Call func(begin, end) over [0, count) in chunks that run in parallel, and return
+        // once all of them are done. Chunks are never smaller than minChunk iterations
+        template <typename F>
+        static void ParallelFor(uint32_t count, F&& func, uint32_t minChunk = 1);
+
+        // Scratch memory released when the calling job returns
+        // Outside of jobs it lasts until ResetFrameAllocator, which the main loop calls
+        // every frame
+        static void* FrameAlloc(size_t size, size_t align = 16);
+        template <typename T>
+        static T* FrameAllocArray(size_t count) { return static_cast<T*>(FrameAlloc(sizeof(T) * count, alignof(T))); }
+        static void ResetFrameAllocator();
+
+        static JobStats GetStats();
+
+    private:
+        template <typename F>
+        static void _invoke(Job& job);
+        template <typename F>
+        static void _parallel_range(F* func, uint32_t begin, uint32_t end, uint32_t chunk, JobCounter* counter);
+
+        static Job* _allocate();
+        static void _submit(Job* job);
+        static void _execute(Job* job);
+        static bool _run_one();
+        static bool _resume_ready();
+        static void _schedule();
+        static void _wait_inline(JobCounter& counter);
+        static void _worker_main(uint32_t index);
+        static void _fiber_main(void* arg);
+};
+
+template <typename F>
+void
+JobSystem::Run(F&& func, JobCounter* counter) {
+    using Func = typename std::decay<F>::type;
+    static_assert(sizeof(Func) <= JOB_PAYLOAD_SIZE, "Job captures too much, capture a pointer to the data instead");
+    static_assert(alignof(Func) <= 16, "Job payload is over aligned");
+
+    Job* job = _allocate();
+    new (job->payload) Func(std::forward<F>(func));
+    job->invoke = &_invoke<Func>;
+    job->counter = counter;
+    if (counter)
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    _submit(job);
+}
+
+// Splits the range in half until chunks are small enough. The upper half becomes a job
+// and the lower half is carried on with here, so the first halves split off (the biggest)
+// are the ones sitting at the top of the deque for other threads to steal. A thief splits
+// what it stole the same way, so the work spreads out as fast as threads go idle. When
+// nobody steals, the owner just pops the halves back and runs them in order
+template <typename F>
+void
+JobSystem::ParallelFor(uint32_t count, F&& func, uint32_t minChunk) {
+    if (count == 0)
+        return;
+
+    uint32_t threads = GetWorkerCount() + 1;
+    uint32_t chunk = std::max(std::max(minChunk, 1u), count / (threads * JOB_CHUNKS_PER_THREAD));
+    if (count <= chunk || !GetInitialized()) {
+        func(0u, count);
+        return;
+    }
+
+    using Func = typename std::remove_reference<F>::type;
+    JobCounter counter;
+    _parallel_range<Func>(&func, 0, count, chunk, &counter);
+    Wait(counter);
+}
+
+template <typename F>
+void
+JobSystem::_invoke(Job& job) {
+    F* func = std::launder(reinterpret_cast<F*>(job.payload));
+    (*func)();
+    func->~F();
+}
+
+template <typename F>
+void
+JobSystem::_parallel_range(F* func, uint32_t begin, uint32_t end, uint32_t chunk, JobCounter* counter) {
+    while (end - begin > chunk) {
+        uint32_t mid = begin + (end - begin) / 2;
+        Run([func, mid, end, chunk, counter]() { _parallel_range<F>(func, mid, end, chunk, counter); }, counter);
+        end = mid;
+    }
+    (*func)(begin, end);
+}
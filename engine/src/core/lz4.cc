@@ -0,0 +1,79 @@
+#include "lz4.hh"
+#include <cstring>
+
+#define LZ4_MIN_MATCH 4
+
+// Read an extended length (used when the 4 bit token field is saturated)
+// Every byte of 255 adds to the length until a smaller byte terminates it
+static bool
+_read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+    uint8_t b = 0;
+    do {
+        if (ip >= end)
+            return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+
+    return true;
+}
+
+int64_t
+LZ4DecompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+    const uint8_t* ip = src;
+    const uint8_t* ipEnd = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* opEnd = dst + dstCapacity;
+
+    while (ip < ipEnd) {
+        // Each sequence starts with a token
+        // high nibble: literal length, low nibble: match length - 4
+        uint8_t token = *ip++;
+
+        // Literals
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !_read_length(ip, ipEnd, literalLength))
+            return -1;
+
+        if (literalLength > static_cast<size_t>(ipEnd - ip)
+            || literalLength > static_cast<size_t>(opEnd - op))
+            return -1;
+
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // The last sequence of a block only holds literals
+        if (ip >= ipEnd)
+            break;
+
+        // Match
+        if (ipEnd - ip < 2)
+            return -1;
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst))
+            return -1;
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !_read_length(ip, ipEnd, matchLength))
+            return -1;
+        matchLength += LZ4_MIN_MATCH;
+
+        if (matchLength > static_cast<size_t>(opEnd - op))
+            return -1;
+
+        // Matches may overlap the bytes they produce, so copy forward one byte at a time
+        // unless the source is far enough back to copy in one go
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            for (size_t i = 0; i < matchLength; i++)
+                *op++ = *match++;
+        }
+    }
+
+    return static_cast<int64_t>(op - dst);
+}
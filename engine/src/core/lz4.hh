@@ -0,0 +1,20 @@
+#pragma once
+/*
+ *  lz4.hh
+ *
+ *  Decoder for the LZ4 block format, used for compressed entries in pack files.
+ *  Only decompression lives in the engine; packs are compressed offline with the
+ *  reference lz4 tooling (raw blocks, no frame header)
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+// Most bytes one compressed byte can expand to (a match length byte of 255)
+// A block never decompresses to more than its size times this, plus a few bytes of slack
+#define LZ4_MAX_RATIO 255
+
+// Decompress one LZ4 block into dst
+// Returns the number of bytes written to dst, or -1 if the block is malformed
+// or would overflow dstCapacity
+int64_t LZ4DecompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+ * slot_map.hh
+ *
+ * Generational slot map. Values live packed in one array, and callers hold handles to them
+ * instead of pointers or indices.
+ *
+ * A handle is a slot index plus the generation the slot had when the value was inserted.
+ * The slot points at the value's place in the packed array, so a lookup is two array reads.
+ * Removing a value moves the last value into its place and bumps the slot's generation, so
+ * old handles to the slot stop resolving instead of reaching whatever is stored there next.
+ * Freed slots go on a free list and are reused before the slot array grows.
+ *
+ * Values move when others are removed, so pointers returned by Get are only good until the
+ * next Remove.
+*/
+
+#include "stdafx.hh"
+#include <cstdint>
+#include <utility>
+
+// Generation that is never handed out, for handles that have to be told apart from real ones
+#define SLOT_GENERATION_INVALID UINT32_MAX
+
+struct SlotHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool IsNull() const { return index == UINT32_MAX; }
+    bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+template <typename T>
+class SlotMap {
+    public:
+        SlotMap() {}
+        ~SlotMap() {}
+        SlotMap(const SlotMap&) = delete;
+        SlotMap& operator= (const SlotMap&) = delete;
+
+        template <typename... Args>
+        SlotHandle Emplace(Args&&... args) {
+            uint32_t index = m_freeHead;
+            if (index != UINT32_MAX) {
+                m_freeHead = m_slots[index].next;
+            } else {
+                index = static_cast<uint32_t>(m_slots.size());
+                m_slots.push_back({});
+            }
+
+            Slot& slot = m_slots[index];
+            slot.dense = static_cast<uint32_t>(m_values.size());
+            m_values.emplace_back(std::forward<Args>(args)...);
+            m_owners.push_back(index);
+            return { index, slot.generation };
+        }
+        SlotHandle Insert(T value) { return Emplace(std::move(value)); }
+
+        // Returns false if the handle was already stale
+        bool Remove(SlotHandle handle) {
+            if (!Contains(handle))
+                return false;
+
+            Slot& slot = m_slots[handle.index];
+            uint32_t last = static_cast<uint32_t>(m_values.size() - 1);
+            if (slot.dense != last) {
+                m_values[slot.dense] = std::move(m_values[last]);
+                m_owners[slot.dense] = m_owners[last];
+                m_slots[m_owners[last]].dense = slot.dense;
+            }
+            m_values.pop_back();
+            m_owners.pop_back();
+            _free(handle.index);
+            return true;
+        }
+
+        bool Contains(SlotHandle handle) const {
+            return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+        }
+
+        // Returns nullptr for stale handles
+        T* Get(SlotHandle handle) { return Contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr; }
+        const T* Get(SlotHandle handle) const { return Contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr; }
+
+        void Clear() {
+            for (size_t i = 0; i < m_owners.size(); i++) {
+                _free(m_owners[i]);
+            }
+            m_values.clear();
+            m_owners.clear();
+        }
+        void Reserve(size_t count) {
+            m_slots.reserve(count);
+            m_values.reserve(count);
+            m_owners.reserve(count);
+        }
+
+        // The packed values, in no particular order. The handle of the value at position i
+        // is GetHandle(i)
+        size_t Size() const { return m_values.size(); }
+        bool IsEmpty() const { return m_values.empty(); }
+        T* Data() { return m_values.data(); }
+        const T* Data() const { return m_values.data(); }
+        T& operator[](size_t i) { return m_values[i]; }
+        const T& operator[](size_t i) const { return m_values[i]; }
+        SlotHandle GetHandle(size_t i) const { return { m_owners[i], m_slots[m_owners[i]].generation }; }
+
+    private:
+        struct Slot {
+            uint32_t dense = 0;      // position of the value while the slot is in use
+            uint32_t next = 0;       // next free slot while it is not
+            uint32_t generation = 0;
+        };
+
+        // The generation a free slot holds is the one its next value gets, so no handle out
+        // there matches it until then
+        void _free(uint32_t index) {
+            Slot& slot = m_slots[index];
+            slot.generation++;
+            if (slot.generation == SLOT_GENERATION_INVALID)
+                slot.generation = 0;
+            slot.next = m_freeHead;
+            m_freeHead = index;
+        }
+
+        std::vector<Slot> m_slots;
+        std::vector<T> m_values;
+        std::vector<uint32_t> m_owners; // slot of each packed value
+        uint32_t m_freeHead = UINT32_MAX;
+};
@@ -0,0 +1,399 @@
+/**
+ * ecs.cc
+ *
+ * Storage and structural changes for the entity component system
+*/
+
+#include "ecs.hh"
+
+#include <stdexcept>
+#include <string>
+
+namespace Pegasus {
+  // Component types are shared by every world
+  static std::mutex component_lock;
+  static ComponentInfo component_infos[ECS_MAX_COMPONENTS];
+  static uint32_t component_count = 0;
+  // Ids by type name, so the engine and a game module agree on the id of a type even though
+  // each has its own copy of ComponentType<T>
+  static std::unordered_map<std::string, ComponentId> component_ids;
+
+  static size_t _align_up(size_t value, size_t align);
+  static size_t _chunk_layout(const std::vector<ComponentId>& components, uint32_t capacity, std::vector<size_t>& offsets);
+
+  ComponentId
+  RegisterComponent(const ComponentInfo& info) {
+    std::lock_guard<std::mutex> lock(component_lock);
+    auto found = component_ids.find(info.name);
+    if (found != component_ids.end())
+      return found->second;
+    if (component_count >= ECS_MAX_COMPONENTS)
+      throw std::runtime_error("Too many component types, raise ECS_MAX_COMPONENTS");
+
+    component_infos[component_count] = info;
+    component_ids.emplace(info.name, component_count);
+    return component_count++;
+  }
+
+  // Infos never change once registered, so reading them needs no lock
+  const ComponentInfo&
+  GetComponentInfo(ComponentId id) {
+    return component_infos[id];
+  }
+
+  //
+  // Archetype
+  //
+
+  Archetype::Archetype(ComponentMask mask)
+    : m_mask(mask) {
+    for (ComponentId id = 0; id < ECS_MAX_COMPONENTS; id++) {
+      m_columns[id] = -1;
+      if (mask & (static_cast<ComponentMask>(1) << id)) {
+        m_columns[id] = static_cast<int8_t>(m_components.size());
+        m_components.push_back(id);
+      }
+    }
+
+    // As many entities as fit in a chunk with every array aligned
+    size_t entityBytes = sizeof(Entity);
+    for (size_t i = 0; i < m_components.size(); i++) {
+      entityBytes += GetComponentInfo(m_components[i]).size;
+    }
+    m_capacity = static_cast<uint32_t>(std::max<size_t>(ECS_CHUNK_SIZE / entityBytes, 1));
+    while (m_capacity > 1 && _chunk_layout(m_components, m_capacity, m_offsets) > ECS_CHUNK_SIZE) {
+      m_capacity--;
+    }
+    m_chunkBytes = std::max<size_t>(_chunk_layout(m_components, m_capacity, m_offsets), ECS_CHUNK_SIZE);
+  }
+
+  Archetype::~Archetype() {
+    for (size_t c = 0; c < m_chunks.size(); c++) {
+      Chunk& chunk = m_chunks[c];
+      for (size_t i = 0; i < m_components.size(); i++) {
+        const ComponentInfo& info = GetComponentInfo(m_components[i]);
+        unsigned char* column = chunk.memory + m_offsets[i];
+        for (uint32_t row = 0; row < chunk.count; row++) {
+          info.destroy(column + row * info.size);
+        }
+      }
+      ::operator delete(chunk.memory, std::align_val_t(ECS_COLUMN_ALIGNMENT));
+    }
+    if (m_spare)
+      ::operator delete(m_spare, std::align_val_t(ECS_COLUMN_ALIGNMENT));
+  }
+
+  void*
+  Archetype::GetComponent(uint32_t chunk, uint32_t row, ComponentId id) const {
+    int8_t column = m_columns[id];
+    if (column < 0)
+      return nullptr;
+    return m_chunks[chunk].memory + m_offsets[column] + row * GetComponentInfo(id).size;
+  }
+
+  // Reserve a row at the end. The components in it are left uninitialized
+  void
+  Archetype::_add_row(uint32_t& chunk, uint32_t& row) {
+    if (m_chunks.empty() || m_chunks.back().count == m_capacity)
+      _new_chunk();
+
+    chunk = static_cast<uint32_t>(m_chunks.size() - 1);
+    row = m_chunks.back().count++;
+    m_count++;
+  }
+
+  Chunk&
+  Archetype::_new_chunk() {
+    Chunk chunk = {};
+    if (m_spare) {
+      chunk.memory = m_spare;
+      m_spare = nullptr;
+    } else {
+      chunk.memory = static_cast<unsigned char*>(::operator new(m_chunkBytes, std::align_val_t(ECS_COLUMN_ALIGNMENT)));
+    }
+    m_chunks.push_back(chunk);
+    return m_chunks.back();
+  }
+
+  //
+  // World
+  //
+
+  World::World() {
+    _get_archetype(0);
+  }
+
+  World::~World() {
+    for (size_t i = 0; i < m_archetypeList.size(); i++) {
+      delete m_archetypeList[i];
+    }
+  }
+
+  Entity
+  World::Create() {
+    return _create_in(_get_archetype(0));
+  }
+
+  void
+  World::Destroy(Entity entity) {
+    if (!IsAlive(entity))
+      return;
+
+    EntityRecord& record = *m_records.Get(entity);
+    Archetype* archetype = record.archetype;
+    for (size_t i = 0; i < archetype->m_components.size(); i++) {
+      ComponentId id = archetype->m_components[i];
+      GetComponentInfo(id).destroy(archetype->GetComponent(record.chunk, record.row, id));
+    }
+    _remove_row(archetype, record.chunk, record.row);
+    m_records.Remove(entity);
+  }
+
+  bool
+  World::IsAlive(Entity entity) const {
+    return m_records.Contains(entity);
+  }
+
+  void*
+  World::GetComponent(Entity entity, ComponentId id) const {
+    const EntityRecord* record = m_records.Get(entity);
+    if (!record)
+      return nullptr;
+
+    return record->archetype->GetComponent(record->chunk, record->row, id);
+  }
+
+  // Moves the entity to the archetype with id added. If it already has the component the
+  // old value is destroyed and its storage handed back
+  void*
+  World::AddComponent(Entity entity, ComponentId id) {
+    if (!IsAlive(entity))
+      return nullptr;
+
+    EntityRecord& record = *m_records.Get(entity);
+    Archetype* from = record.archetype;
+    if (void* existing = from->GetComponent(record.chunk, record.row, id)) {
+      GetComponentInfo(id).destroy(existing);
+      return existing;
+    }
+
+    Archetype* to = nullptr;
+    auto edge = from->m_addEdges.find(id);
+    if (edge != from->m_addEdges.end()) {
+      to = edge->second;
+    } else {
+      to = _get_archetype(from->m_mask | (static_cast<ComponentMask>(1) << id));
+      from->m_addEdges[id] = to;
+      to->m_removeEdges[id] = from;
+    }
+
+    uint32_t chunk = 0;
+    uint32_t row = 0;
+    to->_add_row(chunk, row);
+    for (size_t i = 0; i < from->m_components.size(); i++) {
+      ComponentId moved = from->m_components[i];
+      GetComponentInfo(moved).relocate(to->GetComponent(chunk, row, moved), from->GetComponent(record.chunk, record.row, moved));
+    }
+    to->GetEntities(to->m_chunks[chunk])[row] = entity;
+    _remove_row(from, record.chunk, record.row);
+
+    record.archetype = to;
+    record.chunk = chunk;
+    record.row = row;
+    return to->GetComponent(chunk, row, id);
+  }
+
+  void
+  World::RemoveComponent(Entity entity, ComponentId id) {
+    if (!IsAlive(entity))
+      return;
+
+    EntityRecord& record = *m_records.Get(entity);
+    Archetype* from = record.archetype;
+    void* removed = from->GetComponent(record.chunk, record.row, id);
+    if (!removed)
+      return;
+
+    Archetype* to = nullptr;
+    auto edge = from->m_removeEdges.find(id);
+    if (edge != from->m_removeEdges.end()) {
+      to = edge->second;
+    } else {
+      to = _get_archetype(from->m_mask & ~(static_cast<ComponentMask>(1) << id));
+      from->m_removeEdges[id] = to;
+      to->m_addEdges[id] = from;
+    }
+
+    GetComponentInfo(id).destroy(removed);
+    uint32_t chunk = 0;
+    uint32_t row = 0;
+    to->_add_row(chunk, row);
+    for (size_t i = 0; i < to->m_components.size(); i++) {
+      ComponentId moved = to->m_components[i];
+      GetComponentInfo(moved).relocate(to->GetComponent(chunk, row, moved), from->GetComponent(record.chunk, record.row, moved));
+    }
+    to->GetEntities(to->m_chunks[chunk])[row] = entity;
+    _remove_row(from, record.chunk, record.row);
+
+    record.archetype = to;
+    record.chunk = chunk;
+    record.row = row;
+  }
+
+  // Archetypes are only ever added, so a cached match only has to look at the ones
+  // created since it was last used
+  const std::vector<Archetype*>&
+  World::Match(ComponentMask mask) {
+    std::lock_guard<std::mutex> lock(m_matchLock);
+    MatchCache& cache = m_matches[mask];
+    for (; cache.checked < m_archetypeList.size(); cache.checked++) {
+      Archetype* archetype = m_archetypeList[cache.checked];
+      if ((archetype->m_mask & mask) == mask)
+        cache.archetypes.push_back(archetype);
+    }
+    return cache.archetypes;
+  }
+
+  //
+  // PRIVATE
+  //
+
+  Archetype*
+  World::_get_archetype(ComponentMask mask) {
+    auto it = m_archetypes.find(mask);
+    if (it != m_archetypes.end())
+      return it->second;
+
+    Archetype* archetype = new Archetype(mask);
+    m_archetypes[mask] = archetype;
+    m_archetypeList.push_back(archetype);
+    return archetype;
+  }
+
+  Entity
+  World::_create_in(Archetype* archetype) {
+    Entity entity = m_records.Emplace();
+    EntityRecord& record = *m_records.Get(entity);
+    record.archetype = archetype;
+    archetype->_add_row(record.chunk, record.row);
+    archetype->GetEntities(archetype->m_chunks[record.chunk])[record.row] = entity;
+    return entity;
+  }
+
+  // Close the gap left by a row whose components were destroyed or moved out, by moving
+  // the archetype's last entity into it. Keeps every chunk but the last full
+  void
+  World::_remove_row(Archetype* archetype, uint32_t chunk, uint32_t row) {
+    uint32_t lastChunk = static_cast<uint32_t>(archetype->m_chunks.size() - 1);
+    uint32_t lastRow = archetype->m_chunks[lastChunk].count - 1;
+
+    if (chunk != lastChunk || row != lastRow) {
+      for (size_t i = 0; i < archetype->m_components.size(); i++) {
+        ComponentId id = archetype->m_components[i];
+        GetComponentInfo(id).relocate(archetype->GetComponent(chunk, row, id), archetype->GetComponent(lastChunk, lastRow, id));
+      }
+      Entity moved = archetype->GetEntities(archetype->m_chunks[lastChunk])[lastRow];
+      archetype->GetEntities(archetype->m_chunks[chunk])[row] = moved;
+      EntityRecord* record = m_records.Get(moved);
+      record->chunk = chunk;
+      record->row = row;
+    }
+
+    archetype->m_count--;
+    if (--archetype->m_chunks[lastChunk].count == 0) {
+      // Keep one empty chunk around so that an entity moving back and forth over a chunk
+      // boundary does not allocate every time
+      if (archetype->m_spare)
+        ::operator delete(archetype->m_chunks[lastChunk].memory, std::align_val_t(ECS_COLUMN_ALIGNMENT));
+      else
+        archetype->m_spare = archetype->m_chunks[lastChunk].memory;
+      archetype->m_chunks.pop_back();
+    }
+  }
+
+  //
+  // CommandBuffer
+  //
+
+  Entity
+  CommandBuffer::Create() {
+    Entity placeholder = {};
+    placeholder.index = m_created++;
+    placeholder.generation = SLOT_GENERATION_INVALID;
+    m_commands.push_back({ COMMAND_CREATE, placeholder, 0, nullptr });
+    return placeholder;
+  }
+
+  void
+  CommandBuffer::Destroy(Entity entity) {
+    m_commands.push_back({ COMMAND_DESTROY, entity, 0, nullptr });
+  }
+
+  void
+  CommandBuffer::Playback(World& world) {
+    std::vector<Entity> created(m_created);
+
+    for (size_t i = 0; i < m_commands.size(); i++) {
+      Command& command = m_commands[i];
+      Entity entity = command.entity;
+      if (entity.generation == SLOT_GENERATION_INVALID && command.type != COMMAND_CREATE)
+        entity = created[entity.index];
+
+      switch (command.type) {
+        case COMMAND_CREATE:
+          created[entity.index] = world.Create();
+          break;
+        case COMMAND_DESTROY:
+          world.Destroy(entity);
+          break;
+        case COMMAND_ADD: {
+          const ComponentInfo& info = GetComponentInfo(command.component);
+          void* storage = world.AddComponent(entity, command.component);
+          if (storage)
+            info.relocate(storage, command.value);
+          else
+            info.destroy(command.value); // entity died before the buffer ran
+          command.value = nullptr;
+          break;
+        }
+        case COMMAND_REMOVE:
+          world.RemoveComponent(entity, command.component);
+          break;
+      }
+    }
+
+    Clear();
+  }
+
+  void
+  CommandBuffer::Clear() {
+    // Values that were never played back still have to be destroyed
+    for (size_t i = 0; i < m_commands.size(); i++) {
+      if (m_commands[i].type == COMMAND_ADD && m_commands[i].value)
+        GetComponentInfo(m_commands[i].component).destroy(m_commands[i].value);
+    }
+    m_commands.clear();
+    m_values.Reset();
+    m_created = 0;
+  }
+
+  static size_t
+  _align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+  }
+
+  // Bytes a chunk needs for capacity entities: the entity array, then one array per
+  // component, each starting on a fresh cache line
+  static size_t
+  _chunk_layout(const std::vector<ComponentId>& components, uint32_t capacity, std::vector<size_t>& offsets) {
+    offsets.resize(components.size());
+    size_t offset = sizeof(Entity) * capacity;
+    for (size_t i = 0; i < components.size(); i++) {
+      const ComponentInfo& info = GetComponentInfo(components[i]);
+      offset = _align_up(offset, std::max<size_t>(info.align, ECS_COLUMN_ALIGNMENT));
+      offsets[i] = offset;
+      offset += info.size * capacity;
+    }
+    return offset;
+  }
+}
@@ -0,0 +1,335 @@
+#pragma once
+#include "defines.hh"
+#include "core/frame_allocator.hh"
+#include "core/jobs.hh"
+#include "core/slot_map.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * ecs.hh
+ *
+ * Archetype based entity component system
+ *
+ * Entities with the same set of component types share an archetype, and an archetype keeps
+ * its entities in fixed size chunks. Inside a chunk every component type has its own array
+ * (structure of arrays), so a query that reads two components walks two packed arrays
+ * front to back instead of hopping between objects. Adding or removing a component moves
+ * the entity to the archetype for its new set.
+ *
+ * Structural changes (create, destroy, add, remove) move entities around, so they must not
+ * happen while a query is running. Record them in a CommandBuffer instead and play it back
+ * once the query is done. Queries themselves only read the layout and may run in parallel.
+*/
+
+// Distinct component types a world can know about
+#define ECS_MAX_COMPONENTS 64
+// Bytes per chunk, archetypes with bigger entities get bigger chunks
+#define ECS_CHUNK_SIZE (16 * 1024)
+// Component arrays in a chunk start on their own cache line
+#define ECS_COLUMN_ALIGNMENT 64
+
+namespace Pegasus {
+  // Handle to an entity
+  // The generation tells it apart from earlier entities that used the same slot, so a handle
+  // to a destroyed entity stays invalid after the slot is reused
+  using Entity = SlotHandle;
+
+  using ComponentId = uint32_t;
+  using ComponentMask = uint64_t;
+
+  // How to handle a component type without knowing it
+  struct ComponentInfo {
+    const char* name;
+    size_t size;
+    size_t align;
+    void (*relocate)(void* dst, void* src); // move src into uninitialized dst, then destroy src
+    void (*destroy)(void* component);
+  };
+
+  // Returns the id already given to a type with the same name, if there is one
+  QAPI ComponentId RegisterComponent(const ComponentInfo& info);
+  QAPI const ComponentInfo& GetComponentInfo(ComponentId id);
+
+  // Id of a component type, assigned the first time the type is used
+  // Every module (the engine, a game DLL) caches its own id here, RegisterComponent hands out
+  // the same one for the same type name so they all agree
+  // const T is the same component as T, queries use it for read only access
+  template <typename T>
+  ComponentId ComponentType() {
+    if constexpr (!std::is_same<T, typename std::remove_cv<T>::type>::value) {
+      return ComponentType<typename std::remove_cv<T>::type>();
+    } else {
+      static const ComponentId id = RegisterComponent(ComponentInfo{
+        typeid(T).name(),
+        sizeof(T),
+        alignof(T),
+        [](void* dst, void* src) { new (dst) T(std::move(*static_cast<T*>(src))); static_cast<T*>(src)->~T(); },
+        [](void* component) { static_cast<T*>(component)->~T(); },
+      });
+      return id;
+    }
+  }
+
+  template <typename... Ts>
+  ComponentMask ComponentMaskOf() {
+    return (static_cast<ComponentMask>(0) | ... | (static_cast<ComponentMask>(1) << ComponentType<Ts>()));
+  }
+
+  struct Chunk {
+    unsigned char* memory = nullptr;
+    uint32_t count = 0;
+  };
+
+  // All entities with one exact set of components
+  class QAPI Archetype {
+    public:
+      Archetype(ComponentMask mask);
+      ~Archetype();
+      Archetype(const Archetype&) = delete;
+      Archetype& operator= (const Archetype&) = delete;
+
+      ComponentMask GetMask() const { return m_mask; }
+      uint32_t GetEntityCount() const { return m_count; }
+      uint32_t GetChunkCapacity() const { return m_capacity; }
+      size_t GetChunkCount() const { return m_chunks.size(); }
+      const Chunk& GetChunk(size_t index) const { return m_chunks[index]; }
+
+      Entity* GetEntities(const Chunk& chunk) const { return reinterpret_cast<Entity*>(chunk.memory); }
+      void* GetColumn(const Chunk& chunk, ComponentId id) const { return chunk.memory + m_offsets[m_columns[id]]; }
+      template <typename T>
+      T* GetColumn(const Chunk& chunk) const { return static_cast<T*>(GetColumn(chunk, ComponentType<T>())); }
+      void* GetComponent(uint32_t chunk, uint32_t row, ComponentId id) const;
+
+    private:
+      friend class World;
+
+      void _add_row(uint32_t& chunk, uint32_t& row);
+      Chunk& _new_chunk();
+
+      ComponentMask m_mask;
+      std::vector<ComponentId> m_components;
+      std::vector<size_t> m_offsets;            // offset of each component's array, parallel to m_components
+      int8_t m_columns[ECS_MAX_COMPONENTS];     // index into m_components by id, -1 if absent
+      uint32_t m_capacity = 0;                  // entities per chunk
+      size_t m_chunkBytes = 0;
+      uint32_t m_count = 0;
+      std::vector<Chunk> m_chunks;              // every chunk but the last is full
+      unsigned char* m_spare = nullptr;         // an emptied chunk kept for reuse
+
+      // Where an entity goes when a component is added or removed
+      std::unordered_map<ComponentId, Archetype*> m_addEdges;
+      std::unordered_map<ComponentId, Archetype*> m_removeEdges;
+  };
+
+  class QAPI World {
+    public:
+      World();
+      ~World();
+      World(const World&) = delete;
+      World& operator= (const World&) = delete;
+
+      Entity Create();
+      template <typename... Ts>
+      Entity Create(Ts&&... components);
+      void Destroy(Entity entity);
+      bool IsAlive(Entity entity) const;
+
+      template <typename T>
+      bool Has(Entity entity) const { return GetComponent(entity, ComponentType<T>()) != nullptr; }
+      // Returns nullptr if the entity is dead or has no T
+      template <typename T>
+      T* Get(Entity entity) { return static_cast<T*>(GetComponent(entity, ComponentType<T>())); }
+      // Replaces the value if the entity already has a T
+      template <typename T>
+      T* Add(Entity entity, T&& value);
+      template <typename T>
+      void Remove(Entity entity) { RemoveComponent(entity, ComponentType<T>()); }
+
+      // func(Entity, Ts&...) for every entity that has all of Ts
+      template <typename... Ts, typename F>
+      void Each(F&& func);
+      // func(count, entities, Ts*...) once per chunk, for loops that want the arrays themselves
+      template <typename... Ts, typename F>
+      void EachChunk(F&& func);
+      // Each split over the job system, a chunk at a time. func is called from several
+      // threads at once
+      template <typename... Ts, typename F>
+      void ParallelEach(F&& func, uint32_t minChunks = 1);
+
+      uint32_t GetEntityCount() const { return static_cast<uint32_t>(m_records.Size()); }
+      size_t GetArchetypeCount() const { return m_archetypeList.size(); }
+
+      // Type erased versions of the above
+      void* GetComponent(Entity entity, ComponentId id) const;
+      // Returns uninitialized storage for the component, which the caller must construct
+      void* AddComponent(Entity entity, ComponentId id);
+      void RemoveComponent(Entity entity, ComponentId id);
+      // Archetypes that have every component in mask
+      const std::vector<Archetype*>& Match(ComponentMask mask);
+
+    private:
+      struct EntityRecord {
+        Archetype* archetype = nullptr;
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+      };
+
+      struct MatchCache {
+        size_t checked = 0; // archetypes in m_archetypeList already looked at
+        std::vector<Archetype*> archetypes;
+      };
+
+      Archetype* _get_archetype(ComponentMask mask);
+      Entity _create_in(Archetype* archetype);
+      void _remove_row(Archetype* archetype, uint32_t chunk, uint32_t row);
+
+      SlotMap<EntityRecord> m_records;
+
+      std::unordered_map<ComponentMask, Archetype*> m_archetypes;
+      std::vector<Archetype*> m_archetypeList; // owns them, in creation order
+
+      std::mutex m_matchLock;
+      std::unordered_map<ComponentMask, MatchCache> m_matches;
+  };
+
+  // Structural changes recorded for later, ie from inside a query
+  // Not thread safe, give each job its own buffer
+  class QAPI CommandBuffer {
+    public:
+      CommandBuffer() {}
+      ~CommandBuffer() { Clear(); }
+      CommandBuffer(const CommandBuffer&) = delete;
+      CommandBuffer& operator= (const CommandBuffer&) = delete;
+
+      // The returned entity is a placeholder that only means something to this buffer,
+      // until Playback creates the real one
+      Entity Create();
+      void Destroy(Entity entity);
+      template <typename T>
+      void Add(Entity entity, T&& value);
+      template <typename T>
+      void Remove(Entity entity) { m_commands.push_back({ COMMAND_REMOVE, entity, ComponentType<T>(), nullptr }); }
+
+      // Apply the commands in the order they were recorded, then clear the buffer
+      void Playback(World& world);
+      void Clear();
+      bool IsEmpty() const { return m_commands.empty(); }
+
+    private:
+      enum CommandType {
+        COMMAND_CREATE,
+        COMMAND_DESTROY,
+        COMMAND_ADD,
+        COMMAND_REMOVE,
+      };
+
+      struct Command {
+        CommandType type;
+        Entity entity;
+        ComponentId component;
+        void* value; // COMMAND_ADD only
+      };
+
+      std::vector<Command> m_commands;
+      FrameAllocator m_values;
+      uint32_t m_created = 0;
+  };
+
+  //
+  // Templates
+  //
+
+  template <typename... Ts>
+  Entity
+  World::Create(Ts&&... components) {
+    Entity entity = _create_in(_get_archetype(ComponentMaskOf<typename std::decay<Ts>::type...>()));
+    const EntityRecord& record = *m_records.Get(entity);
+    (new (record.archetype->GetComponent(record.chunk, record.row, ComponentType<typename std::decay<Ts>::type>()))
+        typename std::decay<Ts>::type(std::forward<Ts>(components)), ...);
+    return entity;
+  }
+
+  template <typename T>
+  T*
+  World::Add(Entity entity, T&& value) {
+    using Component = typename std::decay<T>::type;
+    void* storage = AddComponent(entity, ComponentType<Component>());
+    if (!storage)
+      return nullptr;
+    return new (storage) Component(std::forward<T>(value));
+  }
+
+  template <typename... Ts, typename F>
+  void
+  World::EachChunk(F&& func) {
+    const std::vector<Archetype*>& archetypes = Match(ComponentMaskOf<Ts...>());
+    for (size_t a = 0; a < archetypes.size(); a++) {
+      Archetype* archetype = archetypes[a];
+      for (size_t c = 0; c < archetype->GetChunkCount(); c++) {
+        const Chunk& chunk = archetype->GetChunk(c);
+        func(chunk.count, archetype->GetEntities(chunk), archetype->template GetColumn<Ts>(chunk)...);
+      }
+    }
+  }
+
+  template <typename... Ts, typename F>
+  void
+  World::Each(F&& func) {
+    EachChunk<Ts...>([&func](uint32_t count, Entity* entities, Ts*... columns) {
+      for (uint32_t i = 0; i < count; i++) {
+        func(entities[i], columns[i]...);
+      }
+    });
+  }
+
+  template <typename... Ts, typename F>
+  void
+  World::ParallelEach(F&& func, uint32_t minChunks) {
+    struct ChunkRef {
+      Archetype* archetype;
+      size_t chunk;
+    };
+
+    const std::vector<Archetype*>& archetypes = Match(ComponentMaskOf<Ts...>());
+    std::vector<ChunkRef> chunks;
+    for (size_t a = 0; a < archetypes.size(); a++) {
+      for (size_t c = 0; c < archetypes[a]->GetChunkCount(); c++) {
+        chunks.push_back({ archetypes[a], c });
+      }
+    }
+
+    JobSystem::ParallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t begin, uint32_t end) {
+      for (uint32_t c = begin; c < end; c++) {
+        Archetype* archetype = chunks[c].archetype;
+        const Chunk& chunk = archetype->GetChunk(chunks[c].chunk);
+        Entity* entities = archetype->GetEntities(chunk);
+        auto each = [&](Ts*... columns) {
+          for (uint32_t i = 0; i < chunk.count; i++) {
+            func(entities[i], columns[i]...);
+          }
+        };
+        each(archetype->template GetColumn<Ts>(chunk)...);
+      }
+    }, minChunks);
+  }
+
+  template <typename T>
+  void
+  CommandBuffer::Add(Entity entity, T&& value) {
+    using Component = typename std::decay<T>::type;
+    if (m_values.GetCapacity() == 0)
+      m_values.Initialize(ECS_CHUNK_SIZE);
+
+    void* storage = m_values.Allocate(sizeof(Component), alignof(Component));
+    new (storage) Component(std::forward<T>(value));
+    m_commands.push_back({ COMMAND_ADD, entity, ComponentType<Component>(), storage });
+  }
+}
@@ -4,7 +4,7 @@
  * Implementation for game-specific functionality
 */
 
-#include "game_object.hh" 
+#include "game.hh"
 
 namespace Pegasus {
   static GameState game_state = {};
@@ -29,8 +29,9 @@ namespace Pegasus {
   }
 
   bool
-  Game::Render(float delta_time) {
+  Game::Render(float delta_time, float alpha) {
     game_state.delta_time = delta_time;
+    game_state.alpha = alpha;
     return true;
   }
 
@@ -40,23 +41,13 @@ namespace Pegasus {
     return;
   }
 
-  GameObject
-  GameObject::New(GameObject::id_t id) {
-    GameObject obj;
-    obj.m_id = id;
-    return obj;
+  World&
+  Game::GetWorld() {
+    return game_state.world;
   }
 
-  /**
-  * Create a new object for the game
-  */
-  GameObject
-  Game::NewGameObject(void) {
-    static GameObject::id_t current_id = 0;
-
-    GameObject obj = GameObject::New(current_id);
-    current_id++;
-
-    return obj;
+  TransformHierarchy&
+  Game::GetTransforms() {
+    return game_state.transforms;
   }
 }
@@ -4,4 +4,7 @@
 struct GameState {
   bool initialized = false;
   float delta_time;
+  float alpha = 1.0f;
+  Pegasus::World world;
+  Pegasus::TransformHierarchy transforms;
 };
\ No newline at end of file
@@ -0,0 +1,476 @@
+/**
+ * transform.cc
+ *
+ * Implementation of the scene transform hierarchy
+*/
+
+#include "transform.hh"
+#include "core/jobs.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORM_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#define TRANSFORM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#include <intrin.h>
+#define TRANSFORM_TARGET_AVX2
+#endif
+#endif
+
+#define TRANSFORM_NO_PARENT UINT32_MAX
+
+// Node flags
+#define NODE_LOCAL_DIRTY   (1 << 0) // position, rotation or scale changed
+#define NODE_WORLD_CHANGED (1 << 1) // world matrix was rebuilt by the last Update
+#define NODE_DEAD          (1 << 2) // destroyed, removed when the order is rebuilt
+#define NODE_TELEPORT      (1 << 3) // previous world matrix is set to the new one by the next Update
+#define NODE_TELEPORTED    (1 << 4) // the last Update did that, children follow
+
+// The arrays of a TransformHierarchy, for the update loops
+struct NodeArrays {
+  const glm::vec3* position;
+  const glm::quat* rotation;
+  const glm::vec3* scale;
+  float* local;
+  float* world;
+  float* previous;
+  const uint32_t* parent;
+  uint8_t* flags;
+};
+
+static void _update_nodes(const NodeArrays& nodes, uint32_t begin, uint32_t end);
+#if defined(TRANSFORM_AVX2)
+TRANSFORM_TARGET_AVX2 static void _update_nodes_avx2(const NodeArrays& nodes, uint32_t begin, uint32_t end);
+#endif
+static bool _cpu_has_avx2();
+
+namespace Pegasus {
+  TransformHandle
+  TransformHierarchy::Create(TransformHandle parent) {
+    uint32_t parentPosition = TRANSFORM_NO_PARENT;
+    if (!parent.IsNull()) {
+      if (!IsValid(parent))
+        return {};
+      parentPosition = _position(parent);
+    }
+
+    uint32_t position = static_cast<uint32_t>(m_position.size());
+    TransformHandle node = m_nodes.Insert(position);
+    m_position.push_back(glm::vec3(0.0f));
+    m_rotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    m_scale.push_back(glm::vec3(1.0f));
+    m_local.push_back(glm::mat4(1.0f));
+    m_world.push_back(glm::mat4(1.0f));
+    m_previous.push_back(glm::mat4(1.0f));
+    m_parent.push_back(parentPosition);
+    m_flags.push_back(NODE_TELEPORT);
+    m_owners.push_back(node);
+
+    _mark_dirty(position);
+    m_orderDirty = true;
+    return node;
+  }
+
+  // Everything under a node comes after it, so one pass from the node onwards finds the
+  // whole subtree. The nodes only leave the arrays when the order is rebuilt
+  void
+  TransformHierarchy::Destroy(TransformHandle node) {
+    if (!IsValid(node))
+      return;
+
+    if (m_orderDirty)
+      _rebuild_order();
+
+    uint32_t first = _position(node);
+    m_flags[first] |= NODE_DEAD;
+    m_nodes.Remove(node);
+    for (uint32_t i = first + 1; i < m_flags.size(); i++) {
+      if (m_parent[i] != TRANSFORM_NO_PARENT && (m_flags[m_parent[i]] & NODE_DEAD) && !(m_flags[i] & NODE_DEAD)) {
+        m_flags[i] |= NODE_DEAD;
+        m_nodes.Remove(m_owners[i]);
+      }
+    }
+    m_orderDirty = true;
+  }
+
+  bool
+  TransformHierarchy::SetParent(TransformHandle node, TransformHandle parent) {
+    if (!IsValid(node) || (!parent.IsNull() && !IsValid(parent)))
+      return false;
+
+    uint32_t position = _position(node);
+    uint32_t parentPosition = parent.IsNull() ? TRANSFORM_NO_PARENT : _position(parent);
+    for (uint32_t p = parentPosition; p != TRANSFORM_NO_PARENT; p = m_parent[p]) {
+      if (p == position)
+        return false;
+    }
+
+    m_parent[position] = parentPosition;
+    _mark_dirty(position);
+    m_orderDirty = true;
+    return true;
+  }
+
+  TransformHandle
+  TransformHierarchy::GetParent(TransformHandle node) const {
+    if (!IsValid(node))
+      return {};
+
+    uint32_t parent = m_parent[_position(node)];
+    return (parent == TRANSFORM_NO_PARENT) ? TransformHandle{} : m_owners[parent];
+  }
+
+  void
+  TransformHierarchy::SetPosition(TransformHandle node, const glm::vec3& position) {
+    if (!IsValid(node))
+      return;
+    m_position[_position(node)] = position;
+    _mark_dirty(_position(node));
+  }
+
+  void
+  TransformHierarchy::SetRotation(TransformHandle node, const glm::quat& rotation) {
+    if (!IsValid(node))
+      return;
+    m_rotation[_position(node)] = rotation;
+    _mark_dirty(_position(node));
+  }
+
+  void
+  TransformHierarchy::SetScale(TransformHandle node, const glm::vec3& scale) {
+    if (!IsValid(node))
+      return;
+    m_scale[_position(node)] = scale;
+    _mark_dirty(_position(node));
+  }
+
+  void
+  TransformHierarchy::Teleport(TransformHandle node) {
+    if (!IsValid(node))
+      return;
+    m_flags[_position(node)] |= NODE_TELEPORT;
+    _mark_dirty(_position(node));
+  }
+
+  glm::vec3
+  TransformHierarchy::GetPosition(TransformHandle node) const {
+    return IsValid(node) ? m_position[_position(node)] : glm::vec3(0.0f);
+  }
+
+  glm::quat
+  TransformHierarchy::GetRotation(TransformHandle node) const {
+    return IsValid(node) ? m_rotation[_position(node)] : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  }
+
+  glm::vec3
+  TransformHierarchy::GetScale(TransformHandle node) const {
+    return IsValid(node) ? m_scale[_position(node)] : glm::vec3(1.0f);
+  }
+
+  glm::mat4
+  TransformHierarchy::GetWorld(TransformHandle node) const {
+    return IsValid(node) ? m_world[_position(node)] : glm::mat4(1.0f);
+  }
+
+  glm::mat4
+  TransformHierarchy::GetPreviousWorld(TransformHandle node) const {
+    return IsValid(node) ? m_previous[_position(node)] : glm::mat4(1.0f);
+  }
+
+  bool
+  TransformHierarchy::HasChanged(TransformHandle node) const {
+    return IsValid(node) && (m_flags[_position(node)] & NODE_WORLD_CHANGED);
+  }
+
+  // One depth at a time, each split over the job system
+  // A depth only reads the world matrices of the one before it, which is done by then
+  void
+  TransformHierarchy::Update() {
+    if (m_orderDirty)
+      _rebuild_order();
+    // Nothing moved now or last time, so there are no flags to clear either
+    if (!m_dirty && !m_changed)
+      return;
+
+    for (size_t depth = 0; depth + 1 < m_levels.size(); depth++) {
+      uint32_t begin = m_levels[depth];
+      uint32_t count = m_levels[depth + 1] - begin;
+      JobSystem::ParallelFor(count, [this, begin](uint32_t first, uint32_t last) {
+        _update_range(begin + first, begin + last);
+      }, TRANSFORM_JOB_MIN_NODES);
+    }
+
+    m_changed = m_dirty;
+    m_dirty = false;
+  }
+
+  bool
+  TransformHierarchy::IsAccelerated() {
+    static const bool accelerated = _cpu_has_avx2();
+    return accelerated;
+  }
+
+  //
+  // PRIVATE
+  //
+
+  void
+  TransformHierarchy::_mark_dirty(uint32_t position) {
+    m_flags[position] |= NODE_LOCAL_DIRTY;
+    m_dirty = true;
+  }
+
+  // Nodes at one depth, or part of one
+  void
+  TransformHierarchy::_update_range(uint32_t begin, uint32_t end) {
+    NodeArrays nodes = {
+      m_position.data(),
+      m_rotation.data(),
+      m_scale.data(),
+      reinterpret_cast<float*>(m_local.data()),
+      reinterpret_cast<float*>(m_world.data()),
+      reinterpret_cast<float*>(m_previous.data()),
+      m_parent.data(),
+      m_flags.data(),
+    };
+#if defined(TRANSFORM_AVX2)
+    if (IsAccelerated()) {
+      _update_nodes_avx2(nodes, begin, end);
+      return;
+    }
+#endif
+    _update_nodes(nodes, begin, end);
+  }
+
+  template <typename T>
+  static void
+  _permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      sorted.push_back(values[order[i]]);
+    }
+    values.swap(sorted);
+  }
+
+  // Sort the live nodes by depth (a counting sort, nodes at the same depth keep their
+  // relative order) and drop the dead ones
+  void
+  TransformHierarchy::_rebuild_order() {
+    uint32_t count = static_cast<uint32_t>(m_parent.size());
+    std::vector<uint32_t> depths(count, UINT32_MAX);
+    std::vector<uint32_t> chain;
+    uint32_t maxDepth = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (m_flags[i] & NODE_DEAD)
+        continue;
+
+      // Walk up to the first node whose depth is known, then fill in the way back down
+      uint32_t node = i;
+      while (node != TRANSFORM_NO_PARENT && depths[node] == UINT32_MAX) {
+        chain.push_back(node);
+        node = m_parent[node];
+      }
+      uint32_t depth = (node == TRANSFORM_NO_PARENT) ? 0 : depths[node] + 1;
+      while (!chain.empty()) {
+        depths[chain.back()] = depth++;
+        chain.pop_back();
+      }
+      maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    m_levels.assign(count ? maxDepth + 2 : 0, 0);
+    for (uint32_t i = 0; i < count; i++) {
+      if (depths[i] != UINT32_MAX)
+        m_levels[depths[i] + 1]++;
+    }
+    for (size_t d = 1; d < m_levels.size(); d++) {
+      m_levels[d] += m_levels[d - 1];
+    }
+
+    // order[new position] = old position
+    std::vector<uint32_t> next(m_levels.begin(), m_levels.end());
+    std::vector<uint32_t> moved(count, TRANSFORM_NO_PARENT);
+    std::vector<uint32_t> order(m_levels.empty() ? 0 : m_levels.back());
+    for (uint32_t i = 0; i < count; i++) {
+      if (depths[i] == UINT32_MAX)
+        continue;
+      moved[i] = next[depths[i]]++;
+      order[moved[i]] = i;
+    }
+
+    _permute(m_position, order);
+    _permute(m_rotation, order);
+    _permute(m_scale, order);
+    _permute(m_local, order);
+    _permute(m_world, order);
+    _permute(m_previous, order);
+    _permute(m_parent, order);
+    _permute(m_flags, order);
+    _permute(m_owners, order);
+    for (size_t i = 0; i < order.size(); i++) {
+      if (m_parent[i] != TRANSFORM_NO_PARENT)
+        m_parent[i] = moved[m_parent[i]];
+      *m_nodes.Get(m_owners[i]) = static_cast<uint32_t>(i);
+    }
+
+    m_orderDirty = false;
+  }
+}
+
+//
+// PRIVATE
+//
+
+// Translation * rotation * scale, as a column major matrix
+static inline void
+_compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, float* m) {
+  float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+  m[0]  = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+  m[1]  = 2.0f * (x * y + w * z) * scale.x;
+  m[2]  = 2.0f * (x * z - w * y) * scale.x;
+  m[3]  = 0.0f;
+  m[4]  = 2.0f * (x * y - w * z) * scale.y;
+  m[5]  = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+  m[6]  = 2.0f * (y * z + w * x) * scale.y;
+  m[7]  = 0.0f;
+  m[8]  = 2.0f * (x * z + w * y) * scale.z;
+  m[9]  = 2.0f * (y * z - w * x) * scale.z;
+  m[10] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+  m[11] = 0.0f;
+  m[12] = position.x;
+  m[13] = position.y;
+  m[14] = position.z;
+  m[15] = 1.0f;
+}
+
+// Rebuild the local matrix of dirty nodes, and the world matrix of every node that is dirty
+// or whose parent's world matrix changed. Leaves NODE_WORLD_CHANGED on the latter
+// The previous world matrix is kept up to date on the way, it is only copied for nodes that
+// move, or moved last time
+// Done in one pass so that a local matrix is still in cache when its world matrix is built
+static void
+_update_nodes(const NodeArrays& nodes, uint32_t begin, uint32_t end) {
+  for (uint32_t i = begin; i < end; i++) {
+    uint32_t parent = nodes.parent[i];
+    uint8_t flags = nodes.flags[i];
+    bool dirty = flags & NODE_LOCAL_DIRTY;
+    bool changed = dirty || (parent != TRANSFORM_NO_PARENT && (nodes.flags[parent] & NODE_WORLD_CHANGED));
+    bool teleport = (flags & NODE_TELEPORT) || (parent != TRANSFORM_NO_PARENT && (nodes.flags[parent] & NODE_TELEPORTED));
+    nodes.flags[i] = (changed ? NODE_WORLD_CHANGED : 0) | (teleport ? NODE_TELEPORTED : 0);
+
+    float* w = nodes.world + static_cast<size_t>(i) * 16;
+    float* prev = nodes.previous + static_cast<size_t>(i) * 16;
+    // A node that moved last time and not now has stopped where it is
+    if (changed || (flags & NODE_WORLD_CHANGED))
+      memcpy(prev, w, sizeof(float) * 16);
+    if (!changed)
+      continue;
+
+    float* l = nodes.local + static_cast<size_t>(i) * 16;
+    if (dirty)
+      _compose(nodes.position[i], nodes.rotation[i], nodes.scale[i], l);
+    if (parent == TRANSFORM_NO_PARENT) {
+      memcpy(w, l, sizeof(float) * 16);
+    } else {
+      const float* p = nodes.world + static_cast<size_t>(parent) * 16;
+      for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+          w[c * 4 + r] = p[r] * l[c * 4] + p[4 + r] * l[c * 4 + 1] + p[8 + r] * l[c * 4 + 2] + p[12 + r] * l[c * 4 + 3];
+        }
+      }
+    }
+    if (teleport)
+      memcpy(prev, w, sizeof(float) * 16);
+  }
+}
+
+#if defined(TRANSFORM_AVX2)
+// Same as _update_nodes, with world = parent * local done two columns at a time
+// Each half of a broadcast holds the same parent column, and each half of a shuffled local
+// holds one component of one local column, so one FMA does two columns' worth
+TRANSFORM_TARGET_AVX2 static void
+_update_nodes_avx2(const NodeArrays& nodes, uint32_t begin, uint32_t end) {
+  for (uint32_t i = begin; i < end; i++) {
+    uint32_t parent = nodes.parent[i];
+    uint8_t flags = nodes.flags[i];
+    bool dirty = flags & NODE_LOCAL_DIRTY;
+    bool changed = dirty || (parent != TRANSFORM_NO_PARENT && (nodes.flags[parent] & NODE_WORLD_CHANGED));
+    bool teleport = (flags & NODE_TELEPORT) || (parent != TRANSFORM_NO_PARENT && (nodes.flags[parent] & NODE_TELEPORTED));
+    nodes.flags[i] = (changed ? NODE_WORLD_CHANGED : 0) | (teleport ? NODE_TELEPORTED : 0);
+
+    float* w = nodes.world + static_cast<size_t>(i) * 16;
+    float* prev = nodes.previous + static_cast<size_t>(i) * 16;
+    // A node that moved last time and not now has stopped where it is
+    if (changed || (flags & NODE_WORLD_CHANGED))
+      memcpy(prev, w, sizeof(float) * 16);
+    if (!changed)
+      continue;
+
+    float* l = nodes.local + static_cast<size_t>(i) * 16;
+    if (dirty)
+      _compose(nodes.position[i], nodes.rotation[i], nodes.scale[i], l);
+    if (parent == TRANSFORM_NO_PARENT) {
+      _mm256_storeu_ps(w, _mm256_loadu_ps(l));
+      _mm256_storeu_ps(w + 8, _mm256_loadu_ps(l + 8));
+      if (teleport)
+        memcpy(prev, w, sizeof(float) * 16);
+      continue;
+    }
+
+    const float* p = nodes.world + static_cast<size_t>(parent) * 16;
+    __m256 p0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p));
+    __m256 p1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p + 4));
+    __m256 p2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p + 8));
+    __m256 p3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p + 12));
+    for (int half = 0; half < 2; half++) {
+      __m256 columns = _mm256_loadu_ps(l + half * 8);
+      __m256 r = _mm256_mul_ps(p0, _mm256_shuffle_ps(columns, columns, 0x00));
+      r = _mm256_fmadd_ps(p1, _mm256_shuffle_ps(columns, columns, 0x55), r);
+      r = _mm256_fmadd_ps(p2, _mm256_shuffle_ps(columns, columns, 0xAA), r);
+      r = _mm256_fmadd_ps(p3, _mm256_shuffle_ps(columns, columns, 0xFF), r);
+      _mm256_storeu_ps(w + half * 8, r);
+    }
+    if (teleport)
+      memcpy(prev, w, sizeof(float) * 16);
+  }
+}
+#endif
+
+static bool
+_cpu_has_avx2() {
+#if defined(TRANSFORM_AVX2)
+#if defined(__GNUC__) || defined(__clang__)
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  // FMA, OSXSAVE and AVX
+  if ((ecx & (1u << 12)) == 0 || (ecx & (1u << 27)) == 0 || (ecx & (1u << 28)) == 0)
+    return false;
+  // The OS has to save the YMM registers on context switches
+  unsigned int xcr0 = 0, xcr0High = 0;
+  __asm__ volatile ("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+  if ((xcr0 & 6) != 6)
+    return false;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ebx & (1u << 5)) != 0;
+#else
+  int info[4] = {};
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return false;
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#endif
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "defines.hh"
+#include "core/slot_map.hh"
+
+#include <cstdint>
+#include <vector>
+
+// Math lib
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**
+ * transform.hh
+ *
+ * Scene transform hierarchy
+ *
+ * Nodes are stored as structure of arrays (position, rotation, scale, local and world
+ * matrices, parent) sorted breadth first, so every parent comes before its children and
+ * each depth is one contiguous range. Update walks the depths in order and splits each one
+ * over the job system, since nodes at the same depth only read their parent's world matrix,
+ * which the depth before has already finished.
+ *
+ * Changing a node only marks it dirty. Update rebuilds the local matrix of dirty nodes and
+ * the world matrix of everything under them, and leaves the rest alone. World matrices are
+ * multiplied with AVX2 and FMA when the CPU has them.
+ *
+ * Creating, destroying and reparenting nodes only invalidate the order, which is rebuilt
+ * once at the start of the next Update.
+ *
+ * Each node also keeps the world matrix it had before the last Update, so that frames drawn
+ * between two fixed simulation steps can be interpolated. New nodes and nodes passed to
+ * Teleport start out with both the same, so they do not slide in from where they were.
+*/
+
+// Levels smaller than this many nodes are updated on the calling thread
+#define TRANSFORM_JOB_MIN_NODES 2048
+
+namespace Pegasus {
+  typedef SlotHandle TransformHandle;
+
+  class QAPI TransformHierarchy {
+    public:
+      TransformHierarchy() {}
+      ~TransformHierarchy() {}
+      TransformHierarchy(const TransformHierarchy&) = delete;
+      TransformHierarchy& operator= (const TransformHierarchy&) = delete;
+
+      // A null parent makes a root
+      TransformHandle Create(TransformHandle parent = {});
+      // Destroys the node and everything under it
+      void Destroy(TransformHandle node);
+      bool IsValid(TransformHandle node) const { return m_nodes.Contains(node); }
+      // Fails if parent is node itself or one of its descendants
+      bool SetParent(TransformHandle node, TransformHandle parent);
+      TransformHandle GetParent(TransformHandle node) const;
+
+      void SetPosition(TransformHandle node, const glm::vec3& position);
+      void SetRotation(TransformHandle node, const glm::quat& rotation);
+      void SetScale(TransformHandle node, const glm::vec3& scale);
+      glm::vec3 GetPosition(TransformHandle node) const;
+      glm::quat GetRotation(TransformHandle node) const;
+      glm::vec3 GetScale(TransformHandle node) const;
+      // The next Update sets the previous world matrix of the node and everything under it
+      // to the new one, so the move is not interpolated
+      void Teleport(TransformHandle node);
+
+      // As of the last Update
+      glm::mat4 GetWorld(TransformHandle node) const;
+      // As of the Update before that
+      glm::mat4 GetPreviousWorld(TransformHandle node) const;
+      // True if the world matrix changed in the last Update
+      bool HasChanged(TransformHandle node) const;
+
+      void Update();
+
+      size_t GetCount() const { return m_nodes.Size(); }
+      uint32_t GetDepthCount() const { return m_levels.empty() ? 0 : static_cast<uint32_t>(m_levels.size() - 1); }
+      // Whether Update multiplies with AVX2
+      static bool IsAccelerated();
+
+    private:
+      uint32_t _position(TransformHandle node) const { return *m_nodes.Get(node); }
+      void _mark_dirty(uint32_t position);
+      void _rebuild_order();
+      void _update_range(uint32_t begin, uint32_t end);
+
+      // Where each node is in the arrays below
+      SlotMap<uint32_t> m_nodes;
+
+      std::vector<glm::vec3> m_position;
+      std::vector<glm::quat> m_rotation;
+      std::vector<glm::vec3> m_scale;
+      std::vector<glm::mat4> m_local;
+      std::vector<glm::mat4> m_world;
+      std::vector<glm::mat4> m_previous;
+      std::vector<uint32_t> m_parent; // position of the parent, UINT32_MAX for roots
+      std::vector<uint8_t> m_flags;
+      std::vector<TransformHandle> m_owners;
+
+      // Depth d is [m_levels[d], m_levels[d + 1])
+      std::vector<uint32_t> m_levels;
+      bool m_orderDirty = false;
+      bool m_dirty = false;   // some node has NODE_LOCAL_DIRTY
+      bool m_changed = false; // some node has NODE_WORLD_CHANGED
+  };
+}
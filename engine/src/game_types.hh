@@ -1,6 +1,8 @@
 #pragma once
 #include "defines.hh"
 #include "renderer/render_types.hh"
+#include "engine/ecs.hh"
+#include "engine/transform.hh"
 #include <cstdint>
 #include <vector>
 
@@ -12,20 +14,19 @@
 */
 
 namespace Pegasus {
-  class QAPI GameObject  {
-  public:
-    using id_t = uint64_t;
+  // Components the engine itself knows about
+  struct Color {
+    glm::vec3 value{};
+  };
 
-    id_t id() { return m_id; }
+  // Where an entity is, as a node in the game's transform hierarchy
+  struct Transform {
+    TransformHandle node;
+  };
 
-    glm::vec3 color{};
-    std::vector <Vertex> vertices{};
-    std::vector <uint32_t> indices{};
-    static GameObject New(id_t id); 
-    
-  private:
-    id_t m_id;
-    
+  // Entities with a Renderable are drawn with the model the renderer handed out for them
+  struct Renderable {
+    ModelHandle model;
   };
 
   class QAPI  Game {
@@ -33,9 +34,15 @@ namespace Pegasus {
       Game() {}
       ~Game() {}
       static bool Create(Game& game);
-      static GameObject NewGameObject();
+      // Entities of the running game
+      static World& GetWorld();
+      static TransformHierarchy& GetTransforms();
+      // Called once per fixed simulation step, delta_time is the step
       bool Update(float delta_time);
-      bool Render(float delta_time);
+      // Called once per frame, delta_time is the time since the last frame. alpha is how far
+      // the frame is from the last step towards the next one, for drawing anything the engine
+      // does not interpolate itself
+      bool Render(float delta_time, float alpha);
       void Resize(uint32_t width, uint32_t height);
 
     private:
@@ -14,7 +14,8 @@ class StepTimer {
             m_framesThisSecond(0),
             m_qpcSecondCounter(0),
             m_isFixedTimeStep(false),
-            m_targetElapsedTicks(0)
+            m_targetElapsedTicks(0),
+            m_maxUpdatesPerTick(0)
 	    {
 	        m_qpcFrequency = performanceFrequencyEX();
 	        m_qpcLastTime = performanceCounterEX();
@@ -36,6 +37,14 @@ class StepTimer {
         // Get total number of updates since program start
         uint32_t GetFrameCount() const { return m_frameCount; }
 
+        // In fixed timestep mode, how far the current time is from the last update towards
+        // the next one, between 0 and 1. Always 1 in variable timestep mode
+        double GetInterpolationAlpha() const {
+            if (!m_isFixedTimeStep || m_targetElapsedTicks == 0)
+                return 1.0;
+            return static_cast<double>(m_leftOverTicks) / static_cast<double>(m_targetElapsedTicks);
+        }
+
         /// Mutators
         // Set whether to use fixed or variable timestep mode
         void SetFixedTimeStep(bool isFixed) { m_isFixedTimeStep = isFixed; }
@@ -44,6 +53,10 @@ class StepTimer {
         void SetTargetElapsedTicks(uint64_t target) { m_targetElapsedTicks = target; }
         void SetTargetElapsedSeconds(double target) { m_targetElapsedTicks = SecondsToTicks(target); }
 
+        // Set how many updates one Tick may run in fixed timestep mode, 0 for no limit
+        // Whole steps past that are dropped, so a slow update cannot make the next Tick slower still
+        void SetMaxUpdatesPerTick(uint32_t count) { m_maxUpdatesPerTick = count; }
+
         /// Static Members
         // Integer format represents time using 10_000_000 ticks per second
         static const uint64_t TicksPerSecond = 10000000;
@@ -63,11 +76,12 @@ class StepTimer {
             m_qpcSecondCounter = 0;
         }
 
-        typedef void(*LPUPDATEFUNC) (void);
+        typedef void(*LPUPDATEFUNC) (void* context);
 
         // Update timer state, calling the specified update function 
         // the appropriate number of times
-        void Tick(LPUPDATEFUNC update = nullptr) {
+        // context is passed through to update
+        void Tick(LPUPDATEFUNC update = nullptr, void* context = nullptr) {
             unsigned long currentTime;
             currentTime = performanceCounterEX();
 
@@ -90,8 +104,6 @@ class StepTimer {
 
             timeDelta /= static_cast<uint64_t>(m_qpcFrequency);
 
-            uint32_t lastFrameCount = m_frameCount;
-
             if (m_isFixedTimeStep) {
                 // If app is runniing close to target elapsed time (withing 1/4 of millisecond)
                 // just clamp the clock to exactly match the target value. This prevents 
@@ -102,14 +114,22 @@ class StepTimer {
 
                 m_leftOverTicks += timeDelta;
 
+                uint32_t updates = 0;
                 while (m_leftOverTicks >= m_targetElapsedTicks) {
+                    // Behind by more than we may catch up on, keep only the part of a step
+                    if (m_maxUpdatesPerTick != 0 && updates == m_maxUpdatesPerTick) {
+                        m_leftOverTicks %= m_targetElapsedTicks;
+                        break;
+                    }
+
                     m_elapsedTicks = m_targetElapsedTicks;
                     m_totalTicks += m_targetElapsedTicks;
                     m_leftOverTicks -= m_targetElapsedTicks;
                     m_frameCount++;
+                    updates++;
 
                     if (update) {
-                        update();
+                        update(context);
                     }
                 }
             } else {
@@ -120,12 +140,12 @@ class StepTimer {
                 m_frameCount++;
 
                 if (update)
-                    update();
+                    update(context);
             }
 
             // Track current framerate
-            if (m_frameCount != lastFrameCount)
-                m_framesThisSecond++;
+            // Every Tick is a frame, however many updates it ran
+            m_framesThisSecond++;
 
             if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency)) {
                 m_fps = m_framesThisSecond;
@@ -170,6 +190,7 @@ class StepTimer {
         // For configuring the fixed timestep mode
         bool m_isFixedTimeStep;
         uint64_t m_targetElapsedTicks;
+        uint32_t m_maxUpdatesPerTick;
 };
 
 #endif // Q_PLATFORM_LINUX
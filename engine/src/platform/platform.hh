@@ -10,6 +10,16 @@
 #include <sys/types.h>
 #include <chrono>
 
+// A read-only view of a file that has been mapped into memory
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef Q_PLATFORM_WINDOWS
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
 class Platform {
 public:
     Platform(std::string name, uint32_t width, uint32_t height);
@@ -19,10 +29,17 @@ public:
     static void create_window();
     static void destroy_window();
     static bool pump_messages();
+    // Block until the window has messages or timeout seconds have passed, a negative timeout
+    // waits for messages only. Returns true if there are messages to pump
+    static bool wait_messages(double timeout);
     static bool create_vulkan_surface(VKCommonParameters &params);
     static void set_title(std::string title);
     static std::chrono::time_point<std::chrono::high_resolution_clock> get_current_time();
 
+    // FILES
+    static bool map_file(const std::string& path, MappedFile& file);
+    static void unmap_file(MappedFile& file);
+
     // WINDOWING INFO
 #ifdef Q_PLATFORM_LINUX
     // LINUX WINDOWING
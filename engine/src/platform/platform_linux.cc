@@ -23,6 +23,12 @@
 #include <X11/Xlib-xcb.h>
 #include <X11/X.h>
 #include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 struct PlatformState {
     std::string name;
@@ -76,6 +82,42 @@ Platform::get_current_time() {
     return std::chrono::high_resolution_clock::now();
 }
 
+// Map a whole file into memory as read-only
+// The descriptor can be closed right away, the mapping keeps the file alive
+bool
+Platform::map_file(const std::string& path, MappedFile& file) {
+    file = {};
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    // Let the kernel know we are going to read the file front to back
+    madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    file.data = static_cast<const uint8_t*>(data);
+    file.size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void
+Platform::unmap_file(MappedFile& file) {
+    if (file.data)
+        munmap(const_cast<uint8_t*>(file.data), file.size);
+    file = {};
+}
+
 // Set the title of the window
 void
 Platform::set_title(std::string title) {
@@ -93,6 +135,10 @@ Platform::set_title(std::string title) {
 // Create an instance of a window
 void
 Platform::create_window() {
+    // The renderer presents from its own thread, so Xlib has to be made thread safe
+    // before anything else is done with it
+    XInitThreads();
+
     // Open connection to the X server
     linux_state.display = XOpenDisplay(nullptr);
 
@@ -110,7 +156,7 @@ Platform::create_window() {
             white);
 
     // Set the event types the window wants to be notified by the X server
-    XSelectInput(linux_state.display, linux_state.window, KeyPressMask | KeyReleaseMask | StructureNotifyMask | ExposureMask);
+    XSelectInput(linux_state.display, linux_state.window, KeyPressMask | KeyReleaseMask | PointerMotionMask | StructureNotifyMask | ExposureMask | FocusChangeMask);
 
     // Also request to be notified when the window is deleted
     Atom wm_protocols = XInternAtom(linux_state.display, "WM_PROTOCOLS", true);
@@ -177,6 +223,18 @@ Platform::handle_x11_event(XEvent& event) {
 
             break;
         
+        case FocusIn:
+        case FocusOut:
+            // Keyboard grabs (ie while the window manager moves the window) do not change
+            // which window the user is working in
+            if (event.xfocus.mode == NotifyGrab || event.xfocus.mode == NotifyUngrab)
+                break;
+            {
+                EventContext data = {};
+                data.u8[0] = (event.type == FocusIn) ? 1 : 0;
+                EventHandler::Fire(EVENT_CODE_FOCUS_CHANGED, nullptr, data);
+            } break;
+
         case KeyPress:
             code = event.xkey.keycode;
             keysym = XkbKeycodeToKeysym(linux_state.display, code, 0, code & ShiftMask ? 1: 0);
@@ -191,6 +249,10 @@ Platform::handle_x11_event(XEvent& event) {
             InputHandler::ProcessKey(key, true);
             break;
 
+        case MotionNotify:
+            InputHandler::ProcessMouseMove(event.xmotion.x, event.xmotion.y);
+            break;
+
         default:
             break;
     }
@@ -208,6 +270,28 @@ Platform::pump_messages() {
     return true;
 }
 
+// Sleep on the connection to the X server instead of asking it for events over and over
+// The renderer's thread also reads from the connection when it presents, so events can be
+// queued in Xlib without anything left on the socket. Those are checked for first, along
+// with whatever the server sends back once our requests are flushed
+bool
+Platform::wait_messages(double timeout) {
+    if (XEventsQueued(linux_state.display, QueuedAfterFlush) > 0)
+        return true;
+
+    pollfd connection = {};
+    connection.fd = ConnectionNumber(linux_state.display);
+    connection.events = POLLIN;
+
+    timespec wait = {};
+    if (timeout >= 0.0) {
+        wait.tv_sec = static_cast<time_t>(timeout);
+        wait.tv_nsec = static_cast<long>((timeout - static_cast<double>(wait.tv_sec)) * 1e9);
+    }
+
+    return ppoll(&connection, 1, (timeout >= 0.0) ? &wait : nullptr, nullptr) > 0;
+}
+
 // Linux specific vulkan surface creation
 bool
 Platform::create_vulkan_surface(VKCommonParameters &params) {
@@ -1,6 +1,11 @@
 #include "platform.hh"
 
 #ifdef Q_PLATFORM_WINDOWS
+#include <windowsx.h> // GET_X_LPARAM, GET_Y_LPARAM
+#include <cmath>
+
+// Scheduler tick to assume when Windows won't say, the default timer resolution
+#define WINDOWS_DEFAULT_SCHEDULER_TICK 0.015625
 
 struct PlatformState {
 	std::string name;
@@ -95,6 +100,59 @@ Platform::get_current_time() {
 	return std::chrono::high_resolution_clock::now();
 }
 
+// Map a whole file into memory as read-only
+bool
+Platform::map_file(const std::string& path, MappedFile& file) {
+	file = {};
+
+	file.file = CreateFileA(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (file.file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file.file, &size) || size.QuadPart <= 0) {
+		CloseHandle(file.file);
+		file = {};
+		return false;
+	}
+
+	file.mapping = CreateFileMappingA(file.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (file.mapping == nullptr) {
+		CloseHandle(file.file);
+		file = {};
+		return false;
+	}
+
+	file.data = static_cast<const uint8_t*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+	if (file.data == nullptr) {
+		CloseHandle(file.mapping);
+		CloseHandle(file.file);
+		file = {};
+		return false;
+	}
+
+	file.size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void
+Platform::unmap_file(MappedFile& file) {
+	if (file.data)
+		UnmapViewOfFile(file.data);
+	if (file.mapping)
+		CloseHandle(file.mapping);
+	if (file.file != INVALID_HANDLE_VALUE)
+		CloseHandle(file.file);
+	file = {};
+}
+
 // Set the title of the window
 void
 Platform::set_title(std::string title) {
@@ -181,6 +239,33 @@ Platform::pump_messages() {
 	return true;
 }
 
+// Length of a scheduler tick, waits wake up on one so they can run over by up to this much
+static double
+_scheduler_tick() {
+	DWORD adjustment = 0;
+	DWORD increment = 0;
+	BOOL disabled = FALSE;
+	if (GetSystemTimeAdjustment(&adjustment, &increment, &disabled) && increment > 0)
+		return static_cast<double>(increment) * 1e-7;
+	return WINDOWS_DEFAULT_SCHEDULER_TICK;
+}
+
+// Sleep until a message comes in or the timeout runs out
+// Messages already sitting in the queue count, so nothing that arrived since the last pump is missed
+// The wait stops a tick short of the timeout so it can't oversleep, and with less than a tick
+// left it only checks the queue, leaving the rest of the time to the caller
+bool
+Platform::wait_messages(double timeout) {
+	static const double tick = _scheduler_tick();
+
+	DWORD milliseconds = INFINITE;
+	if (timeout >= 0.0)
+		milliseconds = (timeout < tick) ? 0 : static_cast<DWORD>(std::ceil((timeout - tick) * 1000.0));
+	DWORD result = MsgWaitForMultipleObjectsEx(0, nullptr, milliseconds, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+	return result == WAIT_OBJECT_0;
+}
+
 // Windows implementation for getting a vulkan surface
 bool
 Platform::create_vulkan_surface(VKCommonParameters &params) {
@@ -230,6 +315,13 @@ Platform::WindowProc(
 			);
 		} break;
 
+		case WM_SETFOCUS:
+		case WM_KILLFOCUS: {
+			EventContext data = {};
+			data.u8[0] = (code == WM_SETFOCUS) ? 1 : 0;
+			EventHandler::Fire(EVENT_CODE_FOCUS_CHANGED, nullptr, data);
+		} break;
+
 		case WM_KEYDOWN:
 		case WM_KEYUP:
 		case WM_SYSKEYDOWN:
@@ -239,10 +331,10 @@ Platform::WindowProc(
 
 			// Pass the input subsystem
 			InputHandler::ProcessKey(key, pressed);
-		}
+		} break;
 
 		case WM_MOUSEMOVE:
-			// Fire an event for mouse movement
+			InputHandler::ProcessMouseMove(GET_X_LPARAM(l_param), GET_Y_LPARAM(l_param));
 			break;
 		case WM_MOUSEWHEEL:
 			// Fire an event for mouse movement
@@ -0,0 +1,413 @@
+#include "render_graph.hh"
+
+RGHandle
+RenderGraph::CreateImage(const std::string& name, uint32_t width, uint32_t height, RGFormat format) {
+    RGResource resource = {};
+    resource.name = name;
+    resource.desc.type = RG_RESOURCE_IMAGE;
+    resource.desc.width = width;
+    resource.desc.height = height;
+    resource.desc.format = format;
+    m_resources.push_back(resource);
+    return static_cast<RGHandle>(m_resources.size() - 1);
+}
+
+RGHandle
+RenderGraph::CreateBuffer(const std::string& name, uint64_t size) {
+    RGResource resource = {};
+    resource.name = name;
+    resource.desc.type = RG_RESOURCE_BUFFER;
+    resource.desc.size = size;
+    m_resources.push_back(resource);
+    return static_cast<RGHandle>(m_resources.size() - 1);
+}
+
+RGHandle
+RenderGraph::ImportImage(
+        const std::string& name,
+        const RGResourceDesc& desc,
+        RGAccess initialAccess,
+        RGAccess finalAccess,
+        bool discardInitial
+) {
+    RGResource resource = {};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.initialAccess = initialAccess;
+    resource.finalAccess = finalAccess;
+    resource.discardInitial = discardInitial;
+    m_resources.push_back(resource);
+    return static_cast<RGHandle>(m_resources.size() - 1);
+}
+
+uint32_t
+RenderGraph::AddPass(const std::string& name, RGExecuteFn execute) {
+    RGPass pass = {};
+    pass.name = name;
+    pass.execute = execute;
+    m_passes.push_back(pass);
+    return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void
+RenderGraph::Read(uint32_t pass, RGHandle resource, RGAccess access) {
+    RGResourceUse use = {};
+    use.resource = resource;
+    use.access = access;
+    m_passes[pass].reads.push_back(use);
+}
+
+void
+RenderGraph::Write(uint32_t pass, RGHandle resource, RGAccess access, RGLoadOp load, const float* clear) {
+    RGResourceUse use = {};
+    use.resource = resource;
+    use.access = access;
+    use.load = load;
+    if (clear) {
+        for (int i = 0; i < 4; i++) {
+            use.clear[i] = clear[i];
+        }
+    }
+    m_passes[pass].writes.push_back(use);
+}
+
+void
+RenderGraph::SetSideEffect(uint32_t pass) {
+    m_passes[pass].sideEffect = true;
+}
+
+bool
+RenderGraph::Compile(RGMemoryQuery query) {
+    m_order.clear();
+    m_finalBarriers.clear();
+    m_blocks.clear();
+    m_stats = {};
+    m_compiled = false;
+
+    _cull();
+    if (!_compute_lifetimes())
+        return false;
+    _assign_memory(query);
+    _schedule_barriers();
+
+    m_stats.passes = static_cast<uint32_t>(m_order.size());
+    m_stats.culledPasses = static_cast<uint32_t>(m_passes.size() - m_order.size());
+    m_compiled = true;
+    return true;
+}
+
+void
+RenderGraph::ExecutePass(uint32_t pass, void* commandBuffer) const {
+    if (!m_passes[pass].execute)
+        return;
+
+    RGPassContext context = {};
+    context.graph = this;
+    context.pass = pass;
+    context.commandBuffer = commandBuffer;
+    m_passes[pass].execute(context);
+}
+
+void
+RenderGraph::Reset() {
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_finalBarriers.clear();
+    m_blocks.clear();
+    m_stats = {};
+    m_compiled = false;
+}
+
+bool
+RenderGraph::IsWrite(RGAccess access) {
+    switch (access) {
+        case RG_ACCESS_COLOR_ATTACHMENT:
+        case RG_ACCESS_DEPTH_ATTACHMENT:
+        case RG_ACCESS_STORAGE_WRITE:
+        case RG_ACCESS_TRANSFER_DST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint64_t
+RenderGraph::EstimateSize(const RGResourceDesc& desc) {
+    if (desc.type == RG_RESOURCE_BUFFER)
+        return desc.size;
+
+    uint64_t texelSize = 4;
+    if (desc.format == RG_FORMAT_RGBA16_FLOAT)
+        texelSize = 8;
+    return static_cast<uint64_t>(desc.width) * desc.height * texelSize;
+}
+
+//
+// PRIVATE
+//
+
+// Walk back from the outputs of the graph and drop every pass that does not contribute to them
+// A pass is needed if it has side effects, or writes a resource that something still reads.
+// Imported resources with a final access count as read, since they are used after the graph
+void
+RenderGraph::_cull() {
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        RGResource& resource = m_resources[i];
+        resource.refCount = (resource.imported && resource.finalAccess != RG_ACCESS_NONE) ? 1 : 0;
+    }
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        RGPass& pass = m_passes[p];
+        pass.culled = false;
+        pass.barriers.clear();
+        pass.refCount = static_cast<uint32_t>(pass.writes.size()) + (pass.sideEffect ? 1 : 0);
+        for (size_t r = 0; r < pass.reads.size(); r++) {
+            m_resources[pass.reads[r].resource].refCount++;
+        }
+    }
+
+    std::vector<RGHandle> unreferenced;
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        if (m_resources[i].refCount == 0)
+            unreferenced.push_back(static_cast<RGHandle>(i));
+    }
+
+    // Passes that write nothing and have no side effects do nothing useful
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        RGPass& pass = m_passes[p];
+        if (pass.refCount != 0)
+            continue;
+
+        pass.culled = true;
+        for (size_t r = 0; r < pass.reads.size(); r++) {
+            if (--m_resources[pass.reads[r].resource].refCount == 0)
+                unreferenced.push_back(pass.reads[r].resource);
+        }
+    }
+
+    while (!unreferenced.empty()) {
+        RGHandle handle = unreferenced.back();
+        unreferenced.pop_back();
+
+        // Nobody reads this resource, so writing it does not count toward keeping its writers
+        for (size_t p = 0; p < m_passes.size(); p++) {
+            RGPass& pass = m_passes[p];
+            if (pass.culled)
+                continue;
+
+            for (size_t w = 0; w < pass.writes.size(); w++) {
+                if (pass.writes[w].resource != handle)
+                    continue;
+
+                if (--pass.refCount == 0) {
+                    pass.culled = true;
+                    for (size_t r = 0; r < pass.reads.size(); r++) {
+                        RGResource& read = m_resources[pass.reads[r].resource];
+                        if (--read.refCount == 0)
+                            unreferenced.push_back(pass.reads[r].resource);
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        if (!m_passes[p].culled)
+            m_order.push_back(static_cast<uint32_t>(p));
+    }
+}
+
+// Passes run in the order they were added, so a resource lives from the first surviving pass
+// that touches it to the last one
+bool
+RenderGraph::_compute_lifetimes() {
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        m_resources[i].accessMask = 0;
+        m_resources[i].firstPass = UINT32_MAX;
+        m_resources[i].lastPass = 0;
+        m_resources[i].block = UINT32_MAX;
+        m_resources[i].aliasPrev = RG_INVALID_HANDLE;
+    }
+
+    std::vector<bool> written(m_resources.size(), false);
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        const RGPass& pass = m_passes[m_order[o]];
+        for (size_t r = 0; r < pass.reads.size(); r++) {
+            RGHandle handle = pass.reads[r].resource;
+            RGResource& resource = m_resources[handle];
+            if (!resource.imported && !written[handle]) {
+                std::cerr << "Error: render graph pass " << pass.name << " reads " << resource.name
+                    << " before anything writes it" << std::endl;
+                return false;
+            }
+            resource.accessMask |= 1u << pass.reads[r].access;
+            resource.firstPass = std::min(resource.firstPass, o);
+            resource.lastPass = std::max(resource.lastPass, o);
+        }
+        for (size_t w = 0; w < pass.writes.size(); w++) {
+            RGHandle handle = pass.writes[w].resource;
+            RGResource& resource = m_resources[handle];
+            written[handle] = true;
+            resource.accessMask |= 1u << pass.writes[w].access;
+            resource.firstPass = std::min(resource.firstPass, o);
+            resource.lastPass = std::max(resource.lastPass, o);
+        }
+    }
+    return true;
+}
+
+// Give each transient a memory block. Biggest resources are placed first, and a resource
+// joins the first block whose current users are all dead before it is first used (or not
+// yet alive after it is last used), so blocks are sized by their largest resource
+void
+RenderGraph::_assign_memory(RGMemoryQuery& query) {
+    std::vector<RGHandle> transients;
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        RGResource& resource = m_resources[i];
+        if (resource.imported || resource.firstPass == UINT32_MAX)
+            continue;
+
+        if (query) {
+            resource.memory = query(resource);
+        } else {
+            resource.memory = {};
+            resource.memory.size = EstimateSize(resource.desc);
+        }
+        transients.push_back(static_cast<RGHandle>(i));
+        m_stats.transientResources++;
+        m_stats.transientBytes += resource.memory.size;
+    }
+
+    std::sort(transients.begin(), transients.end(), [this](RGHandle a, RGHandle b) {
+        return m_resources[a].memory.size > m_resources[b].memory.size;
+    });
+
+    for (size_t t = 0; t < transients.size(); t++) {
+        RGResource& resource = m_resources[transients[t]];
+
+        uint32_t chosen = UINT32_MAX;
+        for (uint32_t b = 0; b < m_blocks.size() && chosen == UINT32_MAX; b++) {
+            const RGMemoryBlock& block = m_blocks[b];
+            if ((block.typeBits & resource.memory.typeBits) == 0)
+                continue;
+
+            bool overlaps = false;
+            for (size_t u = 0; u < block.resources.size() && !overlaps; u++) {
+                const RGResource& user = m_resources[block.resources[u]];
+                overlaps = !(user.lastPass < resource.firstPass || resource.lastPass < user.firstPass);
+            }
+            if (!overlaps)
+                chosen = b;
+        }
+
+        if (chosen == UINT32_MAX) {
+            m_blocks.push_back(RGMemoryBlock());
+            chosen = static_cast<uint32_t>(m_blocks.size() - 1);
+        }
+
+        RGMemoryBlock& block = m_blocks[chosen];
+        block.size = std::max(block.size, resource.memory.size);
+        block.alignment = std::max(block.alignment, resource.memory.alignment);
+        block.typeBits &= resource.memory.typeBits;
+        block.resources.push_back(transients[t]);
+        resource.block = chosen;
+    }
+
+    // Within a block, each resource takes over from the one used right before it
+    for (size_t b = 0; b < m_blocks.size(); b++) {
+        RGMemoryBlock& block = m_blocks[b];
+        std::sort(block.resources.begin(), block.resources.end(), [this](RGHandle a, RGHandle c) {
+            return m_resources[a].firstPass < m_resources[c].firstPass;
+        });
+        for (size_t u = 1; u < block.resources.size(); u++) {
+            m_resources[block.resources[u]].aliasPrev = block.resources[u - 1];
+        }
+        m_stats.allocatedBytes += block.size;
+    }
+    m_stats.savedBytes = m_stats.transientBytes - m_stats.allocatedBytes;
+}
+
+// Track the last access of every resource through the passes, and only emit a barrier when
+// the next access needs one: after a write, when the access (and so the layout) changes,
+// or on the first use of a transient. Two reads of the same kind in a row need nothing
+void
+RenderGraph::_schedule_barriers() {
+    std::vector<RGAccess> last(m_resources.size(), RG_ACCESS_NONE);
+    std::vector<bool> touched(m_resources.size(), false);
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        if (m_resources[i].imported)
+            last[i] = m_resources[i].initialAccess;
+    }
+
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        RGPass& pass = m_passes[m_order[o]];
+
+        std::vector<RGResourceUse> uses = pass.reads;
+        uses.insert(uses.end(), pass.writes.begin(), pass.writes.end());
+        for (size_t u = 0; u < uses.size(); u++) {
+            RGHandle handle = uses[u].resource;
+            RGAccess access = uses[u].access;
+            const RGResource& resource = m_resources[handle];
+
+            // The same resource used twice by one pass (ie read and written) only gets one
+            // barrier, to the access listed last
+            bool seen = false;
+            for (size_t b = 0; b < pass.barriers.size(); b++) {
+                if (pass.barriers[b].resource == handle) {
+                    pass.barriers[b].after = access;
+                    seen = true;
+                }
+            }
+            if (seen) {
+                last[handle] = access;
+                continue;
+            }
+
+            RGBarrier barrier = {};
+            barrier.resource = handle;
+            barrier.before = last[handle];
+            barrier.after = access;
+
+            bool needed = false;
+            if (!touched[handle]) {
+                if (resource.imported) {
+                    barrier.discard = resource.discardInitial;
+                    needed = resource.discardInitial || last[handle] != access || IsWrite(last[handle]);
+                } else {
+                    // First use of a transient. Its contents are undefined, but it has to
+                    // wait for whatever used the same memory before it in this frame. Earlier frames
+                    // are the backend's problem, it must not hand out memory a frame in flight uses
+                    barrier.discard = true;
+                    barrier.before = (resource.aliasPrev != RG_INVALID_HANDLE) ? last[resource.aliasPrev] : RG_ACCESS_NONE;
+                    needed = true;
+                }
+            } else {
+                needed = last[handle] != access || IsWrite(access) || IsWrite(last[handle]);
+            }
+
+            if (needed)
+                pass.barriers.push_back(barrier);
+
+            touched[handle] = true;
+            last[handle] = access;
+        }
+        m_stats.barriers += static_cast<uint32_t>(pass.barriers.size());
+    }
+
+    // Leave imported resources the way the owner expects them
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        const RGResource& resource = m_resources[i];
+        if (!resource.imported || resource.finalAccess == RG_ACCESS_NONE)
+            continue;
+        if (last[i] == resource.finalAccess && !IsWrite(last[i]))
+            continue;
+
+        RGBarrier barrier = {};
+        barrier.resource = static_cast<RGHandle>(i);
+        barrier.before = last[i];
+        barrier.after = resource.finalAccess;
+        m_finalBarriers.push_back(barrier);
+    }
+    m_stats.barriers += static_cast<uint32_t>(m_finalBarriers.size());
+}
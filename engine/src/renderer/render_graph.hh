@@ -0,0 +1,209 @@
+#pragma once
+
+/**
+ * render_graph.hh
+ *
+ * Backend-agnostic description of the passes that make up a frame.
+ * Passes declare which resources they read and write and how. Compiling the graph
+ *  - culls passes whose results are never used
+ *  - works out the barriers (and layout transitions) needed between passes, and only those
+ *  - gives each transient resource a lifetime and lets resources whose lifetimes do not
+ *    overlap share the same memory
+ * Compiling does not touch the GPU, so a graph can be built and checked without a device.
+ * The backend turns the compiled graph into API calls (see vulkan/vkrendergraph.hh).
+*/
+
+#include "stdafx.hh"
+#include <cstdint>
+#include <functional>
+
+typedef uint32_t RGHandle;
+#define RG_INVALID_HANDLE UINT32_MAX
+
+enum RGResourceType {
+    RG_RESOURCE_IMAGE,
+    RG_RESOURCE_BUFFER,
+};
+
+enum RGFormat {
+    RG_FORMAT_UNDEFINED,
+    RG_FORMAT_RGBA8_UNORM,
+    RG_FORMAT_BGRA8_UNORM,
+    RG_FORMAT_RGBA16_FLOAT,
+    RG_FORMAT_R32_FLOAT,
+    RG_FORMAT_D32_FLOAT,
+};
+
+// How a pass uses a resource
+enum RGAccess {
+    RG_ACCESS_NONE,
+    RG_ACCESS_COLOR_ATTACHMENT,
+    RG_ACCESS_DEPTH_ATTACHMENT,
+    RG_ACCESS_DEPTH_READ,      // depth test without writes
+    RG_ACCESS_SHADER_READ,     // sampled image or uniform/storage buffer read
+    RG_ACCESS_STORAGE_WRITE,   // storage image or buffer written by a shader
+    RG_ACCESS_TRANSFER_SRC,
+    RG_ACCESS_TRANSFER_DST,
+    RG_ACCESS_PRESENT,
+};
+
+enum RGLoadOp {
+    RG_LOAD_OP_LOAD,
+    RG_LOAD_OP_CLEAR,
+    RG_LOAD_OP_DONT_CARE,
+};
+
+struct RGResourceDesc {
+    RGResourceType type = RG_RESOURCE_IMAGE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    RGFormat format = RG_FORMAT_UNDEFINED;
+    uint64_t size = 0; // buffers only
+};
+
+// Memory a transient resource needs, as reported by the backend
+// Resources can only share memory when their typeBits overlap
+struct RGMemoryRequirements {
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    uint32_t typeBits = UINT32_MAX;
+};
+
+// A transition to apply before a pass (or after the last one)
+struct RGBarrier {
+    RGHandle resource = RG_INVALID_HANDLE;
+    RGAccess before = RG_ACCESS_NONE;
+    RGAccess after = RG_ACCESS_NONE;
+    bool discard = false; // previous contents are not needed (ie first use of a transient)
+};
+
+struct RGResourceUse {
+    RGHandle resource = RG_INVALID_HANDLE;
+    RGAccess access = RG_ACCESS_NONE;
+    RGLoadOp load = RG_LOAD_OP_LOAD; // attachments only
+    float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+struct RGResource {
+    std::string name;
+    RGResourceDesc desc;
+    bool imported = false;
+    RGAccess initialAccess = RG_ACCESS_NONE; // imported only
+    RGAccess finalAccess = RG_ACCESS_NONE;   // imported only, access the resource is left in
+    bool discardInitial = false;             // imported only, contents on entry are not needed
+
+    // Filled in by Compile
+    uint32_t accessMask = 0;         // bit per RGAccess used on it by the surviving passes
+    uint32_t firstPass = UINT32_MAX; // index into the compiled pass list
+    uint32_t lastPass = 0;
+    uint32_t refCount = 0;
+    RGMemoryRequirements memory;
+    uint32_t block = UINT32_MAX;     // memory block for transients, UINT32_MAX if not allocated
+    RGHandle aliasPrev = RG_INVALID_HANDLE; // resource that used the block before this one
+};
+
+class RenderGraph;
+
+// Handed to a pass when it is executed
+// commandBuffer is whatever the backend records into (ie a VkCommandBuffer)
+struct RGPassContext {
+    const RenderGraph* graph = nullptr;
+    uint32_t pass = 0;
+    void* commandBuffer = nullptr;
+};
+
+typedef std::function<void(RGPassContext&)> RGExecuteFn;
+
+struct RGPass {
+    std::string name;
+    RGExecuteFn execute;
+    std::vector<RGResourceUse> reads;
+    std::vector<RGResourceUse> writes;
+    bool sideEffect = false; // never culled (ie writes to something outside the graph)
+
+    // Filled in by Compile
+    bool culled = false;
+    uint32_t refCount = 0;
+    std::vector<RGBarrier> barriers; // applied before the pass runs
+};
+
+// Memory shared by transient resources that are never alive at the same time
+struct RGMemoryBlock {
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    uint32_t typeBits = UINT32_MAX;
+    std::vector<RGHandle> resources;
+};
+
+struct RGStats {
+    uint32_t passes = 0;
+    uint32_t culledPasses = 0;
+    uint32_t barriers = 0;
+    uint32_t transientResources = 0;
+    uint64_t transientBytes = 0; // memory the transients would need on their own
+    uint64_t allocatedBytes = 0; // memory they need when aliased
+    uint64_t savedBytes = 0;
+};
+
+// Backend hook that reports the memory a transient will need
+// Without one, the size is estimated from the description
+typedef std::function<RGMemoryRequirements(const RGResource&)> RGMemoryQuery;
+
+class RenderGraph {
+    public:
+        RenderGraph() {}
+
+        // Resources that only live inside the graph
+        RGHandle CreateImage(const std::string& name, uint32_t width, uint32_t height, RGFormat format);
+        RGHandle CreateBuffer(const std::string& name, uint64_t size);
+        // Resources owned outside of the graph (ie the swapchain image)
+        // They are transitioned to finalAccess once the graph is done with them
+        RGHandle ImportImage(
+                const std::string& name,
+                const RGResourceDesc& desc,
+                RGAccess initialAccess,
+                RGAccess finalAccess,
+                bool discardInitial = false);
+
+        uint32_t AddPass(const std::string& name, RGExecuteFn execute);
+        void Read(uint32_t pass, RGHandle resource, RGAccess access);
+        void Write(uint32_t pass, RGHandle resource, RGAccess access, RGLoadOp load = RG_LOAD_OP_LOAD, const float* clear = nullptr);
+        void SetSideEffect(uint32_t pass);
+
+        // Cull, schedule barriers and assign memory
+        // Returns false if a pass reads something that nothing wrote before it
+        bool Compile(RGMemoryQuery query = nullptr);
+
+        // Run the surviving passes in order. The backend records the barriers of each pass
+        // before calling this for it
+        void ExecutePass(uint32_t pass, void* commandBuffer) const;
+
+        // Clear everything so that the graph can be built again for the next frame
+        void Reset();
+
+        const std::vector<RGPass>& GetPasses() const { return m_passes; }
+        const std::vector<RGResource>& GetResources() const { return m_resources; }
+        const std::vector<uint32_t>& GetOrder() const { return m_order; }
+        const std::vector<RGBarrier>& GetFinalBarriers() const { return m_finalBarriers; }
+        const std::vector<RGMemoryBlock>& GetMemoryBlocks() const { return m_blocks; }
+        const RGResource& GetResource(RGHandle handle) const { return m_resources[handle]; }
+        const RGStats& GetStats() const { return m_stats; }
+        bool IsCompiled() const { return m_compiled; }
+
+        static bool IsWrite(RGAccess access);
+        static uint64_t EstimateSize(const RGResourceDesc& desc);
+
+    private:
+        void _cull();
+        bool _compute_lifetimes();
+        void _assign_memory(RGMemoryQuery& query);
+        void _schedule_barriers();
+
+        std::vector<RGResource> m_resources;
+        std::vector<RGPass> m_passes;
+        std::vector<uint32_t> m_order; // surviving passes in execution order
+        std::vector<RGBarrier> m_finalBarriers;
+        std::vector<RGMemoryBlock> m_blocks;
+        RGStats m_stats;
+        bool m_compiled = false;
+};
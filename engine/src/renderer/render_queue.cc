@@ -0,0 +1,250 @@
+#include "render_queue.hh"
+
+#include <cstring>
+
+// Keys are sorted a byte at a time
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+// Ranges this small are finished with an insertion sort
+#define RADIX_INSERTION_CUTOFF 48
+// Most runs of bits a packed key is gathered from, the rest are taken as one run
+#define RADIX_MAX_RUNS 4
+
+// Fold an id down to bits, mixing in its high bits so ids that only differ there stay apart
+static inline uint64_t
+_fold(uint64_t id, uint32_t bits) {
+    uint64_t mask = (1ULL << bits) - 1;
+    uint64_t folded = 0;
+    while (id != 0) {
+        folded ^= id & mask;
+        id >>= bits;
+    }
+    return folded;
+}
+
+// Bits needed to hold value
+static uint32_t
+_bit_width(uint64_t value) {
+    uint32_t width = 0;
+    for (; value != 0; value >>= 1)
+        width++;
+    return width;
+}
+
+static uint32_t
+_lowest_bit(uint64_t value) {
+    uint32_t bit = 0;
+    while (!((value >> bit) & 1))
+        bit++;
+    return bit;
+}
+
+// Stable, keys are only moved past larger ones
+static void
+_insertion_sort(RenderItem* items, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        RenderItem item = items[i];
+        size_t j = i;
+        for (; j > 0 && items[j - 1].key > item.key; j--) {
+            items[j] = items[j - 1];
+        }
+        items[j] = item;
+    }
+}
+
+// LSD radix sort of packed keys on bits [low, low + bits), a byte at a time
+// The histograms of every pass are built in one read, and a byte every key shares is
+// skipped. Returns the buffer the sorted keys ended up in
+static uint64_t*
+_sort_packed(uint64_t* keys, uint64_t* scratch, size_t count, uint32_t low, uint32_t bits) {
+    uint32_t passes = (bits + RADIX_BITS - 1) / RADIX_BITS;
+    uint32_t histograms[64 / RADIX_BITS][RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms[0]) * passes);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = keys[i] >> low;
+        for (uint32_t pass = 0; pass < passes; pass++) {
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    uint64_t* src = keys;
+    uint64_t* dst = scratch;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        uint32_t* histogram = histograms[pass];
+        uint32_t shift = low + pass * RADIX_BITS;
+        if (histogram[(src[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+            continue;
+
+        // Turn the counts into the offset each bucket starts at
+        uint32_t offset = 0;
+        for (uint32_t b = 0; b < RADIX_BUCKETS; b++) {
+            uint32_t bucket = histogram[b];
+            histogram[b] = offset;
+            offset += bucket;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[histogram[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    return src;
+}
+
+// Sort the range on the bits set in varying (the ones its keys do not all share)
+// The range is at first in m_items when inItems is set, in m_scratch otherwise, and the
+// sorted items always end up in m_items. Keys are only compared on the bits in varying,
+// squeezed together. When those fit next to the item's position in 64 bits, the range is
+// sorted as packed 8 byte keys, which moves half the memory a RenderItem would. Otherwise
+// it is split on the top byte of varying and every bucket is sorted the same way, and
+// since a bucket's keys share more bits, they soon fit
+void
+RenderQueue::_sort_range(size_t first, size_t count, uint64_t varying, bool inItems) {
+    RenderItem* src = (inItems ? m_items.data() : m_scratch.data()) + first;
+    RenderItem* dst = (inItems ? m_scratch.data() : m_items.data()) + first;
+    if (count <= RADIX_INSERTION_CUTOFF || varying == 0) {
+        if (varying != 0)
+            _insertion_sort(src, count);
+        if (!inItems)
+            memcpy(dst, src, count * sizeof(RenderItem));
+        return;
+    }
+
+    // Runs of varying bits, lowest first
+    uint32_t runShift[RADIX_MAX_RUNS];
+    uint32_t runWidth[RADIX_MAX_RUNS];
+    uint32_t runs = 0;
+    uint32_t bits = 0;
+    for (uint64_t rest = varying; rest != 0; runs++) {
+        uint32_t low = _lowest_bit(rest);
+        uint32_t high = _bit_width(rest);
+        if (runs < RADIX_MAX_RUNS - 1) {
+            high = low;
+            while (high < 64 && ((rest >> high) & 1))
+                high++;
+        }
+        runShift[runs] = low;
+        runWidth[runs] = high - low;
+        bits += high - low;
+        rest = (high == 64) ? 0 : (rest >> high) << high;
+    }
+
+    uint32_t indexBits = _bit_width(count - 1);
+    if (bits + indexBits <= 64) {
+        // Position in the low bits, so keys that compare equal keep their order
+        uint64_t* keys = m_keys.data() + first;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t key = src[i].key;
+            uint64_t packed = 0;
+            for (uint32_t r = runs; r-- > 0;) {
+                uint64_t mask = (runWidth[r] == 64) ? ~0ULL : (1ULL << runWidth[r]) - 1;
+                packed = (packed << runWidth[r]) | ((key >> runShift[r]) & mask);
+            }
+            keys[i] = (indexBits == 0) ? packed : (packed << indexBits) | i;
+        }
+
+        uint64_t* sorted = _sort_packed(keys, m_keysScratch.data() + first, count, indexBits, bits);
+        uint64_t indexMask = (1ULL << indexBits) - 1;
+        if (inItems) {
+            // Gather into the other buffer and copy back, src can not be written to while
+            // it is being read from
+            for (size_t i = 0; i < count; i++)
+                dst[i] = src[sorted[i] & indexMask];
+            memcpy(src, dst, count * sizeof(RenderItem));
+        } else {
+            for (size_t i = 0; i < count; i++)
+                dst[i] = src[sorted[i] & indexMask];
+        }
+        return;
+    }
+
+    uint32_t shift = (_bit_width(varying) > RADIX_BITS) ? _bit_width(varying) - RADIX_BITS : 0;
+    uint32_t offsets[RADIX_BUCKETS] = {};
+    for (size_t i = 0; i < count; i++) {
+        offsets[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+    }
+    uint32_t starts[RADIX_BUCKETS + 1];
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < RADIX_BUCKETS; b++) {
+        starts[b] = offset;
+        offset += offsets[b];
+        offsets[b] = starts[b];
+    }
+    starts[RADIX_BUCKETS] = offset;
+
+    // The bits each bucket's keys do not all share are gathered while scattering
+    uint64_t any[RADIX_BUCKETS] = {};
+    uint64_t all[RADIX_BUCKETS];
+    memset(all, 0xFF, sizeof(all));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = src[i].key;
+        uint32_t b = (key >> shift) & (RADIX_BUCKETS - 1);
+        dst[offsets[b]++] = src[i];
+        any[b] |= key;
+        all[b] &= key;
+    }
+
+    for (uint32_t b = 0; b < RADIX_BUCKETS; b++) {
+        size_t size = starts[b + 1] - starts[b];
+        if (size > 0)
+            _sort_range(first + starts[b], size, any[b] & ~all[b], !inItems);
+    }
+}
+
+void
+RenderQueue::Reserve(size_t count) {
+    m_items.reserve(count);
+    m_scratch.reserve(count);
+    m_keys.reserve(count);
+    m_keysScratch.reserve(count);
+}
+
+// Radix sort on the bits that tell the keys apart, see _sort_range
+void
+RenderQueue::Sort() {
+    size_t count = m_items.size();
+    if (count < 2)
+        return;
+
+    uint64_t any = 0;
+    uint64_t all = ~0ULL;
+    for (size_t i = 0; i < count; i++) {
+        any |= m_items[i].key;
+        all &= m_items[i].key;
+    }
+
+    m_scratch.resize(count);
+    m_keys.resize(count);
+    m_keysScratch.resize(count);
+    _sort_range(0, count, any & ~all, true);
+}
+
+uint64_t
+RenderQueue::MakeKey(RenderLayer layer, uint64_t pipeline, uint64_t material, uint64_t mesh, float depth) {
+    uint64_t key = static_cast<uint64_t>(layer) & ((1ULL << RENDER_KEY_LAYER_BITS) - 1);
+    uint64_t state = (_fold(pipeline, RENDER_KEY_PIPELINE_BITS) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS))
+        | (_fold(material, RENDER_KEY_MATERIAL_BITS) << RENDER_KEY_MESH_BITS)
+        | _fold(mesh, RENDER_KEY_MESH_BITS);
+    uint64_t quantized = QuantizeDepth(depth);
+    const uint32_t stateBits = RENDER_KEY_PIPELINE_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS;
+
+    if (layer == RENDER_LAYER_OPAQUE) {
+        key = (key << stateBits) | state;
+        key = (key << RENDER_KEY_DEPTH_BITS) | quantized;
+    } else {
+        uint64_t inverted = ((1ULL << RENDER_KEY_DEPTH_BITS) - 1) - quantized;
+        key = (key << RENDER_KEY_DEPTH_BITS) | inverted;
+        key = (key << stateBits) | state;
+    }
+    return key;
+}
+
+uint32_t
+RenderQueue::QuantizeDepth(float depth) {
+    // Also catches NaN, which fails every comparison
+    if (!(depth > 0.0f))
+        return 0;
+    if (depth >= 1.0f)
+        return (1u << RENDER_KEY_DEPTH_BITS) - 1;
+    return static_cast<uint32_t>(depth * static_cast<float>((1u << RENDER_KEY_DEPTH_BITS) - 1));
+}
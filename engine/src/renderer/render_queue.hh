@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+ * render_queue.hh
+ *
+ * Draws for a frame, ordered by a 64-bit sort key.
+ * The key packs everything the order depends on, so sorting is a radix sort over plain
+ * integers (linear in the number of draws) and the backend only has to walk the result.
+ *
+ * Opaque layers sort by state first so that draws sharing a pipeline, material and mesh
+ * end up next to each other, then front to back so that early depth testing can reject
+ * hidden fragments:
+ *   | layer 4 | pipeline 12 | material 12 | mesh 12 | depth 24 |
+ * Transparent layers have to blend in order, so depth comes first and runs back to front:
+ *   | layer 4 | inverted depth 24 | pipeline 12 | material 12 | mesh 12 |
+*/
+
+#include "stdafx.hh"
+#include <cstdint>
+
+// Layers are drawn in this order
+enum RenderLayer {
+    RENDER_LAYER_OPAQUE,
+    RENDER_LAYER_TRANSPARENT,
+    RENDER_LAYER_OVERLAY, // drawn last, sorted like transparent
+};
+
+#define RENDER_KEY_LAYER_BITS    4
+#define RENDER_KEY_PIPELINE_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_MESH_BITS     12
+#define RENDER_KEY_DEPTH_BITS    24
+
+// A draw and the key it is ordered by
+// index points into whatever list the caller keeps the draw's data in
+struct RenderItem {
+    uint64_t key;
+    uint32_t index;
+};
+
+class QAPI RenderQueue {
+    public:
+        RenderQueue() {}
+
+        // Make room for count draws, so that pushing does not allocate during the frame
+        void Reserve(size_t count);
+        void Clear() { m_items.clear(); }
+        void Push(uint64_t key, uint32_t index) { m_items.push_back({ key, index }); }
+
+        // Sort the draws by key. Draws with equal keys keep the order they were pushed in
+        void Sort();
+
+        const std::vector<RenderItem>& GetItems() const { return m_items; }
+        size_t Size() const { return m_items.size(); }
+
+        // Build a key. pipeline, material and mesh are ids that only need to be equal
+        // for draws that share that state (they are folded down to the bits available).
+        // depth is the normalized depth of the draw in [0, 1], 0 being nearest
+        static uint64_t MakeKey(RenderLayer layer, uint64_t pipeline, uint64_t material, uint64_t mesh, float depth);
+        static uint32_t QuantizeDepth(float depth);
+
+    private:
+        void _sort_range(size_t first, size_t count, uint64_t varying, bool inItems);
+
+        std::vector<RenderItem> m_items;
+        std::vector<RenderItem> m_scratch;
+        // Packed keys while sorting, see _sort_range
+        std::vector<uint64_t> m_keys;
+        std::vector<uint64_t> m_keysScratch;
+};
@@ -0,0 +1,109 @@
+#include "render_thread.hh"
+
+#include <chrono>
+
+void
+RenderThread::Start(FrameFunc frame) {
+    if (IsRunning())
+        return;
+
+    m_frame = frame;
+    m_stop.store(false);
+    m_thread = std::thread(&RenderThread::_run, this);
+    std::cout << "Render thread started" << std::endl;
+}
+
+void
+RenderThread::Stop() {
+    if (!IsRunning())
+        return;
+
+    Flush();
+    m_stop.store(true);
+    _wake(m_packetReady);
+    m_thread.join();
+    std::cout << "Render thread stopped" << std::endl;
+}
+
+void
+RenderThread::Submit(const RenderPacket& packet) {
+    uint64_t sequence = m_written + 1;
+
+    // The slot still holds the packet from RENDER_THREAD_PACKETS frames ago, wait until
+    // the render thread is done with it
+    if (m_consumed.load(std::memory_order_acquire) + RENDER_THREAD_PACKETS < sequence) {
+        auto start = std::chrono::steady_clock::now();
+        _sleep(m_packetDone, [&] { return m_consumed.load() + RENDER_THREAD_PACKETS >= sequence; });
+        m_mainWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    m_packets[sequence % RENDER_THREAD_PACKETS] = packet;
+    m_written = sequence;
+    m_published.store(sequence);
+    _wake(m_packetReady);
+}
+
+void
+RenderThread::Flush() {
+    if (m_consumed.load(std::memory_order_acquire) >= m_written)
+        return;
+
+    _sleep(m_packetDone, [&] { return m_consumed.load() >= m_written; });
+}
+
+RenderThreadStats
+RenderThread::GetStats() const {
+    RenderThreadStats stats = {};
+    stats.submitted = m_written;
+    stats.rendered = m_consumed.load(std::memory_order_acquire);
+    stats.mainWaitSeconds = m_mainWaitSeconds;
+    return stats;
+}
+
+//
+// PRIVATE
+//
+
+// Packets are rendered in the order they were submitted
+void
+RenderThread::_run() {
+    uint64_t next = m_consumed.load() + 1;
+    while (true) {
+        if (m_published.load(std::memory_order_acquire) < next) {
+            _sleep(m_packetReady, [&] { return m_published.load() >= next || m_stop.load(); });
+            if (m_published.load(std::memory_order_acquire) < next)
+                break; // stopping and nothing left to render
+        }
+
+        m_frame(m_packets[next % RENDER_THREAD_PACKETS]);
+
+        m_consumed.store(next);
+        _wake(m_packetDone);
+        next++;
+    }
+}
+
+// Sleepers register before they check the condition, and wakers publish before they
+// look for sleepers (both sequentially consistent), so either the sleeper sees the new
+// value or the waker sees the sleeper
+template <typename Pred>
+void
+RenderThread::_sleep(std::condition_variable& cv, Pred ready) {
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleepers.fetch_add(1);
+    cv.wait(lock, ready);
+    m_sleepers.fetch_sub(1);
+}
+
+// The lock is taken before notifying so that a sleeper that just checked the condition
+// cannot miss the wakeup before it starts waiting
+void
+RenderThread::_wake(std::condition_variable& cv) {
+    if (m_sleepers.load() == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    cv.notify_all();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * render_thread.hh
+ *
+ * Runs the renderer on its own thread so that the main thread can simulate the next
+ * frame while the current one is being recorded and submitted.
+ *
+ * Frames are handed over through two packet slots. The main thread writes a packet into
+ * one slot and publishes it with an atomic store, while the render thread works on the
+ * packet in the other slot. Neither side takes a lock to pass a packet along. A side
+ * only sleeps when it has nothing to do: the render thread when no packet is waiting, and
+ * the main thread when it would overwrite the packet being rendered. That caps the
+ * main thread at one frame ahead of the render thread.
+*/
+
+#include "stdafx.hh"
+#include "render_types.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Packets in flight between the main thread and the render thread
+#define RENDER_THREAD_PACKETS 2
+
+struct RenderThreadStats {
+    uint64_t submitted = 0;
+    uint64_t rendered = 0;
+    double mainWaitSeconds = 0.0; // time the main thread spent waiting for a free slot
+};
+
+class RenderThread {
+    public:
+        // Called on the render thread for every packet
+        using FrameFunc = std::function<void(const RenderPacket& packet)>;
+
+        RenderThread() {}
+        ~RenderThread() { Stop(); }
+        RenderThread(const RenderThread&) = delete;
+        RenderThread& operator= (const RenderThread&) = delete;
+
+        void Start(FrameFunc frame);
+        // Render whatever has been submitted, then stop the thread
+        void Stop();
+        bool IsRunning() const { return m_thread.joinable(); }
+
+        // Hand a frame to the render thread
+        // Only blocks if the render thread is still on the frame before the last one
+        void Submit(const RenderPacket& packet);
+        // Wait until every submitted frame has been rendered
+        // Anything else that touches the renderer must call this first, the render thread
+        // only uses the renderer while it has a packet
+        void Flush();
+
+        RenderThreadStats GetStats() const;
+
+    private:
+        void _run();
+        template <typename Pred>
+        void _sleep(std::condition_variable& cv, Pred ready);
+        void _wake(std::condition_variable& cv);
+
+        FrameFunc m_frame;
+        std::thread m_thread;
+
+        RenderPacket m_packets[RENDER_THREAD_PACKETS];
+        // Sequence numbers. Packet n lives in slot n % RENDER_THREAD_PACKETS
+        uint64_t m_written = 0;               // main thread only
+        std::atomic<uint64_t> m_published{0}; // last packet the render thread may take
+        std::atomic<uint64_t> m_consumed{0};  // last packet the render thread finished
+        std::atomic<bool> m_stop{false};
+
+        // Only used to sleep when there is nothing to do
+        // Waking is skipped entirely while nobody is asleep
+        std::atomic<uint32_t> m_sleepers{0};
+        std::mutex m_sleepMutex;
+        std::condition_variable m_packetReady;
+        std::condition_variable m_packetDone;
+
+        double m_mainWaitSeconds = 0.0;
+};
@@ -2,19 +2,53 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include "stdafx.hh"
+#include "core/slot_map.hh"
+#include <chrono>
+#include <functional>
 #include <glm/glm.hpp>
+// A model added to the renderer
+typedef SlotHandle ModelHandle;
+
 // Uniform Buffer Object
 struct UBO {
     alignas (16) glm::mat4 projectionView{1.f};
     // glm::vec3 lightDirection = glm::normalize(glm::vec3(1.f, -3.f, -1.f));
 };
 
+// World matrix a model is drawn with
+// previous is where it was one simulation step before world, the renderer draws it in between
+struct DrawTransform {
+    ModelHandle model;
+    glm::mat4 previous;
+    glm::mat4 world;
+};
+
 // Structure for a render packet
 // This is sent from the application to the renderer
 // The renderer uses information in this as data to render
 struct RenderPacket {
     UBO ubo;
     float time;
+    // When the input that went into ubo was sampled
+    std::chrono::steady_clock::time_point sampleTime;
+    // Models that are not listed keep the matrix they were last drawn with
+    std::vector<DrawTransform> transforms;
+    // How far from previous to world the transforms are drawn, 1 draws world as is
+    float alpha = 1.0f;
+};
+
+// Samples the camera again right before a frame is submitted (late latching)
+// ubo holds the packet's values. Overwrite it and set sampleTime to when the new input was
+// sampled, or return false to keep the packet's. Called on the thread that renders, so it
+// must only read state that is safe to read from there
+typedef std::function<bool(const RenderPacket& packet, UBO& ubo, std::chrono::steady_clock::time_point& sampleTime)> LateLatchFunc;
+
+// Time between sampling the input a frame shows and submitting that frame
+struct LatencyStats {
+    double inputToSubmit = 0.0;        // seconds, last frame
+    double averageInputToSubmit = 0.0; // seconds, smoothed over recent frames
+    double packetToSubmit = 0.0;       // seconds, for the input in the packet (ie without the late latch)
+    uint64_t latchedFrames = 0;
 };
 
 // Structure for a vertex in the model
@@ -36,5 +70,8 @@ struct Builder {
     std::vector <Vertex> vertices{};
     std::vector <uint32_t> indices{};
 
+    // Hash of the geometry, used to share GPU copies of identical models
+    uint64_t Hash() const;
+
     // void LoadModels(const std::string& filepath);
 };
\ No newline at end of file
@@ -1,40 +1,96 @@
 #include "renderer_frontend.hh"
+#include "render_thread.hh"
 
 static VKBackend vkrenderer = {};
+static RenderThread render_thread = {};
+
+// Record and submit a frame
+// Runs on the render thread when there is one
+static void
+draw_frame(const RenderPacket& packet) {
+  if (vkrenderer.IsInitialized()) {
+    if (vkrenderer.BeginFrame())
+      vkrenderer.EndFrame(packet);
+  }
+}
 
 bool 
 Renderer::Initialize(std::string name, std::string asset_path, uint32_t width, uint32_t height, RendererSettings settings) {
   vkrenderer.Initialize(name, asset_path, width, height, settings);
   // vkrenderer.OnInit();
 
+  if (settings.render_thread)
+    render_thread.Start(draw_frame);
+
   return true;
 }
 
 void 
 Renderer::Shutdown() {
+  render_thread.Stop();
   vkrenderer.OnDestroy();
 }
 
+// Everything below that changes the renderer waits for the render thread to go idle first
+// These only happen on resizes, settings changes and loads, never every frame
+
 void 
 Renderer::OnResize(uint16_t width, uint16_t height) {
+  render_thread.Flush();
   vkrenderer.WindowResize(width, height);
 }
 
-bool
-Renderer::CreateModel(Pegasus::GameObject& obj) {
+void
+Renderer::SetPresentMode(PresentMode mode) {
+  render_thread.Flush();
+  vkrenderer.SetPresentMode(mode);
+}
+
+void
+Renderer::SetMaxQueuedFrames(uint32_t count) {
+  render_thread.Flush();
+  vkrenderer.SetMaxQueuedFrames(count);
+}
+
+ModelHandle
+Renderer::CreateModel(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
   Builder model_builder = {
-    obj.vertices,
-    obj.indices
+    vertices,
+    indices
   };
-  vkrenderer.AddModel(model_builder);
-  return true;
+  render_thread.Flush();
+  return vkrenderer.AddModel(model_builder);
+}
+
+void
+Renderer::DestroyModel(ModelHandle model) {
+  render_thread.Flush();
+  vkrenderer.RemoveModel(model);
 }
 
 bool 
 Renderer::DrawFrame(RenderPacket packet) {
-  if (vkrenderer.IsInitialized()) {
-    vkrenderer.BeginFrame();
-    vkrenderer.EndFrame(packet);
+  if (render_thread.IsRunning()) {
+    render_thread.Submit(packet);
+  } else {
+    draw_frame(packet);
   }
   return true;
-}
\ No newline at end of file
+}
+
+RenderThreadStats
+Renderer::GetRenderThreadStats() {
+  return render_thread.GetStats();
+}
+
+void
+Renderer::SetLateLatch(LateLatchFunc latch) {
+  render_thread.Flush();
+  vkrenderer.SetLateLatch(latch);
+}
+
+LatencyStats
+Renderer::GetLatencyStats() {
+  render_thread.Flush();
+  return vkrenderer.GetLatencyStats();
+}
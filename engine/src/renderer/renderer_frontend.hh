@@ -13,6 +13,7 @@
 
 #include "stdafx.hh"
 #include "render_types.hh"
+#include "render_thread.hh"
 #include "vulkan/vulkan_backend.hh"
 #include "game_types.hh"
 
@@ -22,8 +23,17 @@ class Renderer {
 public:
   static bool Initialize(std::string name, std::string asset_path, uint32_t width, uint32_t height, RendererSettings settings);
   static void Shutdown();
-  static bool CreateModel(Pegasus::GameObject& obj);
+  static ModelHandle CreateModel(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+  static void DestroyModel(ModelHandle model);
 
   static void OnResize(uint16_t width, uint16_t height);
+  static void SetPresentMode(PresentMode mode);
+  static void SetMaxQueuedFrames(uint32_t count);
+  // Hands the frame to the render thread when there is one, otherwise renders it right away
   static bool DrawFrame(RenderPacket packet);
+  static RenderThreadStats GetRenderThreadStats();
+
+  // See LateLatchFunc. The latch runs on the render thread when there is one
+  static void SetLateLatch(LateLatchFunc latch);
+  static LatencyStats GetLatencyStats();
 };
\ No newline at end of file
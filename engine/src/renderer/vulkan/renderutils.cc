@@ -1,42 +1,31 @@
 #include "vulkan_backend.hh"
 #include "vkcommon.hh"
-#include <fstream>
+#include "core/filesystem.hh"
 #include <vulkan/vulkan_core.h>
 
+// Load a SPIR-V shader through the virtual file system
+// The path is relative to the asset root (ie "shaders/vert/triangle.vert.spv")
 VkShaderModule
 VKBackend::LoadShader(VKCommonParameters& vkparams, std::string filename) {
-    size_t shaderSize;
-    char* shaderCode = NULL;
-
-    std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
-
-    if (is.is_open()) {
-        shaderSize = is.tellg();
-        is.seekg(0, std::ios::beg);
-        // Copy file content into a buffer
-        shaderCode = new char[shaderSize];
-        is.read(shaderCode, shaderSize);
-        is.close();
-        assert(shaderSize > 0);
+    FileData shaderCode;
+    if (!FileSystem::Read(filename, shaderCode)) {
+        std::cerr << "Error: could not open shader file " << filename << std::endl;
+        return VK_NULL_HANDLE;
     }
+    assert(shaderCode.Size() > 0 && shaderCode.Size() % sizeof(uint32_t) == 0);
 
-    if (shaderCode) {
-        // Create a new shader module that will be used for pipeline creation
-        VkShaderModuleCreateInfo moduleCreateInfo = {};
-        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleCreateInfo.codeSize = shaderSize;
-        moduleCreateInfo.pCode = reinterpret_cast<uint32_t*>(shaderCode);
+    // Create a new shader module that will be used for pipeline creation
+    // Pack entries are aligned, so the code can be handed to the driver without a copy
+    VkShaderModuleCreateInfo moduleCreateInfo = {};
+    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleCreateInfo.codeSize = shaderCode.Size();
+    moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.Data());
 
-        VkShaderModule shaderModule;
-        VK_CHECK(
-            vkCreateShaderModule(vkparams.Device.Device, &moduleCreateInfo, vkparams.Allocator, &shaderModule));
+    VkShaderModule shaderModule;
+    VK_CHECK(
+        vkCreateShaderModule(vkparams.Device.Device, &moduleCreateInfo, vkparams.Allocator, &shaderModule));
 
-        delete[] shaderCode;
-        return shaderModule;
-    } else {
-        std::cerr << "Error: could not open shader file " << filename << std::endl;
-        return VK_NULL_HANDLE;
-    }
+    return shaderModule;
 }
 
 uint32_t 
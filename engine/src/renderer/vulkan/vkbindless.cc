@@ -0,0 +1,198 @@
+#include "vkbindless.hh"
+
+VKBindlessHeap::VKBindlessHeap(VKCommonParameters &vkparams)
+    : m_vkparams(vkparams) {
+}
+
+bool
+VKBindlessHeap::Initialize(uint32_t maxImages, uint32_t maxBuffers) {
+    if (!m_vkparams.Device.DescriptorIndexing)
+        return false;
+
+    m_images = {};
+    m_buffers = {};
+    m_images.capacity = std::min(maxImages, m_vkparams.Device.MaxBindlessSampledImages);
+    m_buffers.capacity = std::min(maxBuffers, m_vkparams.Device.MaxBindlessStorageBuffers);
+    if (m_images.capacity == 0 || m_buffers.capacity == 0)
+        return false;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    bindings[0].binding = BINDLESS_SAMPLED_IMAGE_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = m_images.capacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    bindings[1].binding = BINDLESS_STORAGE_BUFFER_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = m_buffers.capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    // Slots can be written while the set is bound in a pending command buffer, as long
+    // as that command buffer does not use them, and slots that were never written are fine
+    // as long as they are not read
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags = {};
+    for (size_t i = 0; i < bindingFlags.size(); i++) {
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+            | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    flagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(m_vkparams.Device.Device, &layoutInfo, m_vkparams.Allocator, &m_layout));
+
+    std::array<VkDescriptorPoolSize, 2> sizes = {};
+    sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sizes[0].descriptorCount = m_images.capacity;
+    sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    sizes[1].descriptorCount = m_buffers.capacity;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    VK_CHECK(vkCreateDescriptorPool(m_vkparams.Device.Device, &poolInfo, m_vkparams.Allocator, &m_pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_layout;
+    VK_CHECK(vkAllocateDescriptorSets(m_vkparams.Device.Device, &allocInfo, &m_set));
+
+    std::cout << "Bindless resources enabled: [" << m_images.capacity << " images, "
+        << m_buffers.capacity << " storage buffers]" << std::endl;
+    return true;
+}
+
+void
+VKBindlessHeap::Destroy() {
+    if (m_pool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(m_vkparams.Device.Device, m_pool, m_vkparams.Allocator);
+    if (m_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(m_vkparams.Device.Device, m_layout, m_vkparams.Allocator);
+
+    m_pool = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    m_set = VK_NULL_HANDLE;
+    m_images = {};
+    m_buffers = {};
+}
+
+uint32_t
+VKBindlessHeap::AddImage(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+    uint32_t index = _allocate(m_images);
+    if (index == BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = layout;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_set;
+    write.dstBinding = BINDLESS_SAMPLED_IMAGE_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_vkparams.Device.Device, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+uint32_t
+VKBindlessHeap::AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = _allocate(m_buffers);
+    if (index == BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_set;
+    write.dstBinding = BINDLESS_STORAGE_BUFFER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(m_vkparams.Device.Device, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+void
+VKBindlessHeap::RemoveImage(uint32_t index, uint64_t retireFrame) {
+    _retire(m_images, index, retireFrame);
+}
+
+void
+VKBindlessHeap::RemoveStorageBuffer(uint32_t index, uint64_t retireFrame) {
+    _retire(m_buffers, index, retireFrame);
+}
+
+void
+VKBindlessHeap::ReleaseRetired(uint64_t frameNumber) {
+    Slots* all[] = { &m_images, &m_buffers };
+    for (Slots* slots : all) {
+        while (!slots->retired.empty() && slots->retired.front().second <= frameNumber) {
+            slots->free.push_back(slots->retired.front().first);
+            slots->retired.pop_front();
+        }
+    }
+}
+
+void
+VKBindlessHeap::Bind(VKCommandEncoder& encoder, VkPipelineLayout layout, uint32_t setIndex) {
+    encoder.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, setIndex, 1, &m_set);
+}
+
+//
+// PRIVATE
+//
+
+uint32_t
+VKBindlessHeap::_allocate(Slots& slots) {
+    if (m_set == VK_NULL_HANDLE)
+        return BINDLESS_INVALID_INDEX;
+
+    uint32_t index = BINDLESS_INVALID_INDEX;
+    if (!slots.free.empty()) {
+        index = slots.free.back();
+        slots.free.pop_back();
+    } else if (slots.next < slots.capacity) {
+        index = slots.next++;
+    } else {
+        std::cerr << "Error: bindless descriptor array is full" << std::endl;
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    slots.used++;
+    return index;
+}
+
+// Retire frames are handed out in increasing order, so the queue stays sorted
+void
+VKBindlessHeap::_retire(Slots& slots, uint32_t index, uint64_t retireFrame) {
+    if (index == BINDLESS_INVALID_INDEX || index >= slots.next)
+        return;
+
+    slots.retired.push_back(std::make_pair(index, retireFrame));
+    slots.used--;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "vkcommon.hh"
+#include "vkcmdencoder.hh"
+
+#include <deque>
+#include <utility>
+
+// Math lib
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+// Bindings of the resource arrays in the bindless set
+#define BINDLESS_SAMPLED_IMAGE_BINDING  0
+#define BINDLESS_STORAGE_BUFFER_BINDING 1
+
+// Index that does not point at any resource
+#define BINDLESS_INVALID_INDEX UINT32_MAX
+
+// Pushed before each draw. Shaders use these to index the bindless arrays
+// Must match the push_constant block in the shaders
+struct VKDrawConstants {
+    uint32_t textureIndex = BINDLESS_INVALID_INDEX;
+    uint32_t materialIndex = BINDLESS_INVALID_INDEX; // into the storage buffer array
+    uint32_t instanceIndex = 0;
+    uint32_t pad = 0;
+    glm::mat4 model = glm::mat4(1.0f);
+};
+
+// One big descriptor set holding every sampled image and storage buffer
+//
+// Resources are written into a slot of an update-after-bind array when they are added, and
+// shaders address them by index (ie from VKDrawConstants), so a frame binds this set once
+// instead of binding descriptors per draw.
+// Slots are handed back with Remove, and are only reused once the frames that could still be
+// reading them have retired.
+// Needs descriptor indexing. When the device does not have it, Initialize fails and resources
+// are bound through classic sets (VKDescriptorCache) instead.
+class VKBindlessHeap {
+    public:
+        VKBindlessHeap(VKCommonParameters &vkparams);
+        ~VKBindlessHeap() {}
+        VKBindlessHeap(const VKBindlessHeap&) = delete;
+        VKBindlessHeap& operator= (const VKBindlessHeap&) = delete;
+
+        // Create the layout, pool and set. Counts are clamped to what the device allows
+        // Returns false if descriptor indexing is not available
+        bool Initialize(uint32_t maxImages, uint32_t maxBuffers);
+        void Destroy();
+
+        bool IsEnabled() const { return m_set != VK_NULL_HANDLE; }
+
+        // Returns the index of the slot the resource was written to,
+        // or BINDLESS_INVALID_INDEX if the array is full
+        uint32_t AddImage(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+        // The slot is reused once retireFrame has been reached
+        void RemoveImage(uint32_t index, uint64_t retireFrame);
+        void RemoveStorageBuffer(uint32_t index, uint64_t retireFrame);
+
+        // Make slots whose retire frame has been reached available again
+        void ReleaseRetired(uint64_t frameNumber);
+
+        void Bind(VKCommandEncoder& encoder, VkPipelineLayout layout, uint32_t setIndex);
+
+        VkDescriptorSetLayout GetLayout() const { return m_layout; }
+        uint32_t GetImageCount() const { return m_images.used; }
+        uint32_t GetStorageBufferCount() const { return m_buffers.used; }
+
+    private:
+        struct Slots {
+            uint32_t capacity = 0;
+            uint32_t next = 0;  // slots below this have been handed out before
+            uint32_t used = 0;
+            std::vector<uint32_t> free;
+            std::deque<std::pair<uint32_t, uint64_t> > retired; // slot, retire frame
+        };
+
+        uint32_t _allocate(Slots& slots);
+        void _retire(Slots& slots, uint32_t index, uint64_t retireFrame);
+
+        VKCommonParameters &m_vkparams;
+        VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+        VkDescriptorPool m_pool = VK_NULL_HANDLE;
+        VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+        Slots m_images;
+        Slots m_buffers;
+};
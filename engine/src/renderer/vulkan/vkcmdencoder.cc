@@ -0,0 +1,182 @@
+#include "vkcmdencoder.hh"
+
+#include <cstring>
+
+void
+VKCommandEncoder::Begin(VkCommandBuffer cmdBuffer) {
+    m_cmdBuffer = cmdBuffer;
+    Invalidate();
+}
+
+void
+VKCommandEncoder::Invalidate() {
+    m_graphicsPipeline = VK_NULL_HANDLE;
+    m_computePipeline = VK_NULL_HANDLE;
+    m_graphicsSets = DescriptorState();
+    m_computeSets = DescriptorState();
+    m_vertexBuffers.fill(VK_NULL_HANDLE);
+    m_vertexOffsets.fill(0);
+    m_indexBuffer = VK_NULL_HANDLE;
+    m_indexOffset = 0;
+    m_hasViewport = false;
+    m_hasScissor = false;
+    m_pushLayout = VK_NULL_HANDLE;
+    m_pushSize = 0;
+}
+
+void
+VKCommandEncoder::BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+    VkPipeline& bound = (bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) ? m_computePipeline : m_graphicsPipeline;
+    if (bound == pipeline) {
+        m_stats.filtered++;
+        return;
+    }
+
+    bound = pipeline;
+    vkCmdBindPipeline(m_cmdBuffer, bindPoint, pipeline);
+    m_stats.submitted++;
+}
+
+// Sets bound with a different layout are forgotten, since a layout that is not compatible
+// disturbs them. Sets with dynamic offsets are always bound, the offsets are not tracked
+void
+VKCommandEncoder::BindDescriptorSets(
+        VkPipelineBindPoint bindPoint,
+        VkPipelineLayout layout,
+        uint32_t firstSet,
+        uint32_t setCount,
+        const VkDescriptorSet* sets,
+        uint32_t dynamicOffsetCount,
+        const uint32_t* dynamicOffsets) {
+    DescriptorState& state = (bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) ? m_computeSets : m_graphicsSets;
+    bool tracked = (firstSet + setCount) <= ENCODER_MAX_DESCRIPTOR_SETS;
+
+    if (tracked && dynamicOffsetCount == 0 && state.layout == layout) {
+        bool same = true;
+        for (uint32_t i = 0; i < setCount && same; i++) {
+            same = state.sets[firstSet + i] == sets[i];
+        }
+        if (same) {
+            m_stats.filtered++;
+            return;
+        }
+    }
+
+    if (state.layout != layout) {
+        state.sets.fill(VK_NULL_HANDLE);
+        state.layout = layout;
+    }
+    for (uint32_t i = 0; i < setCount && tracked; i++) {
+        state.sets[firstSet + i] = (dynamicOffsetCount == 0) ? sets[i] : VK_NULL_HANDLE;
+    }
+    if (!tracked)
+        state = DescriptorState();
+
+    vkCmdBindDescriptorSets(m_cmdBuffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::BindVertexBuffers(uint32_t firstBinding, uint32_t count, const VkBuffer* buffers, const VkDeviceSize* offsets) {
+    bool tracked = (firstBinding + count) <= ENCODER_MAX_VERTEX_BUFFERS;
+    if (tracked) {
+        bool same = true;
+        for (uint32_t i = 0; i < count && same; i++) {
+            same = m_vertexBuffers[firstBinding + i] == buffers[i]
+                && m_vertexOffsets[firstBinding + i] == offsets[i];
+        }
+        if (same) {
+            m_stats.filtered++;
+            return;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            m_vertexBuffers[firstBinding + i] = buffers[i];
+            m_vertexOffsets[firstBinding + i] = offsets[i];
+        }
+    }
+
+    vkCmdBindVertexBuffers(m_cmdBuffer, firstBinding, count, buffers, offsets);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+    if (m_indexBuffer == buffer && m_indexOffset == offset && m_indexType == indexType) {
+        m_stats.filtered++;
+        return;
+    }
+
+    m_indexBuffer = buffer;
+    m_indexOffset = offset;
+    m_indexType = indexType;
+    vkCmdBindIndexBuffer(m_cmdBuffer, buffer, offset, indexType);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::SetViewport(const VkViewport& viewport) {
+    if (m_hasViewport
+            && m_viewport.x == viewport.x && m_viewport.y == viewport.y
+            && m_viewport.width == viewport.width && m_viewport.height == viewport.height
+            && m_viewport.minDepth == viewport.minDepth && m_viewport.maxDepth == viewport.maxDepth) {
+        m_stats.filtered++;
+        return;
+    }
+
+    m_hasViewport = true;
+    m_viewport = viewport;
+    vkCmdSetViewport(m_cmdBuffer, 0, 1, &viewport);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::SetScissor(const VkRect2D& scissor) {
+    if (m_hasScissor
+            && m_scissor.offset.x == scissor.offset.x && m_scissor.offset.y == scissor.offset.y
+            && m_scissor.extent.width == scissor.extent.width && m_scissor.extent.height == scissor.extent.height) {
+        m_stats.filtered++;
+        return;
+    }
+
+    m_hasScissor = true;
+    m_scissor = scissor;
+    vkCmdSetScissor(m_cmdBuffer, 0, 1, &scissor);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) {
+    if (size <= ENCODER_MAX_PUSH_CONSTANTS) {
+        if (m_pushLayout == layout && m_pushStages == stages && m_pushOffset == offset && m_pushSize == size
+                && memcmp(m_pushData.data(), data, size) == 0) {
+            m_stats.filtered++;
+            return;
+        }
+
+        m_pushLayout = layout;
+        m_pushStages = stages;
+        m_pushOffset = offset;
+        m_pushSize = size;
+        memcpy(m_pushData.data(), data, size);
+    } else {
+        m_pushLayout = VK_NULL_HANDLE;
+    }
+
+    vkCmdPushConstants(m_cmdBuffer, layout, stages, offset, size, data);
+    m_stats.submitted++;
+}
+
+void
+VKCommandEncoder::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+    vkCmdDraw(m_cmdBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+    m_stats.submitted++;
+    m_stats.draws++;
+}
+
+void
+VKCommandEncoder::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+    vkCmdDrawIndexed(m_cmdBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    m_stats.submitted++;
+    m_stats.draws++;
+}
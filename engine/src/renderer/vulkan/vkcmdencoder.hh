@@ -0,0 +1,92 @@
+#pragma once
+#include "vkcommon.hh"
+
+#include <array>
+
+// Bindings the encoder keeps track of
+#define ENCODER_MAX_DESCRIPTOR_SETS 8
+#define ENCODER_MAX_VERTEX_BUFFERS 8
+#define ENCODER_MAX_PUSH_CONSTANTS 128
+
+// Commands recorded through an encoder during a frame
+struct VKEncoderStats {
+    uint32_t submitted = 0; // commands that reached the command buffer
+    uint32_t filtered = 0;  // commands dropped because they would not have changed anything
+    uint32_t draws = 0;
+};
+
+// Records state changes and draws into a command buffer, and drops the ones
+// that would set state to what is already bound
+//
+// Everything that binds state for drawing goes through this instead of calling vkCmd*
+// directly, otherwise the encoder cannot know what is bound. Binding state is kept for
+// the whole command buffer (render passes do not reset it in Vulkan), so Begin only has
+// to be called once per command buffer
+class VKCommandEncoder {
+    public:
+        VKCommandEncoder() {}
+        ~VKCommandEncoder() {}
+        VKCommandEncoder(const VKCommandEncoder&) = delete;
+        VKCommandEncoder& operator= (const VKCommandEncoder&) = delete;
+
+        // Start recording into cmdBuffer with nothing bound
+        void Begin(VkCommandBuffer cmdBuffer);
+        // Forget what is bound (ie after commands were recorded without the encoder)
+        void Invalidate();
+
+        void BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+        void BindDescriptorSets(
+                VkPipelineBindPoint bindPoint,
+                VkPipelineLayout layout,
+                uint32_t firstSet,
+                uint32_t setCount,
+                const VkDescriptorSet* sets,
+                uint32_t dynamicOffsetCount = 0,
+                const uint32_t* dynamicOffsets = nullptr);
+        void BindVertexBuffers(uint32_t firstBinding, uint32_t count, const VkBuffer* buffers, const VkDeviceSize* offsets);
+        void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+        void SetViewport(const VkViewport& viewport);
+        void SetScissor(const VkRect2D& scissor);
+        void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+        void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+        void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+        VkCommandBuffer GetCommandBuffer() const { return m_cmdBuffer; }
+        const VKEncoderStats& GetStats() const { return m_stats; }
+        void ResetStats() { m_stats = VKEncoderStats(); }
+
+    private:
+        // Descriptor sets bound for one bind point
+        struct DescriptorState {
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+            std::array<VkDescriptorSet, ENCODER_MAX_DESCRIPTOR_SETS> sets = {};
+        };
+
+        VkCommandBuffer m_cmdBuffer = VK_NULL_HANDLE;
+
+        VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+        VkPipeline m_computePipeline = VK_NULL_HANDLE;
+        DescriptorState m_graphicsSets;
+        DescriptorState m_computeSets;
+
+        std::array<VkBuffer, ENCODER_MAX_VERTEX_BUFFERS> m_vertexBuffers = {};
+        std::array<VkDeviceSize, ENCODER_MAX_VERTEX_BUFFERS> m_vertexOffsets = {};
+        VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize m_indexOffset = 0;
+        VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+
+        bool m_hasViewport = false;
+        VkViewport m_viewport = {};
+        bool m_hasScissor = false;
+        VkRect2D m_scissor = {};
+
+        // Last push, a push with the same range and bytes is dropped
+        VkPipelineLayout m_pushLayout = VK_NULL_HANDLE;
+        VkShaderStageFlags m_pushStages = 0;
+        uint32_t m_pushOffset = 0;
+        uint32_t m_pushSize = 0;
+        std::array<uint8_t, ENCODER_MAX_PUSH_CONSTANTS> m_pushData = {};
+
+        VKEncoderStats m_stats;
+};
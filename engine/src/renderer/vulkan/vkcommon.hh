@@ -62,9 +62,17 @@ struct VKDeviceParameters {
     VkPhysicalDeviceMemoryProperties DeviceMemoryProperties;
     VkPhysicalDeviceFeatures DeviceFeatures;
 
+    // Descriptor indexing (VK_EXT_descriptor_indexing, core in 1.2) was found and enabled
+    bool DescriptorIndexing;
+    uint32_t MaxBindlessSampledImages;
+    uint32_t MaxBindlessStorageBuffers;
+
     VKDeviceParameters() :
         PhysicalDevice(VK_NULL_HANDLE),
-        Device(VK_NULL_HANDLE) {
+        Device(VK_NULL_HANDLE),
+        DescriptorIndexing(false),
+        MaxBindlessSampledImages(0),
+        MaxBindlessStorageBuffers(0) {
     }
 };
 
@@ -81,15 +89,13 @@ struct VKCommonParameters {
    
     // Formerly graphics params
     VkRenderPass                        RenderPass;
-    std::vector<VkFramebuffer>          Framebuffers;
     VkCommandPool                       GraphicsCommandPool;
     std::vector<VkCommandBuffer>        GraphicsCommandBuffers;
-    VkPipeline                          GraphicsPipeline;
     VkPipelineLayout                    PipelineLayout;
-    VkSemaphore                         ImageAvailableSemaphore;
-    VkSemaphore                         RenderingFinishedSemaphore;
+    std::vector<VkSemaphore>            ImageAvailableSemaphores;    // one per frame in flight
+    std::vector<VkSemaphore>            RenderingFinishedSemaphores; // one per swapchain image, created with the swapchain
+    std::vector<VkFence>                FrameFences;                 // signaled when the GPU is done with a frame in flight
     VkDescriptorSetLayout               DescriptorSetLayout;
-    VkDescriptorPool                    DescriptorPool;
     std::vector<VkDescriptorSet>        DescriptorSets;
 
     // Constructor
@@ -101,12 +107,11 @@ struct VKCommonParameters {
         SwapChain() ,
         Device() ,
         RenderPass(VK_NULL_HANDLE),
-        Framebuffers(),
         GraphicsCommandPool(VK_NULL_HANDLE),
         GraphicsCommandBuffers(),
-        GraphicsPipeline(VK_NULL_HANDLE),
-        ImageAvailableSemaphore(VK_NULL_HANDLE),
-        RenderingFinishedSemaphore(VK_NULL_HANDLE) {
+        ImageAvailableSemaphores(),
+        RenderingFinishedSemaphores(),
+        FrameFences() {
     }
 };
 
@@ -0,0 +1,184 @@
+#include "vkdescriptors.hh"
+#include "core/hash.hh"
+
+// Later pools are made bigger so that a scene that needs many sets ends up with few pools
+#define DESCRIPTOR_POOL_GROWTH 2
+#define DESCRIPTOR_POOL_MAX_SETS 4096u
+
+VKDescriptorAllocator::VKDescriptorAllocator(VKCommonParameters &vkparams, uint32_t setsPerPool, const std::vector<VKPoolSizeRatio>& ratios)
+    : m_vkparams(vkparams),
+    m_ratios(ratios),
+    m_setsPerPool(setsPerPool > 0 ? setsPerPool : 1) {
+}
+
+std::vector<VKPoolSizeRatio>
+VKDescriptorAllocator::DefaultRatios() {
+    return {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+    };
+}
+
+VkDescriptorSet
+VKDescriptorAllocator::Allocate(VkDescriptorSetLayout layout) {
+    if (m_current == VK_NULL_HANDLE)
+        m_current = _next_pool();
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_current;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(m_vkparams.Device.Device, &allocInfo, &set);
+
+    // The pool is full, move on to the next one and try again
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        m_current = _next_pool();
+        allocInfo.descriptorPool = m_current;
+        result = vkAllocateDescriptorSets(m_vkparams.Device.Device, &allocInfo, &set);
+    }
+    VK_CHECK(result);
+
+    m_stats.allocations++;
+    return set;
+}
+
+void
+VKDescriptorAllocator::Reset() {
+    for (size_t i = 0; i < m_usedPools.size(); i++) {
+        VK_CHECK(vkResetDescriptorPool(m_vkparams.Device.Device, m_usedPools[i], 0));
+        m_freePools.push_back(m_usedPools[i]);
+    }
+    m_usedPools.clear();
+    m_current = VK_NULL_HANDLE;
+}
+
+void
+VKDescriptorAllocator::Destroy() {
+    for (size_t i = 0; i < m_usedPools.size(); i++) {
+        vkDestroyDescriptorPool(m_vkparams.Device.Device, m_usedPools[i], m_vkparams.Allocator);
+    }
+    for (size_t i = 0; i < m_freePools.size(); i++) {
+        vkDestroyDescriptorPool(m_vkparams.Device.Device, m_freePools[i], m_vkparams.Allocator);
+    }
+    m_usedPools.clear();
+    m_freePools.clear();
+    m_current = VK_NULL_HANDLE;
+}
+
+//
+// PRIVATE
+//
+
+// Take a reset pool if there is one, otherwise create a new one
+VkDescriptorPool
+VKDescriptorAllocator::_next_pool() {
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (!m_freePools.empty()) {
+        pool = m_freePools.back();
+        m_freePools.pop_back();
+    } else {
+        pool = _create_pool();
+    }
+
+    m_usedPools.push_back(pool);
+    return pool;
+}
+
+VkDescriptorPool
+VKDescriptorAllocator::_create_pool() {
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (size_t i = 0; i < m_ratios.size(); i++) {
+        VkDescriptorPoolSize size = {};
+        size.type = m_ratios[i].type;
+        size.descriptorCount = std::max(1u, static_cast<uint32_t>(m_ratios[i].ratio * m_setsPerPool));
+        sizes.push_back(size);
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    poolInfo.maxSets = m_setsPerPool;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorPool(m_vkparams.Device.Device, &poolInfo, m_vkparams.Allocator, &pool));
+
+    m_stats.poolCount++;
+    m_setsPerPool = std::min(m_setsPerPool * DESCRIPTOR_POOL_GROWTH, DESCRIPTOR_POOL_MAX_SETS);
+    return pool;
+}
+
+VKDescriptorCache::VKDescriptorCache(VKCommonParameters &vkparams)
+    : m_vkparams(vkparams),
+    m_allocator(vkparams, 64, VKDescriptorAllocator::DefaultRatios()) {
+}
+
+VkDescriptorSet
+VKDescriptorCache::Get(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings) {
+    uint64_t key = HashValue(layout);
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VKDescriptorBinding& b = bindings[i];
+        key = HashValue(b.binding, key);
+        key = HashValue(b.type, key);
+        key = HashValue(b.buffer.buffer, key);
+        key = HashValue(b.buffer.offset, key);
+        key = HashValue(b.buffer.range, key);
+        key = HashValue(b.image.sampler, key);
+        key = HashValue(b.image.imageView, key);
+        key = HashValue(b.image.imageLayout, key);
+    }
+
+    auto it = m_sets.find(key);
+    if (it != m_sets.end()) {
+        m_hits++;
+        return it->second;
+    }
+
+    m_misses++;
+    VkDescriptorSet set = m_allocator.Allocate(layout);
+
+    std::vector<VkWriteDescriptorSet> writes(bindings.size());
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VKDescriptorBinding& b = bindings[i];
+        bool isImage = b.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            || b.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            || b.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            || b.type == VK_DESCRIPTOR_TYPE_SAMPLER;
+
+        writes[i] = {};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = b.binding;
+        writes[i].dstArrayElement = 0;
+        writes[i].descriptorType = b.type;
+        writes[i].descriptorCount = 1;
+        writes[i].pBufferInfo = isImage ? nullptr : &b.buffer;
+        writes[i].pImageInfo = isImage ? &b.image : nullptr;
+    }
+    vkUpdateDescriptorSets(m_vkparams.Device.Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    m_sets[key] = set;
+    return set;
+}
+
+void
+VKDescriptorCache::Destroy() {
+    m_allocator.Destroy();
+    m_sets.clear();
+}
+
+VKDescriptorStats
+VKDescriptorCache::GetStats() const {
+    VKDescriptorStats stats = m_allocator.GetStats();
+    stats.cacheHits = m_hits;
+    stats.cacheMisses = m_misses;
+    return stats;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "vkcommon.hh"
+
+#include <unordered_map>
+
+// How many descriptors of a type to reserve per set when sizing a pool
+struct VKPoolSizeRatio {
+    VkDescriptorType type;
+    float ratio;
+};
+
+struct VKDescriptorStats {
+    uint32_t poolCount = 0;   // pools created so far
+    uint64_t allocations = 0; // sets allocated
+    uint64_t cacheHits = 0;   // cached sets that were reused
+    uint64_t cacheMisses = 0; // cached sets that had to be allocated and written
+};
+
+// Allocates descriptor sets from a chain of pools
+//
+// When a pool runs out (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL) the set is
+// allocated from the next pool instead, creating one if needed, so allocation never fails
+// because of how the pools were sized. Sets are never freed one at a time; Reset returns every
+// pool at once, which is how per frame sets are recycled once the frame's fence is signaled.
+// Not thread safe
+class VKDescriptorAllocator {
+    public:
+        VKDescriptorAllocator(VKCommonParameters &vkparams, uint32_t setsPerPool, const std::vector<VKPoolSizeRatio>& ratios);
+        ~VKDescriptorAllocator() {}
+        VKDescriptorAllocator(const VKDescriptorAllocator&) = delete;
+        VKDescriptorAllocator& operator= (const VKDescriptorAllocator&) = delete;
+
+        VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+        // Free every set allocated so far. The pools are kept for reuse
+        void Reset();
+        void Destroy();
+
+        const VKDescriptorStats& GetStats() const { return m_stats; }
+
+        // Ratios that cover the descriptor types used by the engine
+        static std::vector<VKPoolSizeRatio> DefaultRatios();
+
+    private:
+        VkDescriptorPool _create_pool();
+        VkDescriptorPool _next_pool();
+
+        VKCommonParameters &m_vkparams;
+        std::vector<VKPoolSizeRatio> m_ratios;
+        uint32_t m_setsPerPool;
+
+        VkDescriptorPool m_current = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> m_usedPools;  // pools with sets allocated from them
+        std::vector<VkDescriptorPool> m_freePools;  // pools that have been reset
+        VKDescriptorStats m_stats;
+};
+
+// One resource written into a cached descriptor set
+struct VKDescriptorBinding {
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkDescriptorBufferInfo buffer = {}; // for buffer descriptors
+    VkDescriptorImageInfo image = {};   // for image and sampler descriptors
+};
+
+// Hands out descriptor sets whose contents never change (ie a material's textures or a
+// frame slot's uniform buffer)
+// Sets are keyed by their layout and the hash of their bindings, so asking for the same
+// resources twice returns the set that was already written instead of allocating another.
+// Sets live until Destroy, so the resources they point at must outlive them
+class VKDescriptorCache {
+    public:
+        VKDescriptorCache(VKCommonParameters &vkparams);
+        ~VKDescriptorCache() {}
+        VKDescriptorCache(const VKDescriptorCache&) = delete;
+        VKDescriptorCache& operator= (const VKDescriptorCache&) = delete;
+
+        VkDescriptorSet Get(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings);
+
+        void Destroy();
+
+        VKDescriptorStats GetStats() const;
+
+    private:
+        VKCommonParameters &m_vkparams;
+        VKDescriptorAllocator m_allocator;
+        std::unordered_map<uint64_t, VkDescriptorSet> m_sets;
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+};
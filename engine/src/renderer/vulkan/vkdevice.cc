@@ -74,10 +74,12 @@ CreateLogicalDevice(
     std::vector<VkDeviceQueueCreateInfo> &queueInfos,
     std::vector<const char*> &deviceExtensions,
     std::vector<std::string> &supportedDeviceExtensions,
-    VKCommonParameters &params
+    VKCommonParameters &params,
+    const void* featureChain
 ) {
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = featureChain;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
     createInfo.pQueueCreateInfos = queueInfos.data();
 
@@ -97,3 +99,68 @@ CreateLogicalDevice(
 
     return vkCreateDevice(params.Device.PhysicalDevice, &createInfo, params.Allocator, &params.Device.Device);
 }
+
+bool
+QueryDescriptorIndexing(
+    VKCommonParameters &params,
+    std::vector<const char*> &deviceExtensions,
+    std::vector<std::string> &supportedDeviceExtensions,
+    VkPhysicalDeviceDescriptorIndexingFeatures &features
+) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(params.Device.PhysicalDevice, &props);
+
+    bool core = props.apiVersion >= VK_API_VERSION_1_2;
+    bool extension = std::find(
+            supportedDeviceExtensions.begin(),
+            supportedDeviceExtensions.end(),
+            VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) != supportedDeviceExtensions.end();
+    if (!core && !extension)
+        return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeatures supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &supported;
+    vkGetPhysicalDeviceFeatures2(params.Device.PhysicalDevice, &features2);
+
+    if (!supported.runtimeDescriptorArray
+            || !supported.descriptorBindingPartiallyBound
+            || !supported.descriptorBindingUpdateUnusedWhilePending
+            || !supported.descriptorBindingSampledImageUpdateAfterBind
+            || !supported.descriptorBindingStorageBufferUpdateAfterBind
+            || !supported.shaderSampledImageArrayNonUniformIndexing
+            || !supported.shaderStorageBufferArrayNonUniformIndexing)
+        return false;
+
+    VkPhysicalDeviceDescriptorIndexingProperties limits = {};
+    limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &limits;
+    vkGetPhysicalDeviceProperties2(params.Device.PhysicalDevice, &props2);
+
+    // Only turn on what bindless uses
+    features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+    if (!core)
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    params.Device.DescriptorIndexing = true;
+    params.Device.MaxBindlessSampledImages = std::min(
+            limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            limits.maxDescriptorSetUpdateAfterBindSampledImages);
+    params.Device.MaxBindlessStorageBuffers = std::min(
+            limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+            limits.maxDescriptorSetUpdateAfterBindStorageBuffers);
+    return true;
+}
@@ -13,4 +13,14 @@ VkResult CreateLogicalDevice(
     std::vector<VkDeviceQueueCreateInfo> &queueInfos,
     std::vector<const char*> &deviceExtensions,
     std::vector<std::string> &supportedDeviceExtensions,
-    VKCommonParameters &params);
+    VKCommonParameters &params,
+    const void* featureChain = nullptr);
+
+// Check for the descriptor indexing features used by bindless resources
+// If they are all there, features is filled in to be chained into device creation, the
+// extension is added to deviceExtensions when it is not core, and the limits are saved in params
+bool QueryDescriptorIndexing(
+    VKCommonParameters &params,
+    std::vector<const char*> &deviceExtensions,
+    std::vector<std::string> &supportedDeviceExtensions,
+    VkPhysicalDeviceDescriptorIndexingFeatures &features);
@@ -1,5 +1,6 @@
 #include "vulkan_backend.hh"
 #include "vkcommon.hh"
+#include "core/hash.hh"
 #include <vulkan/vulkan_core.h>
 
 void
@@ -53,6 +54,16 @@ VKModel::Destroy() {
 void
 VKModel::_create_vertex_buffers(const std::vector<Vertex> &vertices) {
     m_vertexCount = static_cast<uint32_t>(vertices.size());
+
+    if (m_vertexCount > 0) {
+        glm::vec3 min = vertices[0].position;
+        glm::vec3 max = vertices[0].position;
+        for (size_t i = 1; i < vertices.size(); i++) {
+            min = glm::min(min, vertices[i].position);
+            max = glm::max(max, vertices[i].position);
+        }
+        m_center = (min + max) * 0.5f;
+    }
     
     // The application can copy data to host-visible device memory only using this pointer
     VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
@@ -85,33 +96,24 @@ VKModel::_create_vertex_buffers(const std::vector<Vertex> &vertices) {
 
 //
 void
-VKModel::Draw(VkCommandBuffer cmdBuffer, uint32_t frameIndex) {
-    vkCmdBindDescriptorSets(
-            cmdBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS, 
-            m_vkparams.PipelineLayout, 
-            0, 
-            1, 
-            &m_vkparams.DescriptorSets[frameIndex], 
-            0, 
-            nullptr);
+VKModel::Draw(VKCommandEncoder& encoder) {
     if (m_hasIndexBuffer) {
-        vkCmdDrawIndexed(cmdBuffer, m_indexCount, 1, 0, 0, 0);
+        encoder.DrawIndexed(m_indexCount, 1, 0, 0, 0);
     } else {
-        vkCmdDraw(cmdBuffer, m_vertexCount, 1, 0, 0);
+        encoder.Draw(m_vertexCount, 1, 0, 0);
     }
 }
 
 void
-VKModel::Bind(VkCommandBuffer cmdBuffer) {
+VKModel::Bind(VKCommandEncoder& encoder) {
     // VkBuffer buffers [] = {m_vertexBuffer};
     VkBuffer buffers [] = {m_vbuffer->GetBuffer()};
     VkDeviceSize offsets[1] = {0};
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, buffers, offsets);
+    encoder.BindVertexBuffers(0, 1, buffers, offsets);
 
     // If we are using an index buffer then bind it as well
     if (m_hasIndexBuffer) {
-        vkCmdBindIndexBuffer(cmdBuffer, m_ibuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        encoder.BindIndexBuffer(m_ibuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
     }
 }
 
@@ -141,3 +143,19 @@ Vertex::GetAttribDesc() {
 }
 
 
+
+// Builder IMPL
+// Components are hashed one at a time since aligned glm types may carry padding
+uint64_t
+Builder::Hash() const {
+    uint64_t hash = HashValue(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            hash = HashValue(vertices[i].position[c], hash);
+            hash = HashValue(vertices[i].color[c], hash);
+        }
+    }
+
+    hash = HashValue(indices.size(), hash);
+    return Hash64(indices.data(), indices.size() * sizeof(uint32_t), hash);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "vkcommon.hh"
 #include "vkbuffer.hh"
+#include "vkcmdencoder.hh"
 #include "renderer/render_types.hh"
 
 #include <memory>
@@ -45,10 +46,14 @@ class VKModel {
 
         
         // static std::unique_ptr<VKModel> CreateModelFromFile();
-        void Bind(VkCommandBuffer cmdBuffer);
-        void Draw(VkCommandBuffer cmdBuffer, uint32_t frameIndex);
+        void Bind(VKCommandEncoder& encoder);
+        // Descriptor sets must already be bound for the frame
+        void Draw(VKCommandEncoder& encoder);
         void Destroy();
 
+        // Center of the model's bounds, used to sort draws by depth
+        const glm::vec3& GetCenter() const { return m_center; }
+
 
     private:
         void _create_vertex_buffers(const std::vector <Vertex> &vertices);
@@ -60,5 +65,6 @@ class VKModel {
         uint32_t m_vertexCount = 0;
         uint32_t m_indexCount = 0;
         bool m_hasIndexBuffer = false;
+        glm::vec3 m_center{};
         VKCommonParameters &m_vkparams; // has lifetime of renderer -- outlives the model
 };
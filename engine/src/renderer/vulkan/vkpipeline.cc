@@ -1,15 +1,82 @@
 #include "vkpipeline.hh"
 #include "vulkan_backend.hh"
 #include "vkcommon.hh"
+#include "core/hash.hh"
 #include <vulkan/vulkan_core.h>
 
+VkSpecializationInfo
+VKSpecialization::GetInfo() const {
+    VkSpecializationInfo info = {};
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = data.size() * sizeof(uint32_t);
+    info.pData = data.data();
+    return info;
+}
+
+// Entries are kept sorted by id, so the order constants were set in does not change the hash
+uint64_t
+VKSpecialization::Hash(uint64_t seed) const {
+    uint64_t hash = HashValue(entries.size(), seed);
+    for (size_t i = 0; i < entries.size(); i++) {
+        hash = HashValue(entries[i].constantID, hash);
+        hash = HashValue(data[entries[i].offset / sizeof(uint32_t)], hash);
+    }
+    return hash;
+}
+
+// Fields are hashed one at a time so struct padding never leaks into the key
+uint64_t
+VKPipelineConfig::Hash() const {
+    std::vector<VkVertexInputBindingDescription> bindings = vertexBindings.empty() ? Vertex::GetBindingDesc() : vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> attributes = vertexAttributes.empty() ? Vertex::GetAttribDesc() : vertexAttributes;
+
+    uint64_t hash = HashValue(topology);
+    hash = HashValue(bindings.size(), hash);
+    for (size_t i = 0; i < bindings.size(); i++) {
+        hash = HashValue(bindings[i].binding, hash);
+        hash = HashValue(bindings[i].stride, hash);
+        hash = HashValue(bindings[i].inputRate, hash);
+    }
+    hash = HashValue(attributes.size(), hash);
+    for (size_t i = 0; i < attributes.size(); i++) {
+        hash = HashValue(attributes[i].location, hash);
+        hash = HashValue(attributes[i].binding, hash);
+        hash = HashValue(attributes[i].format, hash);
+        hash = HashValue(attributes[i].offset, hash);
+    }
+
+    hash = HashValue(polygonMode, hash);
+    hash = HashValue(cullMode, hash);
+    hash = HashValue(frontFace, hash);
+
+    hash = HashValue(blendEnable, hash);
+    hash = HashValue(srcColorBlendFactor, hash);
+    hash = HashValue(dstColorBlendFactor, hash);
+    hash = HashValue(colorBlendOp, hash);
+    hash = HashValue(srcAlphaBlendFactor, hash);
+    hash = HashValue(dstAlphaBlendFactor, hash);
+    hash = HashValue(alphaBlendOp, hash);
+    hash = HashValue(colorWriteMask, hash);
+
+    hash = HashValue(depthTestEnable, hash);
+    hash = HashValue(depthWriteEnable, hash);
+    hash = HashValue(depthCompareOp, hash);
+
+    hash = vertSpecialization.Hash(hash);
+    hash = fragSpecialization.Hash(hash);
+
+    hash = HashValue(pipelineLayout, hash);
+    hash = HashValue(renderPass, hash);
+    return HashValue(subpass, hash);
+}
+
 VKPipeline::VKPipeline(
     VKCommonParameters &vkparams,
     const VKPipelineConfig& config
 ) : m_vkparams(vkparams),
     m_config(config)
 {
-    (void)m_config;
 }
 
 VKPipeline::~VKPipeline() {
@@ -21,19 +88,19 @@ VKPipeline::~VKPipeline() {
 //
 
 void
-VKPipeline::Bind(VkCommandBuffer commandBuffer) {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkparams.GraphicsPipeline);
+VKPipeline::Bind(VKCommandEncoder& encoder) {
+    encoder.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 }
 
 void
 VKPipeline::Destroy() {
-    vkDestroyPipelineLayout(m_vkparams.Device.Device, m_vkparams.PipelineLayout, m_vkparams.Allocator);
-    vkDestroyPipeline(m_vkparams.Device.Device, m_vkparams.GraphicsPipeline, m_vkparams.Allocator);
+    vkDestroyPipeline(m_vkparams.Device.Device, m_pipeline, m_vkparams.Allocator);
+    m_pipeline = VK_NULL_HANDLE;
 }
 
 // Create the graphics pipeline
 void
-VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::string& fragPath) {
+VKPipeline::CreateGraphicsPipeline(VkShaderModule vertShader, VkShaderModule fragShader, VkPipelineCache pipelineCache) {
     //
     // INPUT ASSEMBLER
     //
@@ -51,8 +118,10 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     // layout (location = 0) in vec3 inPos;
     // layout (location = 0) in vec4 inColor;
     // Attribute location 0: position from vertex buffer at binding point 0
-    std::vector<VkVertexInputBindingDescription> bindingDescriptions = Vertex::GetBindingDesc();
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = Vertex::GetAttribDesc();
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions =
+        m_config.vertexBindings.empty() ? Vertex::GetBindingDesc() : m_config.vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions =
+        m_config.vertexAttributes.empty() ? Vertex::GetAttribDesc() : m_config.vertexAttributes;
 
 
     // Vertex input state used for pipeline creation
@@ -61,16 +130,16 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     // we can consider it as part of the input assembler state
     VkPipelineVertexInputStateCreateInfo vertexInputState = {};
     vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputState.pVertexBindingDescriptions = bindingDescriptions.data();
-    vertexInputState.vertexAttributeDescriptionCount = 2;
+    vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputState.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     // Input assembly state describes how primitives are assembled by the input assembler
     // This pipeline will assemble vertex data as triangle lists (though we only have one triangle)
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
     inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyState.topology = m_config.topology;
 
     //
     // Rasterization state
@@ -79,10 +148,10 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizationState.depthClampEnable = VK_FALSE;
     rasterizationState.rasterizerDiscardEnable = VK_FALSE;
-    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.polygonMode = m_config.polygonMode;
     rasterizationState.lineWidth = 1.0f;
-    rasterizationState.cullMode = VK_CULL_MODE_NONE;
-    rasterizationState.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizationState.cullMode = m_config.cullMode;
+    rasterizationState.frontFace = m_config.frontFace;
     rasterizationState.depthBiasEnable = VK_FALSE;
     rasterizationState.depthBiasConstantFactor = 0.0f;
     rasterizationState.depthBiasClamp = 0.0f;
@@ -97,19 +166,15 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     // attachments that can be written to
     VkPipelineColorBlendAttachmentState blendAttachmentState[1] = {};
     // blendAttachmentState[0].colorWriteMask = 0xf;
-    blendAttachmentState[0].colorWriteMask = 
-        VK_COLOR_COMPONENT_R_BIT 
-        | VK_COLOR_COMPONENT_G_BIT
-        | VK_COLOR_COMPONENT_B_BIT
-        | VK_COLOR_COMPONENT_A_BIT;
-
-    blendAttachmentState[0].blendEnable = VK_FALSE;
-    blendAttachmentState[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    blendAttachmentState[0].dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blendAttachmentState[0].colorBlendOp = VK_BLEND_OP_ADD;
-    blendAttachmentState[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    blendAttachmentState[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blendAttachmentState[0].alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachmentState[0].colorWriteMask = m_config.colorWriteMask;
+
+    blendAttachmentState[0].blendEnable = m_config.blendEnable;
+    blendAttachmentState[0].srcColorBlendFactor = m_config.srcColorBlendFactor;
+    blendAttachmentState[0].dstColorBlendFactor = m_config.dstColorBlendFactor;
+    blendAttachmentState[0].colorBlendOp = m_config.colorBlendOp;
+    blendAttachmentState[0].srcAlphaBlendFactor = m_config.srcAlphaBlendFactor;
+    blendAttachmentState[0].dstAlphaBlendFactor = m_config.dstAlphaBlendFactor;
+    blendAttachmentState[0].alphaBlendOp = m_config.alphaBlendOp;
     
     VkPipelineColorBlendStateCreateInfo colorBlendState = {};
     // colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -130,9 +195,9 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     // define a state indicating that the depth and stencil tests are disabled
     VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
     depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencilState.depthTestEnable = VK_TRUE;
-    depthStencilState.depthWriteEnable = VK_TRUE;
-    depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilState.depthTestEnable = m_config.depthTestEnable;
+    depthStencilState.depthWriteEnable = m_config.depthWriteEnable;
+    depthStencilState.depthCompareOp = m_config.depthCompareOp;
     depthStencilState.depthBoundsTestEnable = VK_FALSE;
     depthStencilState.minDepthBounds = 0.0f;
     depthStencilState.maxDepthBounds = 1.0f;
@@ -191,20 +256,28 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     // Set pipeline stage for this shader
     shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    // Load binary SPIR-V shader module
-    shaderStages[0].module = VKBackend::LoadShader(m_vkparams, vertPath);
+    // Binary SPIR-V shader module
+    shaderStages[0].module = vertShader;
     // Main entry point for the shader
     shaderStages[0].pName = "main";
+    // Values for the shader's specialization constants
+    VkSpecializationInfo vertSpecialization = m_config.vertSpecialization.GetInfo();
+    if (!m_config.vertSpecialization.IsEmpty())
+        shaderStages[0].pSpecializationInfo = &vertSpecialization;
     assert(shaderStages[0].module != VK_NULL_HANDLE);
 
     // Fragment shader
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     // Set pipeline stage for this shader
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    // Load binary SPIR-V shader module
-    shaderStages[1].module = VKBackend::LoadShader(m_vkparams, fragPath);
+    // Binary SPIR-V shader module
+    shaderStages[1].module = fragShader;
     // Main entry point for the shader
     shaderStages[1].pName = "main";
+    // Values for the shader's specialization constants
+    VkSpecializationInfo fragSpecialization = m_config.fragSpecialization.GetInfo();
+    if (!m_config.fragSpecialization.IsEmpty())
+        shaderStages[1].pSpecializationInfo = &fragSpecialization;
     assert(shaderStages[1].module != VK_NULL_HANDLE);
    
     // 
@@ -213,8 +286,9 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
 
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.layout = m_vkparams.PipelineLayout;
-    pipelineCreateInfo.renderPass = m_vkparams.RenderPass;
+    pipelineCreateInfo.layout = m_config.pipelineLayout ? m_config.pipelineLayout : m_vkparams.PipelineLayout;
+    pipelineCreateInfo.renderPass = m_config.renderPass ? m_config.renderPass : m_vkparams.RenderPass;
+    pipelineCreateInfo.subpass = m_config.subpass;
 
     // Set pipeline shader stage info
     pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
@@ -231,11 +305,8 @@ VKPipeline::CreateGraphicsPipeline(const std::string& vertPath, const std::strin
     pipelineCreateInfo.pDynamicState = &dynamicState;
 
     // Create a graphics pipeline using the specified states
+    // The pipeline cache is internally synchronized, so workers can share it
     VK_CHECK(
-        vkCreateGraphicsPipelines(m_vkparams.Device.Device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, m_vkparams.Allocator, &m_vkparams.GraphicsPipeline));
+        vkCreateGraphicsPipelines(m_vkparams.Device.Device, pipelineCache, 1, &pipelineCreateInfo, m_vkparams.Allocator, &m_pipeline));
 
-    // SPIR-V shader modules are no longer needed once the pipeline has been created
-    vkDestroyShaderModule(m_vkparams.Device.Device, shaderStages[0].module, m_vkparams.Allocator); 
-    vkDestroyShaderModule(m_vkparams.Device.Device, shaderStages[1].module, m_vkparams.Allocator); 
-    
 }
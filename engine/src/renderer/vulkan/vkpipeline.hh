@@ -1,23 +1,85 @@
 #pragma once
 #include "vkcommon.hh"
+#include "vkcmdencoder.hh"
+
+// Specialization constant values for one shader stage
+// Feature toggles that are declared with layout (constant_id = N) in a shader are baked in when the
+// pipeline is built, so one SPIR-V module can serve many variants and the driver strips the
+// branches that are turned off. Constants are 32 bit (bool as VkBool32, int, uint or float)
+struct VKSpecialization {
+    std::vector<VkSpecializationMapEntry> entries; // sorted by constant id
+    std::vector<uint32_t> data;
+
+    template <typename T>
+    void Set(uint32_t constantId, T value) {
+        static_assert(sizeof(T) == sizeof(uint32_t), "specialization constants are 32 bit");
+        uint32_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+
+        size_t i = 0;
+        while (i < entries.size() && entries[i].constantID < constantId)
+            i++;
+        if (i < entries.size() && entries[i].constantID == constantId) {
+            data[entries[i].offset / sizeof(uint32_t)] = bits;
+            return;
+        }
+
+        VkSpecializationMapEntry entry = {};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        entries.insert(entries.begin() + i, entry);
+        data.push_back(bits);
+    }
+
+    bool IsEmpty() const { return entries.empty(); }
+    VkSpecializationInfo GetInfo() const;
+    uint64_t Hash(uint64_t seed) const;
+};
 
 // Structure to hold the configuration for the pipeline
+// This only holds fixed function state that can differ between pipelines. Viewport and
+// scissor are dynamic, so they are not part of it. Configs are plain values, so they
+// can be copied around and hashed to look up pipelines that were already built
 struct VKPipelineConfig {
-    VKPipelineConfig(const VKPipelineConfig&) = delete;
-    VKPipelineConfig& operator= (const VKPipelineConfig&) = delete;
-
-    VkViewport viewport;
-    VkRect2D scissor;
-    VkPipelineViewportStateCreateInfo viewportInfo;
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
-    VkPipelineRasterizationStateCreateInfo rasterizationInfo;
-    VkPipelineMultisampleStateCreateInfo multisampleInfo;
-    VkPipelineColorBlendAttachmentState colorBlendAttachment;
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo;
-    VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
-    VkPipelineLayout pipelineLayout = nullptr;
-    VkRenderPass renderPass = nullptr;
+    // Input assembly
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    // Empty means the layout of Vertex
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+    // Rasterization
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    // Color blending
+    VkBool32 blendEnable = VK_FALSE;
+    VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+    VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+    VkColorComponentFlags colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    // Depth
+    VkBool32 depthTestEnable = VK_TRUE;
+    VkBool32 depthWriteEnable = VK_TRUE;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // Shader specialization
+    VKSpecialization vertSpecialization;
+    VKSpecialization fragSpecialization;
+
+    // Null means the backend's layout and render pass
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
     uint32_t subpass = 0;
+
+    // Hash of every field above, with the vertex layout resolved
+    uint64_t Hash() const;
 };
 
 class VKPipeline {
@@ -30,16 +92,21 @@ class VKPipeline {
         VKPipeline(const VKPipeline&) = delete;
         VKPipeline& operator= (const VKPipeline&) = delete;
 
-        void Bind(VkCommandBuffer commandBuffer);
+        void Bind(VKCommandEncoder& encoder);
         void Destroy();
 
-        // TODO: default pipeline config
+        // Shader modules are owned by the caller (see VKShaderCache)
+        // Safe to call from a worker thread
         void CreateGraphicsPipeline(
-                const std::string& vertShaderPath,
-                const std::string& fragShaderPath);
+                VkShaderModule vertShader,
+                VkShaderModule fragShader,
+                VkPipelineCache pipelineCache = VK_NULL_HANDLE);
 
+        VkPipeline GetHandle() const { return m_pipeline; }
+        const VKPipelineConfig& GetConfig() const { return m_config; }
 
     private:
         VKCommonParameters &m_vkparams;
-        const VKPipelineConfig& m_config; // configuration for the pipeline
+        VKPipelineConfig m_config; // configuration for the pipeline
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
 };
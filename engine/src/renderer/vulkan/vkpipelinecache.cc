@@ -0,0 +1,218 @@
+#include "vkpipelinecache.hh"
+#include "core/hash.hh"
+#include <vulkan/vulkan_core.h>
+
+VKPipelineCache::VKPipelineCache(VKCommonParameters &vkparams)
+    : m_vkparams(vkparams),
+    m_shaders(vkparams) {
+}
+
+VKPipelineCache::~VKPipelineCache() {
+}
+
+void
+VKPipelineCache::Initialize() {
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VK_CHECK(vkCreatePipelineCache(m_vkparams.Device.Device, &cacheInfo, m_vkparams.Allocator, &m_cache));
+}
+
+void
+VKPipelineCache::Destroy() {
+    // Jobs that have not started yet find the queue empty and return
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_queue.clear();
+    }
+    JobSystem::Wait(m_jobs);
+
+    for (auto& it : m_entries) {
+        if (it.second->pipeline)
+            it.second->pipeline->Destroy();
+    }
+    m_entries.clear();
+    m_fallback = nullptr;
+
+    m_shaders.Destroy();
+    vkDestroyPipelineCache(m_vkparams.Device.Device, m_cache, m_vkparams.Allocator);
+    m_cache = VK_NULL_HANDLE;
+}
+
+uint64_t
+VKPipelineCache::Request(const VKPipelineDesc& desc) {
+    Entry resolved;
+    uint64_t key = _resolve(desc, resolved);
+    if (key == 0)
+        return 0;
+
+    bool added = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        Entry* entry = _find_or_add(resolved, key, added);
+        if (added)
+            m_queue.push_back(entry);
+    }
+
+    if (added)
+        JobSystem::Run([this]() { _build_next(); }, &m_jobs);
+    return key;
+}
+
+uint64_t
+VKPipelineCache::Build(const VKPipelineDesc& desc) {
+    Entry resolved;
+    uint64_t key = _resolve(desc, resolved);
+    if (key == 0)
+        return 0;
+
+    Entry* entry = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        bool added = false;
+        entry = _find_or_add(resolved, key, added);
+
+        // A job already has it, wait for it instead of building twice
+        if (entry->state == ENTRY_BUILDING) {
+            m_done.wait(lock, [entry]() { return entry->state == ENTRY_READY; });
+            return key;
+        }
+        if (entry->state == ENTRY_READY)
+            return key;
+
+        // Still queued, take it off the queue and build it here
+        m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), entry), m_queue.end());
+        entry->state = ENTRY_BUILDING;
+        m_building++;
+    }
+
+    _build(*entry);
+    return key;
+}
+
+void
+VKPipelineCache::SetFallback(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_entries.find(key);
+    m_fallback = (it != m_entries.end()) ? it->second.get() : nullptr;
+}
+
+VKPipeline*
+VKPipelineCache::Get(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->second->state == ENTRY_READY)
+        return it->second->pipeline.get();
+
+    return (m_fallback && m_fallback->state == ENTRY_READY) ? m_fallback->pipeline.get() : nullptr;
+}
+
+bool
+VKPipelineCache::IsReady(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_entries.find(key);
+    return it != m_entries.end() && it->second->state == ENTRY_READY;
+}
+
+VKPipelineCacheStats
+VKPipelineCache::GetStats() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    VKPipelineCacheStats stats = m_stats;
+    stats.pending = static_cast<uint32_t>(m_queue.size()) + m_building;
+    return stats;
+}
+
+void
+VKPipelineCache::WaitIdle() {
+    // Helps with the builds instead of just blocking
+    JobSystem::Wait(m_jobs);
+
+    // Build() may still be compiling on another thread
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [this]() { return m_queue.empty() && m_building == 0; });
+}
+
+//
+// PRIVATE
+//
+
+// Load the shader modules for a desc and compute its key
+// The key covers the shader code (not the paths), so identical shaders under different
+// names still share pipelines
+uint64_t
+VKPipelineCache::_resolve(const VKPipelineDesc& desc, Entry& resolved) {
+    uint64_t vertHash = 0;
+    uint64_t fragHash = 0;
+    resolved.vertShader = m_shaders.Get(desc.vertShader, &vertHash);
+    resolved.fragShader = m_shaders.Get(desc.fragShader, &fragHash);
+    if (resolved.vertShader == VK_NULL_HANDLE || resolved.fragShader == VK_NULL_HANDLE) {
+        std::cerr << "Error: could not create pipeline for " << desc.vertShader << " / " << desc.fragShader << std::endl;
+        return 0;
+    }
+
+    // Resolve defaults so that they hash the same as the handles they stand for
+    resolved.config = desc.config;
+    if (resolved.config.pipelineLayout == VK_NULL_HANDLE)
+        resolved.config.pipelineLayout = m_vkparams.PipelineLayout;
+    if (resolved.config.renderPass == VK_NULL_HANDLE)
+        resolved.config.renderPass = m_vkparams.RenderPass;
+
+    uint64_t key = HashCombine(HashCombine(vertHash, fragHash), resolved.config.Hash());
+    return key == 0 ? 1 : key; // 0 is reserved for failures
+}
+
+// Must be called with m_lock held
+VKPipelineCache::Entry*
+VKPipelineCache::_find_or_add(const Entry& resolved, uint64_t key, bool& added) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_stats.hits++;
+        added = false;
+        return it->second.get();
+    }
+
+    m_stats.misses++;
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    entry->vertShader = resolved.vertShader;
+    entry->fragShader = resolved.fragShader;
+    entry->config = resolved.config;
+    Entry* result = entry.get();
+    m_entries[key] = std::move(entry);
+    added = true;
+    return result;
+}
+
+// Compile a pipeline. The entry must already be marked as building
+void
+VKPipelineCache::_build(Entry& entry) {
+    std::unique_ptr<VKPipeline> pipeline = std::make_unique<VKPipeline>(m_vkparams, entry.config);
+    pipeline->CreateGraphicsPipeline(entry.vertShader, entry.fragShader, m_cache);
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        entry.pipeline = std::move(pipeline);
+        entry.state = ENTRY_READY;
+        m_building--;
+        m_stats.pipelineCount++;
+    }
+    m_done.notify_all();
+}
+
+// Run by the job started for each queued pipeline
+// Takes whatever is at the front rather than a fixed entry, since Build() may have already
+// pulled the one this job was started for off the queue
+void
+VKPipelineCache::_build_next() {
+    Entry* entry = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_queue.empty())
+            return;
+
+        entry = m_queue.front();
+        m_queue.pop_front();
+        entry->state = ENTRY_BUILDING;
+        m_building++;
+    }
+
+    _build(*entry);
+}
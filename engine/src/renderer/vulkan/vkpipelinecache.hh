@@ -0,0 +1,102 @@
+#pragma once
+#include "vkcommon.hh"
+#include "vkpipeline.hh"
+#include "vkshadercache.hh"
+#include "core/jobs.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Describes one pipeline variant
+struct VKPipelineDesc {
+    std::string vertShader; // paths relative to the asset root
+    std::string fragShader;
+    VKPipelineConfig config;
+};
+
+struct VKPipelineCacheStats {
+    uint64_t hits = 0;          // requests for a pipeline that already existed (or was being built)
+    uint64_t misses = 0;        // requests that created a new pipeline
+    uint32_t pipelineCount = 0; // pipelines built so far
+    uint32_t pending = 0;       // pipelines queued or being built
+};
+
+// Builds and owns graphics pipelines
+//
+// Pipelines are keyed by the hash of their shader code and their full config (fixed function
+// state, vertex layout and render pass), so asking for the same state twice returns the pipeline
+// that already exists instead of compiling a duplicate.
+// Pipelines can be requested ahead of time (ie at startup) and are compiled in parallel as jobs,
+// all sharing one VkPipelineCache so that the driver can reuse work between them.
+// Asking for a pipeline that is not ready yet returns the fallback pipeline instead of stalling
+// the frame on compilation.
+class VKPipelineCache {
+    public:
+        VKPipelineCache(VKCommonParameters &vkparams);
+        ~VKPipelineCache();
+        VKPipelineCache(const VKPipelineCache&) = delete;
+        VKPipelineCache& operator= (const VKPipelineCache&) = delete;
+
+        // Create the Vulkan pipeline cache
+        // The render pass and pipeline layout in vkparams must already exist
+        void Initialize();
+        void Destroy();
+
+        // Queue a pipeline to be built in the background and return its key
+        // Returns 0 if the shaders could not be loaded
+        uint64_t Request(const VKPipelineDesc& desc);
+        // Build a pipeline on the calling thread (or wait for a job that is already on it)
+        uint64_t Build(const VKPipelineDesc& desc);
+
+        // Pipeline to use when the requested one is not ready yet
+        void SetFallback(uint64_t key);
+
+        // Returns the pipeline for key, or the fallback if it is still compiling
+        VKPipeline* Get(uint64_t key);
+        bool IsReady(uint64_t key);
+
+        // Block until every queued pipeline has been built
+        void WaitIdle();
+
+        VKShaderCache& GetShaderCache() { return m_shaders; }
+        VKPipelineCacheStats GetStats();
+
+    private:
+        enum EntryState {
+            ENTRY_QUEUED,
+            ENTRY_BUILDING,
+            ENTRY_READY,
+        };
+
+        struct Entry {
+            VkShaderModule vertShader = VK_NULL_HANDLE;
+            VkShaderModule fragShader = VK_NULL_HANDLE;
+            VKPipelineConfig config;
+            std::unique_ptr<VKPipeline> pipeline;
+            EntryState state = ENTRY_QUEUED;
+        };
+
+        uint64_t _resolve(const VKPipelineDesc& desc, Entry& resolved);
+        Entry* _find_or_add(const Entry& resolved, uint64_t key, bool& added);
+        void _build(Entry& entry);
+        void _build_next();
+
+        VKCommonParameters &m_vkparams;
+        VKShaderCache m_shaders;
+        VkPipelineCache m_cache = VK_NULL_HANDLE;
+
+        std::mutex m_lock;
+        std::condition_variable m_done;  // signaled when a pipeline finishes building
+        std::unordered_map<uint64_t, std::unique_ptr<Entry> > m_entries;
+        std::deque<Entry*> m_queue;
+        uint32_t m_building = 0;
+        Entry* m_fallback = nullptr;
+        VKPipelineCacheStats m_stats;
+
+        // One build job per queued pipeline
+        JobCounter m_jobs;
+};
@@ -0,0 +1,600 @@
+#include "vkrendergraph.hh"
+#include "vulkan_backend.hh"
+#include "core/hash.hh"
+
+VKRenderGraph::VKRenderGraph(VKCommonParameters &vkparams, uint32_t framesInFlight)
+    : m_vkparams(vkparams),
+    m_framesInFlight(framesInFlight) {
+}
+
+void
+VKRenderGraph::SetImportedImage(RGHandle handle, VkImage image, VkImageView view, VkFormat format) {
+    Imported imported = {};
+    imported.image = image;
+    imported.view = view;
+    imported.format = format;
+    m_imported[handle] = imported;
+}
+
+bool
+VKRenderGraph::Compile(RenderGraph& graph, uint64_t frameNumber) {
+    m_frameNumber = frameNumber;
+    m_current = nullptr;
+
+    if (!graph.Compile([this](const RGResource& resource) { return _query_memory(resource); }))
+        return false;
+
+    uint64_t key = HashValue(frameNumber % m_framesInFlight, _transient_key(graph));
+    auto it = m_transients.find(key);
+    if (it == m_transients.end()) {
+        TransientSet* set = _create_transients(graph);
+        it = m_transients.emplace(key, std::unique_ptr<TransientSet>(set)).first;
+    }
+
+    m_current = it->second.get();
+    m_current->lastUsed = frameNumber;
+    return true;
+}
+
+void
+VKRenderGraph::Execute(const RenderGraph& graph, VkCommandBuffer cmdBuffer) {
+    const std::vector<RGPass>& passes = graph.GetPasses();
+    const std::vector<uint32_t>& order = graph.GetOrder();
+    for (size_t o = 0; o < order.size(); o++) {
+        const RGPass& pass = passes[order[o]];
+        _record_barriers(graph, cmdBuffer, pass.barriers);
+
+        bool inRenderPass = _begin_render_pass(graph, pass, cmdBuffer);
+        graph.ExecutePass(order[o], cmdBuffer);
+        if (inRenderPass)
+            vkCmdEndRenderPass(cmdBuffer);
+    }
+
+    _record_barriers(graph, cmdBuffer, graph.GetFinalBarriers());
+    m_imported.clear();
+}
+
+void
+VKRenderGraph::ReleaseUnused(uint64_t frameNumber) {
+    for (auto it = m_transients.begin(); it != m_transients.end();) {
+        // A set comes back around every m_framesInFlight frames, it is unused once it misses its turn
+        if (it->second.get() != m_current && it->second->lastUsed + m_framesInFlight < frameNumber) {
+            _destroy_transients(*it->second);
+            it = m_transients.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = m_framebuffers.begin(); it != m_framebuffers.end();) {
+        if (it->second.lastUsed + m_framesInFlight <= frameNumber) {
+            vkDestroyFramebuffer(m_vkparams.Device.Device, it->second.handle, m_vkparams.Allocator);
+            it = m_framebuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void
+VKRenderGraph::Destroy() {
+    for (auto& it : m_transients) {
+        _destroy_transients(*it.second);
+    }
+    m_transients.clear();
+    m_current = nullptr;
+
+    for (auto& it : m_framebuffers) {
+        vkDestroyFramebuffer(m_vkparams.Device.Device, it.second.handle, m_vkparams.Allocator);
+    }
+    m_framebuffers.clear();
+
+    for (auto& it : m_renderPasses) {
+        vkDestroyRenderPass(m_vkparams.Device.Device, it.second, m_vkparams.Allocator);
+    }
+    m_renderPasses.clear();
+    m_requirements.clear();
+    m_imported.clear();
+}
+
+VkImage
+VKRenderGraph::GetImage(RGHandle handle) const {
+    auto it = m_imported.find(handle);
+    if (it != m_imported.end())
+        return it->second.image;
+    return (m_current && handle < m_current->images.size()) ? m_current->images[handle] : VK_NULL_HANDLE;
+}
+
+VkImageView
+VKRenderGraph::GetImageView(RGHandle handle) const {
+    auto it = m_imported.find(handle);
+    if (it != m_imported.end())
+        return it->second.view;
+    return (m_current && handle < m_current->views.size()) ? m_current->views[handle] : VK_NULL_HANDLE;
+}
+
+VkBuffer
+VKRenderGraph::GetBuffer(RGHandle handle) const {
+    return (m_current && handle < m_current->buffers.size()) ? m_current->buffers[handle] : VK_NULL_HANDLE;
+}
+
+VkFormat
+VKRenderGraph::ToVkFormat(RGFormat format) {
+    switch (format) {
+        case RG_FORMAT_RGBA8_UNORM:  return VK_FORMAT_R8G8B8A8_UNORM;
+        case RG_FORMAT_BGRA8_UNORM:  return VK_FORMAT_B8G8R8A8_UNORM;
+        case RG_FORMAT_RGBA16_FLOAT: return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case RG_FORMAT_R32_FLOAT:    return VK_FORMAT_R32_SFLOAT;
+        case RG_FORMAT_D32_FLOAT:    return VK_FORMAT_D32_SFLOAT;
+        default:                     return VK_FORMAT_UNDEFINED;
+    }
+}
+
+RGFormat
+VKRenderGraph::FromVkFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:      return RG_FORMAT_RGBA8_UNORM;
+        case VK_FORMAT_B8G8R8A8_UNORM:      return RG_FORMAT_BGRA8_UNORM;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return RG_FORMAT_RGBA16_FLOAT;
+        case VK_FORMAT_R32_SFLOAT:          return RG_FORMAT_R32_FLOAT;
+        case VK_FORMAT_D32_SFLOAT:          return RG_FORMAT_D32_FLOAT;
+        default:                            return RG_FORMAT_UNDEFINED;
+    }
+}
+
+//
+// PRIVATE
+//
+
+// Stages, access and layout for each kind of use
+// source is true when the access is what a barrier waits on, and false when it is what the
+// barrier waits for. It only matters for present: waiting on a presented image has to be done
+// at the color output stage so it chains with the wait on the image available semaphore
+VKRenderGraph::AccessInfo
+VKRenderGraph::_access_info(RGAccess access, bool depth, bool source) {
+    VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+        | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+        | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    VkPipelineStageFlags presentStage = source
+        ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    switch (access) {
+        case RG_ACCESS_COLOR_ATTACHMENT:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        case RG_ACCESS_DEPTH_ATTACHMENT:
+            return { depthStages,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        case RG_ACCESS_DEPTH_READ:
+            return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        case RG_ACCESS_SHADER_READ:
+            return { shaderStages,
+                     VK_ACCESS_SHADER_READ_BIT,
+                     depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case RG_ACCESS_STORAGE_WRITE:
+            return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case RG_ACCESS_TRANSFER_SRC:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+        case RG_ACCESS_TRANSFER_DST:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+        case RG_ACCESS_PRESENT:
+            return { presentStage, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+        case RG_ACCESS_NONE:
+        default:
+            return { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+    }
+}
+
+bool
+VKRenderGraph::_is_depth(VkFormat format) {
+    return format == VK_FORMAT_D32_SFLOAT;
+}
+
+VkFormat
+VKRenderGraph::_format(const RenderGraph& graph, RGHandle handle) const {
+    auto it = m_imported.find(handle);
+    if (it != m_imported.end() && it->second.format != VK_FORMAT_UNDEFINED)
+        return it->second.format;
+    return ToVkFormat(graph.GetResource(handle).desc.format);
+}
+
+VkImageUsageFlags
+VKRenderGraph::_image_usage(uint32_t accessMask) const {
+    VkImageUsageFlags usage = 0;
+    if (accessMask & (1u << RG_ACCESS_COLOR_ATTACHMENT))
+        usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (accessMask & ((1u << RG_ACCESS_DEPTH_ATTACHMENT) | (1u << RG_ACCESS_DEPTH_READ)))
+        usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (accessMask & (1u << RG_ACCESS_SHADER_READ))
+        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (accessMask & (1u << RG_ACCESS_STORAGE_WRITE))
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    if (accessMask & (1u << RG_ACCESS_TRANSFER_SRC))
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (accessMask & (1u << RG_ACCESS_TRANSFER_DST))
+        usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    return usage;
+}
+
+VkBufferUsageFlags
+VKRenderGraph::_buffer_usage(uint32_t accessMask) const {
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    if (accessMask & (1u << RG_ACCESS_TRANSFER_SRC))
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    if (accessMask & (1u << RG_ACCESS_TRANSFER_DST))
+        usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    return usage;
+}
+
+// Memory requirements only depend on the description and usage, so a throwaway resource is
+// created once per combination to ask the driver, and the answer is cached
+RGMemoryRequirements
+VKRenderGraph::_query_memory(const RGResource& resource) {
+    uint64_t key = HashValue(resource.desc.type);
+    key = HashValue(resource.desc.width, key);
+    key = HashValue(resource.desc.height, key);
+    key = HashValue(resource.desc.format, key);
+    key = HashValue(resource.desc.size, key);
+    key = HashValue(resource.accessMask, key);
+
+    auto it = m_requirements.find(key);
+    if (it != m_requirements.end())
+        return it->second;
+
+    VkMemoryRequirements memReqs = {};
+    if (resource.desc.type == RG_RESOURCE_IMAGE) {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = ToVkFormat(resource.desc.format);
+        imageInfo.extent = { resource.desc.width, resource.desc.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = _image_usage(resource.accessMask);
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateImage(m_vkparams.Device.Device, &imageInfo, m_vkparams.Allocator, &image));
+        vkGetImageMemoryRequirements(m_vkparams.Device.Device, image, &memReqs);
+        vkDestroyImage(m_vkparams.Device.Device, image, m_vkparams.Allocator);
+    } else {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = resource.desc.size;
+        bufferInfo.usage = _buffer_usage(resource.accessMask);
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateBuffer(m_vkparams.Device.Device, &bufferInfo, m_vkparams.Allocator, &buffer));
+        vkGetBufferMemoryRequirements(m_vkparams.Device.Device, buffer, &memReqs);
+        vkDestroyBuffer(m_vkparams.Device.Device, buffer, m_vkparams.Allocator);
+    }
+
+    RGMemoryRequirements requirements = {};
+    requirements.size = memReqs.size;
+    requirements.alignment = memReqs.alignment;
+    requirements.typeBits = memReqs.memoryTypeBits;
+    m_requirements[key] = requirements;
+    return requirements;
+}
+
+// Two graphs with the same transients, used the same way and aliased the same way can
+// share physical resources
+uint64_t
+VKRenderGraph::_transient_key(const RenderGraph& graph) const {
+    const std::vector<RGResource>& resources = graph.GetResources();
+    uint64_t key = HashValue(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        const RGResource& resource = resources[i];
+        if (resource.block == UINT32_MAX)
+            continue;
+        key = HashValue(i, key);
+        key = HashValue(resource.desc.type, key);
+        key = HashValue(resource.desc.width, key);
+        key = HashValue(resource.desc.height, key);
+        key = HashValue(resource.desc.format, key);
+        key = HashValue(resource.desc.size, key);
+        key = HashValue(resource.accessMask, key);
+        key = HashValue(resource.block, key);
+    }
+
+    const std::vector<RGMemoryBlock>& blocks = graph.GetMemoryBlocks();
+    for (size_t b = 0; b < blocks.size(); b++) {
+        key = HashValue(blocks[b].size, key);
+        key = HashValue(blocks[b].typeBits, key);
+    }
+    return key;
+}
+
+VKRenderGraph::TransientSet*
+VKRenderGraph::_create_transients(const RenderGraph& graph) {
+    const std::vector<RGResource>& resources = graph.GetResources();
+    const std::vector<RGMemoryBlock>& blocks = graph.GetMemoryBlocks();
+
+    TransientSet* set = new TransientSet();
+    set->images.resize(resources.size(), VK_NULL_HANDLE);
+    set->views.resize(resources.size(), VK_NULL_HANDLE);
+    set->buffers.resize(resources.size(), VK_NULL_HANDLE);
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = blocks[b].size;
+        allocInfo.memoryTypeIndex = VKBackend::GetMemoryTypeIndex(
+                blocks[b].typeBits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_vkparams.Device.DeviceMemoryProperties);
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateMemory(m_vkparams.Device.Device, &allocInfo, m_vkparams.Allocator, &memory));
+        set->blocks.push_back(memory);
+    }
+
+    for (size_t i = 0; i < resources.size(); i++) {
+        const RGResource& resource = resources[i];
+        if (resource.block == UINT32_MAX)
+            continue;
+
+        VkDeviceMemory memory = set->blocks[resource.block];
+        if (resource.desc.type == RG_RESOURCE_IMAGE) {
+            VkFormat format = ToVkFormat(resource.desc.format);
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = format;
+            imageInfo.extent = { resource.desc.width, resource.desc.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = _image_usage(resource.accessMask);
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VK_CHECK(vkCreateImage(m_vkparams.Device.Device, &imageInfo, m_vkparams.Allocator, &set->images[i]));
+            VK_CHECK(vkBindImageMemory(m_vkparams.Device.Device, set->images[i], memory, 0));
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = set->images[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = format;
+            viewInfo.subresourceRange.aspectMask = _is_depth(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+            VK_CHECK(vkCreateImageView(m_vkparams.Device.Device, &viewInfo, m_vkparams.Allocator, &set->views[i]));
+        } else {
+            VkBufferCreateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = resource.desc.size;
+            bufferInfo.usage = _buffer_usage(resource.accessMask);
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VK_CHECK(vkCreateBuffer(m_vkparams.Device.Device, &bufferInfo, m_vkparams.Allocator, &set->buffers[i]));
+            VK_CHECK(vkBindBufferMemory(m_vkparams.Device.Device, set->buffers[i], memory, 0));
+        }
+    }
+
+    const RGStats& stats = graph.GetStats();
+    std::cout << "Render graph transients created: [" << stats.transientResources << " resources, "
+        << stats.allocatedBytes << " bytes, " << stats.savedBytes << " bytes saved by aliasing]" << std::endl;
+    return set;
+}
+
+void
+VKRenderGraph::_destroy_transients(TransientSet& set) {
+    for (size_t i = 0; i < set.views.size(); i++) {
+        if (set.views[i] != VK_NULL_HANDLE)
+            vkDestroyImageView(m_vkparams.Device.Device, set.views[i], m_vkparams.Allocator);
+        if (set.images[i] != VK_NULL_HANDLE)
+            vkDestroyImage(m_vkparams.Device.Device, set.images[i], m_vkparams.Allocator);
+        if (set.buffers[i] != VK_NULL_HANDLE)
+            vkDestroyBuffer(m_vkparams.Device.Device, set.buffers[i], m_vkparams.Allocator);
+    }
+    for (size_t b = 0; b < set.blocks.size(); b++) {
+        vkFreeMemory(m_vkparams.Device.Device, set.blocks[b], m_vkparams.Allocator);
+    }
+    set = TransientSet();
+}
+
+// All of a pass's transitions go into one barrier call
+void
+VKRenderGraph::_record_barriers(const RenderGraph& graph, VkCommandBuffer cmdBuffer, const std::vector<RGBarrier>& barriers) {
+    if (barriers.empty())
+        return;
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+
+    for (size_t i = 0; i < barriers.size(); i++) {
+        const RGBarrier& barrier = barriers[i];
+        const RGResource& resource = graph.GetResource(barrier.resource);
+        VkFormat format = _format(graph, barrier.resource);
+        bool depth = _is_depth(format);
+
+        AccessInfo src = _access_info(barrier.before, depth, true);
+        AccessInfo dst = _access_info(barrier.after, depth, false);
+        srcStages |= src.stage;
+        dstStages |= dst.stage;
+
+        if (resource.desc.type == RG_RESOURCE_IMAGE) {
+            VkImageMemoryBarrier imageBarrier = {};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = src.access;
+            imageBarrier.dstAccessMask = dst.access;
+            imageBarrier.oldLayout = barrier.discard ? VK_IMAGE_LAYOUT_UNDEFINED : src.layout;
+            imageBarrier.newLayout = dst.layout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = GetImage(barrier.resource);
+            imageBarrier.subresourceRange.aspectMask = depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = 1;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = 1;
+            imageBarriers.push_back(imageBarrier);
+        } else {
+            VkBufferMemoryBarrier bufferBarrier = {};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = src.access;
+            bufferBarrier.dstAccessMask = dst.access;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = GetBuffer(barrier.resource);
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    vkCmdPipelineBarrier(
+            cmdBuffer,
+            srcStages,
+            dstStages,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+            static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+// Passes that render to attachments get a render pass made for them
+// Layouts are handled by the graph's barriers, so every attachment starts and ends in the
+// layout it is used in. Render passes only differ from the one pipelines are built against
+// in layouts and load ops, so they stay compatible with those pipelines
+bool
+VKRenderGraph::_begin_render_pass(const RenderGraph& graph, const RGPass& pass, VkCommandBuffer cmdBuffer) {
+    std::vector<const RGResourceUse*> colors;
+    const RGResourceUse* depth = nullptr;
+    for (size_t w = 0; w < pass.writes.size(); w++) {
+        if (pass.writes[w].access == RG_ACCESS_COLOR_ATTACHMENT)
+            colors.push_back(&pass.writes[w]);
+        else if (pass.writes[w].access == RG_ACCESS_DEPTH_ATTACHMENT)
+            depth = &pass.writes[w];
+    }
+    for (size_t r = 0; r < pass.reads.size() && !depth; r++) {
+        if (pass.reads[r].access == RG_ACCESS_DEPTH_READ)
+            depth = &pass.reads[r];
+    }
+    if (colors.empty() && !depth)
+        return false;
+
+    std::vector<const RGResourceUse*> attachments = colors;
+    if (depth)
+        attachments.push_back(depth);
+
+    // Find or create the render pass
+    uint64_t passKey = HashValue(colors.size());
+    for (size_t a = 0; a < attachments.size(); a++) {
+        passKey = HashValue(_format(graph, attachments[a]->resource), passKey);
+        passKey = HashValue(attachments[a]->access, passKey);
+        passKey = HashValue(attachments[a]->load, passKey);
+    }
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    auto rp = m_renderPasses.find(passKey);
+    if (rp != m_renderPasses.end()) {
+        renderPass = rp->second;
+    } else {
+        std::vector<VkAttachmentDescription> descriptions(attachments.size());
+        std::vector<VkAttachmentReference> colorRefs;
+        VkAttachmentReference depthRef = {};
+        for (size_t a = 0; a < attachments.size(); a++) {
+            VkFormat format = _format(graph, attachments[a]->resource);
+            VkImageLayout layout = _access_info(attachments[a]->access, _is_depth(format), false).layout;
+
+            VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_LOAD;
+            if (attachments[a]->load == RG_LOAD_OP_CLEAR)
+                load = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            else if (attachments[a]->load == RG_LOAD_OP_DONT_CARE)
+                load = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+            descriptions[a] = {};
+            descriptions[a].format = format;
+            descriptions[a].samples = VK_SAMPLE_COUNT_1_BIT;
+            descriptions[a].loadOp = load;
+            descriptions[a].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            descriptions[a].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            descriptions[a].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            descriptions[a].initialLayout = layout;
+            descriptions[a].finalLayout = layout;
+
+            if (a < colors.size()) {
+                colorRefs.push_back({ static_cast<uint32_t>(a), layout });
+            } else {
+                depthRef = { static_cast<uint32_t>(a), layout };
+            }
+        }
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+        subpass.pColorAttachments = colorRefs.data();
+        subpass.pDepthStencilAttachment = depth ? &depthRef : nullptr;
+
+        VkRenderPassCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        createInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+        createInfo.pAttachments = descriptions.data();
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        VK_CHECK(vkCreateRenderPass(m_vkparams.Device.Device, &createInfo, m_vkparams.Allocator, &renderPass));
+        m_renderPasses[passKey] = renderPass;
+    }
+
+    // Find or create the framebuffer
+    const RGResourceDesc& first = graph.GetResource(attachments[0]->resource).desc;
+    std::vector<VkImageView> views(attachments.size());
+    uint64_t fbKey = HashValue(renderPass);
+    fbKey = HashValue(first.width, fbKey);
+    fbKey = HashValue(first.height, fbKey);
+    for (size_t a = 0; a < attachments.size(); a++) {
+        views[a] = GetImageView(attachments[a]->resource);
+        fbKey = HashValue(views[a], fbKey);
+    }
+
+    CachedFramebuffer& framebuffer = m_framebuffers[fbKey];
+    if (framebuffer.handle == VK_NULL_HANDLE) {
+        VkFramebufferCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        createInfo.renderPass = renderPass;
+        createInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        createInfo.pAttachments = views.data();
+        createInfo.width = first.width;
+        createInfo.height = first.height;
+        createInfo.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(m_vkparams.Device.Device, &createInfo, m_vkparams.Allocator, &framebuffer.handle));
+    }
+    framebuffer.lastUsed = m_frameNumber;
+
+    std::vector<VkClearValue> clearValues(attachments.size());
+    for (size_t a = 0; a < attachments.size(); a++) {
+        const float* clear = attachments[a]->clear;
+        if (a < colors.size()) {
+            clearValues[a].color = { { clear[0], clear[1], clear[2], clear[3] } };
+        } else {
+            clearValues[a].depthStencil = { clear[0], 0 };
+        }
+    }
+
+    VkRenderPassBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.renderPass = renderPass;
+    beginInfo.framebuffer = framebuffer.handle;
+    beginInfo.renderArea.offset = { 0, 0 };
+    beginInfo.renderArea.extent = { first.width, first.height };
+    beginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    beginInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "vkcommon.hh"
+#include "renderer/render_graph.hh"
+
+#include <memory>
+#include <unordered_map>
+
+// Runs a RenderGraph with Vulkan
+//
+// Each compiled pass gets one vkCmdPipelineBarrier with all of its transitions, and passes
+// that write attachments run inside a render pass that is built for them (attachments keep
+// the layout the graph put them in, so the render pass itself does no transitions).
+// Transient resources are created for the graph and bound to shared memory blocks the way the
+// graph aliased them. The set of transients is kept while the graph stays the same shape,
+// so building the same graph every frame does not create anything after the first few frames.
+// Each frame in flight slot has a set of its own. The barriers the graph schedules only order
+// passes within one frame, so a transient's first use could otherwise overwrite memory the
+// previous frame is still reading. A slot's set is only used again once its fence was waited on
+// Anything that has not been used for a few frames (ie after a resize) is destroyed once the
+// frames that used it have retired
+class VKRenderGraph {
+    public:
+        VKRenderGraph(VKCommonParameters &vkparams, uint32_t framesInFlight);
+        ~VKRenderGraph() {}
+        VKRenderGraph(const VKRenderGraph&) = delete;
+        VKRenderGraph& operator= (const VKRenderGraph&) = delete;
+
+        // Supply the real resource behind an imported image for this frame
+        void SetImportedImage(RGHandle handle, VkImage image, VkImageView view, VkFormat format);
+
+        // Compile the graph and create (or reuse) its transient resources
+        bool Compile(RenderGraph& graph, uint64_t frameNumber);
+        // Record every surviving pass and its barriers
+        void Execute(const RenderGraph& graph, VkCommandBuffer cmdBuffer);
+
+        // Destroy resources that no frame in flight uses anymore
+        void ReleaseUnused(uint64_t frameNumber);
+        void Destroy();
+
+        // Resources for use inside of pass callbacks
+        VkImage GetImage(RGHandle handle) const;
+        VkImageView GetImageView(RGHandle handle) const;
+        VkBuffer GetBuffer(RGHandle handle) const;
+
+        static VkFormat ToVkFormat(RGFormat format);
+        static RGFormat FromVkFormat(VkFormat format);
+
+    private:
+        struct AccessInfo {
+            VkPipelineStageFlags stage;
+            VkAccessFlags access;
+            VkImageLayout layout;
+        };
+
+        // Physical resources for one shape of graph
+        struct TransientSet {
+            std::vector<VkDeviceMemory> blocks;
+            std::vector<VkImage> images;      // indexed by handle
+            std::vector<VkImageView> views;
+            std::vector<VkBuffer> buffers;
+            uint64_t lastUsed = 0;
+        };
+
+        struct CachedFramebuffer {
+            VkFramebuffer handle = VK_NULL_HANDLE;
+            uint64_t lastUsed = 0;
+        };
+
+        struct Imported {
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+        };
+
+        static AccessInfo _access_info(RGAccess access, bool depth, bool source);
+        static bool _is_depth(VkFormat format);
+
+        VkFormat _format(const RenderGraph& graph, RGHandle handle) const;
+        VkImageUsageFlags _image_usage(uint32_t accessMask) const;
+        VkBufferUsageFlags _buffer_usage(uint32_t accessMask) const;
+        RGMemoryRequirements _query_memory(const RGResource& resource);
+        uint64_t _transient_key(const RenderGraph& graph) const;
+        TransientSet* _create_transients(const RenderGraph& graph);
+        void _destroy_transients(TransientSet& set);
+        void _record_barriers(const RenderGraph& graph, VkCommandBuffer cmdBuffer, const std::vector<RGBarrier>& barriers);
+        bool _begin_render_pass(const RenderGraph& graph, const RGPass& pass, VkCommandBuffer cmdBuffer);
+
+        VKCommonParameters &m_vkparams;
+        uint32_t m_framesInFlight;
+        uint64_t m_frameNumber = 0;
+
+        std::unordered_map<RGHandle, Imported> m_imported;
+        std::unordered_map<uint64_t, RGMemoryRequirements> m_requirements;        // by desc and usage
+        std::unordered_map<uint64_t, std::unique_ptr<TransientSet> > m_transients; // by graph shape and frame slot
+        TransientSet* m_current = nullptr;
+        std::unordered_map<uint64_t, VkRenderPass> m_renderPasses;                 // by attachment setup
+        std::unordered_map<uint64_t, CachedFramebuffer> m_framebuffers;            // by render pass and views
+};
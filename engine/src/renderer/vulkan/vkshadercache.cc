@@ -0,0 +1,65 @@
+#include "vkshadercache.hh"
+#include "core/filesystem.hh"
+#include "core/hash.hh"
+#include <vulkan/vulkan_core.h>
+
+VKShaderCache::VKShaderCache(VKCommonParameters &vkparams)
+    : m_vkparams(vkparams) {
+}
+
+VkShaderModule
+VKShaderCache::Get(const std::string& path, uint64_t* hash) {
+    uint64_t pathHash = HashString(FileSystem::NormalizePath(path));
+
+    // Paths we have already seen skip the file system entirely
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto known = m_paths.find(pathHash);
+        if (known != m_paths.end()) {
+            if (hash)
+                *hash = known->second;
+            return m_modules[known->second];
+        }
+    }
+
+    FileData code;
+    if (!FileSystem::Read(path, code)) {
+        std::cerr << "Error: could not open shader file " << path << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    assert(code.Size() > 0 && code.Size() % sizeof(uint32_t) == 0);
+
+    uint64_t contentHash = Hash64(code.Data(), code.Size());
+    if (hash)
+        *hash = contentHash;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_paths[pathHash] = contentHash;
+
+    // Same code under a different path
+    auto existing = m_modules.find(contentHash);
+    if (existing != m_modules.end())
+        return existing->second;
+
+    VkShaderModuleCreateInfo moduleCreateInfo = {};
+    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleCreateInfo.codeSize = code.Size();
+    moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.Data());
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VK_CHECK(
+        vkCreateShaderModule(m_vkparams.Device.Device, &moduleCreateInfo, m_vkparams.Allocator, &shaderModule));
+
+    m_modules[contentHash] = shaderModule;
+    return shaderModule;
+}
+
+void
+VKShaderCache::Destroy() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto& it : m_modules) {
+        vkDestroyShaderModule(m_vkparams.Device.Device, it.second, m_vkparams.Allocator);
+    }
+    m_modules.clear();
+    m_paths.clear();
+}
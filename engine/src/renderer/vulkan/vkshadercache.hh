@@ -0,0 +1,31 @@
+#pragma once
+#include "vkcommon.hh"
+
+#include <mutex>
+#include <unordered_map>
+
+// Caches shader modules by the hash of their SPIR-V
+// Two paths with identical code share one module, and a module is only created once
+// no matter how many pipelines use it. Safe to use from pipeline build workers
+class VKShaderCache {
+    public:
+        VKShaderCache(VKCommonParameters &vkparams);
+        ~VKShaderCache() {}
+        VKShaderCache(const VKShaderCache&) = delete;
+        VKShaderCache& operator= (const VKShaderCache&) = delete;
+
+        // Returns the module for a SPIR-V file, loading it on the first request
+        // If hash is not null, it receives the content hash of the code
+        VkShaderModule Get(const std::string& path, uint64_t* hash = nullptr);
+
+        void Destroy();
+
+        uint32_t GetModuleCount() const { return static_cast<uint32_t>(m_modules.size()); }
+
+    private:
+        VKCommonParameters &m_vkparams;
+
+        std::mutex m_lock;
+        std::unordered_map<uint64_t, VkShaderModule> m_modules; // content hash -> module
+        std::unordered_map<uint64_t, uint64_t> m_paths;         // path hash -> content hash
+};
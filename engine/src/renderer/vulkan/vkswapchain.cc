@@ -1,12 +1,12 @@
 #include "vkswapchain.hh"
 
-void 
+bool 
 RecreateSwapchain(
         VKCommonParameters &params, 
         uint32_t* width, 
         uint32_t *height, 
-        bool vsync, 
-        uint32_t &commandBufferCount
+        VkPresentModeKHR presentMode, 
+        RetiredSwapchain& retired
 ) {
     // Store the current swap chain handle so we can use it later to ease recreation
     VkSwapchainKHR oldSwapchain = params.SwapChain.Handle;
@@ -18,6 +18,10 @@ RecreateSwapchain(
                 params.PresentationSurface, 
                 &surfCaps));
 
+    // A minimized window reports a zero sized surface, and a swapchain cannot be created for it
+    if (surfCaps.currentExtent.width == 0 || surfCaps.currentExtent.height == 0)
+        return false;
+
     // Get the available present modes
     uint32_t presentModeCount = 0;
     VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(
@@ -37,23 +41,25 @@ RecreateSwapchain(
                 presentModes.data()));
 
     // Select present mode for the swapchain
-    VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    // Mailbox and immediate both avoid waiting on vblank, so each falls back to the other
+    // before falling back to FIFO. FIFO relaxed falls back to FIFO
+    std::vector<VkPresentModeKHR> candidates = { presentMode };
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    else if (presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
 
-    // If v-sync is not requested, try to find a mailbox mode
-    // It's the lowest latency non-tearing present mode available
-    if (!vsync) {
-        std::cout << "Disable Vsync" << std::endl;
-        for (size_t i = 0; i < presentModeCount; i++) {
-            if (presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-                swapchainPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-                break;
-            }
-            if (presentModes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-                swapchainPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-            }
+    VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        if (std::find(presentModes.begin(), presentModes.end(), candidates[c]) != presentModes.end()) {
+            swapchainPresentMode = candidates[c];
+            break;
         }
     }
 
+    if (swapchainPresentMode != presentMode)
+        std::cout << "WARNING: requested present mode is not supported by the surface" << std::endl;
+
     // Print the present mode
     switch(swapchainPresentMode) {
         case VK_PRESENT_MODE_MAILBOX_KHR:
@@ -82,8 +88,8 @@ RecreateSwapchain(
               break;
     }
 
-    // Determine the number of images and set the number of command buffers
-    uint32_t desiredSwapchainImageCount = commandBufferCount  = surfCaps.minImageCount+1;
+    // Determine the number of images
+    uint32_t desiredSwapchainImageCount = surfCaps.minImageCount+1;
     if ( (surfCaps.maxImageCount > 0) && (desiredSwapchainImageCount > surfCaps.maxImageCount) ) {
         desiredSwapchainImageCount = surfCaps.maxImageCount;
     }
@@ -210,13 +216,16 @@ RecreateSwapchain(
                 params.Allocator,
                 &params.SwapChain.Handle));
 
-    // If an existing swapchain is re-created, destroy the old swapchain
+    // If an existing swapchain is re-created, hand the old one back to the caller
+    // It is retired now, but frames in flight may still be using its images
+    retired.Handle = oldSwapchain;
+    retired.Views.clear();
+    retired.RenderingFinished.clear();
     if (oldSwapchain != VK_NULL_HANDLE) {
         for (uint32_t i = 0; i < params.SwapChain.Images.size(); i++) {
-            vkDestroyImageView(params.Device.Device, params.SwapChain.Images[i].View, params.Allocator);
+            retired.Views.push_back(params.SwapChain.Images[i].View);
         }
-
-        vkDestroySwapchainKHR(params.Device.Device, oldSwapchain, params.Allocator);
+        retired.RenderingFinished.swap(params.RenderingFinishedSemaphores);
     }
 
     uint32_t imageCount = 0;
@@ -250,4 +259,30 @@ RecreateSwapchain(
         VK_CHECK(vkCreateImageView(params.Device.Device, &colorAttachmentView, params.Allocator, &params.SwapChain.Images[i].View));
     }
 
+    // A present waits on the semaphore of the image it shows. The frame fence only says the
+    // submit is done, not that the present has consumed the semaphore, but an image is only
+    // acquired again after its last present, so one per image is never signaled while waited on
+    VkSemaphoreCreateInfo semInfo = {};
+    semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    params.RenderingFinishedSemaphores.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VK_CHECK(vkCreateSemaphore(params.Device.Device, &semInfo, params.Allocator, &params.RenderingFinishedSemaphores[i]));
+    }
+
+    return true;
+}
+
+void
+DestroyRetiredSwapchain(VKCommonParameters &params, RetiredSwapchain& retired) {
+    for (size_t i = 0; i < retired.Views.size(); i++) {
+        vkDestroyImageView(params.Device.Device, retired.Views[i], params.Allocator);
+    }
+    for (size_t i = 0; i < retired.RenderingFinished.size(); i++) {
+        vkDestroySemaphore(params.Device.Device, retired.RenderingFinished[i], params.Allocator);
+    }
+    if (retired.Handle != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(params.Device.Device, retired.Handle, params.Allocator);
+    }
+
+    retired = {};
 }
@@ -4,11 +4,29 @@
 
 // TODO: split this into multiple functions
 
-// Recreate the swapchain
-void RecreateSwapchain(
+// Resources of a swapchain that has been replaced
+// Frames that are still in flight may reference them, so they are destroyed
+// later, once the frame RetireFrame has been reached
+struct RetiredSwapchain {
+    VkSwapchainKHR Handle = VK_NULL_HANDLE;
+    std::vector<VkImageView> Views;
+    std::vector<VkSemaphore> RenderingFinished; // presents to the old images may still wait on these
+    uint64_t RetireFrame = 0;
+};
+
+// Create the swapchain, or recreate it if one already exists
+// The current swapchain is passed as oldSwapchain and handed back in retired along
+// with its image views and rendering finished semaphores instead of being destroyed
+// presentMode is used if the surface supports it, otherwise the closest supported mode is
+// (FIFO is always supported)
+// Returns false if the surface has no area (ie the window is minimized)
+bool RecreateSwapchain(
         VKCommonParameters &params, 
         uint32_t* w, 
         uint32_t *h, 
-        bool vsync,
-        uint32_t& commandBufferCount // TODO: get rid of this?
+        VkPresentModeKHR presentMode,
+        RetiredSwapchain& retired
 ); 
+
+// Destroy the resources of a replaced swapchain
+void DestroyRetiredSwapchain(VKCommonParameters &params, RetiredSwapchain& retired);
@@ -22,9 +22,68 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Memory budget for geometry that is no longer referenced but kept around for reuse
+#define MODEL_CACHE_BUDGET (64ull * 1024 * 1024)
+
+// Specialization constant ids used by shaders/frag/test.frag
+#define SPEC_CONSTANT_GRAYSCALE 0
+
+// Sets in the first pool of each frame's descriptor allocator
+#define FRAME_DESCRIPTOR_SETS 64u
+
+// Size of the bindless arrays (clamped to the device limits)
+#define BINDLESS_MAX_IMAGES 16384u
+#define BINDLESS_MAX_STORAGE_BUFFERS 4096u
+
+// Draws the render queue has room for before it has to grow
+#define RENDER_QUEUE_RESERVE 4096u
+
+// Descriptor set indices in the pipeline layout
+#define DESCRIPTOR_SET_FRAME 0
+#define DESCRIPTOR_SET_BINDLESS 1
+
+// Blend two world matrices, translation and scale linearly and rotation along the shortest arc
+// Blending the matrices themselves would shrink a model that turns between the two. Shear
+// (from non uniform scale up the hierarchy) is not kept while in between
+static glm::mat4
+_interpolate_world(const glm::mat4& previous, const glm::mat4& world, float alpha) {
+    if (alpha >= 1.0f || previous == world)
+        return world;
+
+    const glm::mat4* ends[2] = { &previous, &world };
+    glm::vec3 scales[2];
+    glm::quat rotations[2];
+    for (int i = 0; i < 2; i++) {
+        glm::mat3 basis(*ends[i]);
+        scales[i] = glm::vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+        // Mirrored or flattened bases have no rotation to take apart
+        if (scales[i].x == 0.0f || scales[i].y == 0.0f || scales[i].z == 0.0f || glm::determinant(basis) <= 0.0f)
+            return previous + (world - previous) * alpha;
+
+        basis[0] /= scales[i].x;
+        basis[1] /= scales[i].y;
+        basis[2] /= scales[i].z;
+        rotations[i] = glm::quat_cast(basis);
+    }
+
+    glm::vec3 scale = glm::mix(scales[0], scales[1], alpha);
+    glm::mat4 result = glm::mat4_cast(glm::slerp(rotations[0], rotations[1], alpha));
+    result[0] *= scale.x;
+    result[1] *= scale.y;
+    result[2] *= scale.z;
+    result[3] = glm::mix(previous[3], world[3], alpha);
+    return result;
+}
 
 // Constructor for the renderer 
 VKBackend::VKBackend()
+    : m_modelCache(nullptr, [](VKModel& model) { model.Destroy(); }, MODEL_CACHE_BUDGET),
+    m_pipelines(m_vkparams),
+    m_descriptorCache(m_vkparams),
+    m_bindless(m_vkparams),
+    m_vkgraph(m_vkparams, VKBackend::MAX_FRAMES_IN_FLIGHT)
 {
 }
 
@@ -32,6 +91,7 @@ VKBackend::VKBackend()
 void
 VKBackend::Initialize(std::string name, std::string assetPath, uint32_t width, uint32_t height, RendererSettings settings) {
     m_settings = settings;
+    SetMaxQueuedFrames(settings.max_queued_frames);
     m_title = name;
     m_assetPath = assetPath;
     m_width = width;
@@ -60,90 +120,156 @@ VKBackend::GetDeviceName() {
 
 
 // Resize behavior
+// The swapchain is not rebuilt here. It is flagged and rebuilt once at the start of
+// the next frame, so any number of resizes between two frames cost a single rebuild
 void
 VKBackend::WindowResize(uint32_t w, uint32_t h) {
     if (!m_initialized)
         return;
-    
-    m_initialized = false;
-    // Ensure all operations on GPU are done before destroying resources
-    vkDeviceWaitIdle(m_vkparams.Device.Device);
-
 
-
-    // Recreate swapchain
     m_width = w;
     m_height = h;
-    CreateSwapchain(&m_width, &m_height, false);
+    m_swapchain_dirty = true;
+}
 
-    // Recreate the framebuffers
-    for (size_t i = 0; i < m_vkparams.Framebuffers.size(); i++) {
-        vkDestroyFramebuffer(
-                m_vkparams.Device.Device,
-                m_vkparams.Framebuffers[i],
-                m_vkparams.Allocator);
-    }
-    CreateFrameBuffers();
+void
+VKBackend::SetPresentMode(PresentMode mode) {
+    if (m_settings.present_mode == mode)
+        return;
 
-    // Command buffers need to be recreated as they may store
-    // references to the recreated framebuffer
-    vkFreeCommandBuffers(
-            m_vkparams.Device.Device,
-            m_vkparams.GraphicsCommandPool,
-            static_cast<uint32_t>(m_vkparams.GraphicsCommandBuffers.size()),
-            m_vkparams.GraphicsCommandBuffers.data());
+    m_settings.present_mode = mode;
+    if (m_initialized)
+        m_swapchain_dirty = true;
+}
 
-    AllocateCommandBuffers();
+void
+VKBackend::SetMaxQueuedFrames(uint32_t count) {
+    m_settings.max_queued_frames = std::max(1u, std::min(count, static_cast<uint32_t>(VKBackend::MAX_FRAMES_IN_FLIGHT)));
+}
 
-    vkDeviceWaitIdle(m_vkparams.Device.Device);
-    m_initialized = true;
+// Rebuild the swapchain
+// The old swapchain is passed to the new one, and it is destroyed along with its
+// views once every frame that could still be using them has retired,
+// so this never has to wait for the GPU to go idle. Command buffers do not hold on
+// to the swapchain between frames, so they are kept as they are
+bool
+VKBackend::RebuildSwapchain() {
+    if (m_width == 0 || m_height == 0)
+        return false;
+
+    RetiredSwapchain retired = {};
+    if (!CreateSwapchain(&m_width, &m_height, m_settings.present_mode, retired))
+        return false;
+
+    // Frames before this one may still reference the old swapchain. The fence for the last
+    // of them has been waited on by the time MAX_FRAMES_IN_FLIGHT more frames have started
+    retired.RetireFrame = m_frame_number + MAX_FRAMES_IN_FLIGHT;
+    m_retired_swapchains.push_back(retired);
+
+    m_swapchain_dirty = false;
+    return true;
+}
+
+// Destroy retired swapchains that are no longer used by any frame in flight
+// Pass all = true to destroy every one of them (the device must be idle)
+void
+VKBackend::ReleaseRetiredSwapchains(bool all) {
+    while (!m_retired_swapchains.empty()
+            && (all || m_retired_swapchains.front().RetireFrame <= m_frame_number)) {
+        DestroyRetiredSwapchain(m_vkparams, m_retired_swapchains.front());
+        m_retired_swapchains.pop_front();
+    }
 }
 
 VkResult
 VKBackend::AcquireNextImage(uint32_t* imageIndex) {
-    // TODO: wait for fences
     return vkAcquireNextImageKHR( // acquires the next image in the swapchain
             m_vkparams.Device.Device, 
             m_vkparams.SwapChain.Handle, 
             UINT64_MAX,
-            m_vkparams.ImageAvailableSemaphore,
+            m_vkparams.ImageAvailableSemaphores[m_current_frame_index],
             VK_NULL_HANDLE,
             imageIndex);
 }
 
-void
+bool
 VKBackend::BeginFrame() {
+    // Wait for the GPU to finish the last frame that used this slot
+    // After this its command buffer, semaphores and uniform buffer can be reused
+    // When fewer queued frames are allowed than there are slots, also wait for the frame that
+    // was submitted max_queued_frames ago, so the CPU cannot run further ahead of the GPU
+    // (and the input that went into this frame is not shown any later) than that
+    std::array<VkFence, 2> fences = { m_vkparams.FrameFences[m_current_frame_index], VK_NULL_HANDLE };
+    uint32_t fenceCount = 1;
+    if (m_settings.max_queued_frames < VKBackend::MAX_FRAMES_IN_FLIGHT) {
+        uint32_t slot = (m_current_frame_index + VKBackend::MAX_FRAMES_IN_FLIGHT - m_settings.max_queued_frames) % VKBackend::MAX_FRAMES_IN_FLIGHT;
+        fences[fenceCount++] = m_vkparams.FrameFences[slot];
+    }
+    VK_CHECK(vkWaitForFences(
+                m_vkparams.Device.Device,
+                fenceCount,
+                fences.data(),
+                VK_TRUE,
+                UINT64_MAX));
+
+    // Everything allocated for the last frame in this slot can be recycled now
+    m_frameDescriptors[m_current_frame_index]->Reset();
+    m_bindless.ReleaseRetired(m_frame_number);
+    ReleaseRetiredModels();
+
+    // Framebuffers are released before the swapchain views they point at
+    m_vkgraph.ReleaseUnused(m_frame_number);
+    ReleaseRetiredSwapchains(false);
+
+    if (m_swapchain_dirty && !RebuildSwapchain())
+        return false;
+
     // Get the index of the next available image in the swapchain
-    VkResult acquire = AcquireNextImage(&m_current_frame_index);
+    VkResult acquire = AcquireNextImage(&m_image_index);
+    if (acquire == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Rebuild right away and try again so that the resize does not cost this frame
+        if (!RebuildSwapchain())
+            return false;
+        acquire = AcquireNextImage(&m_image_index);
+    }
+
     if (!((acquire == VK_SUCCESS) || (acquire == VK_SUBOPTIMAL_KHR))) {
-        if (acquire == VK_ERROR_OUT_OF_DATE_KHR)
-            WindowResize(m_width, m_height);
-        else
+        if (acquire != VK_ERROR_OUT_OF_DATE_KHR)
             VK_CHECK(acquire);
+        m_swapchain_dirty = true;
+        return false;
     }
 
-    // PopulateCommandBuffer(m_command_buffer_index, m_current_frame_index);
+    // A suboptimal swapchain can still be presented to, rebuild it next frame
+    if (acquire == VK_SUBOPTIMAL_KHR)
+        m_swapchain_dirty = true;
+
+    // Only reset the fence once we know this frame will be submitted,
+    // otherwise the next wait on it would never return
+    VK_CHECK(vkResetFences(m_vkparams.Device.Device, 1, &m_vkparams.FrameFences[m_current_frame_index]));
+    return true;
 }
 
 void
 VKBackend::EndFrame(RenderPacket packet) {
-    PopulateCommandBuffer(m_command_buffer_index, m_current_frame_index);
-    SubmitCommandBuffer(m_command_buffer_index);
-    PresentImage(m_current_frame_index);
-
-    // Wait for the GPU to complete the frame before continuing is best practice
-    // vkQueueWaitIdle is used for simplicity
-    // (so that we can reuse the command buffer indexed with m_command_buffer_index)
-    // THIS IS SUBOPTIMAL because we are waiting on GPU to complete 1 image at a time 
-    // before the CPU creates anther. We can use a fence or semaphores later on
-    // to do better synchronization, but for now this works fine
-    VK_CHECK(vkQueueWaitIdle(m_vkparams.GraphicsQueue.Handle)); // "wait for GPU to idle"
-
-    // Update the command buffer
-    m_command_buffer_index = (m_command_buffer_index + 1) % m_command_buffer_count;
-   
-    // Update the uniform buffer
+    // The fence for this slot was waited on in BeginFrame, so nothing on the GPU is reading its uniform buffer
     m_uboBuffers[m_current_frame_index]->WriteToBuffer(&packet.ubo);
+    // Simulation runs at a fixed step, so draw each model where it is between the last two
+    for (size_t i = 0; i < packet.transforms.size(); i++) {
+        const DrawTransform& transform = packet.transforms[i];
+        if (DrawItem* draw = m_draws.Get(transform.model))
+            draw->world = _interpolate_world(transform.previous, transform.world, packet.alpha);
+    }
+
+    BuildRenderQueue(packet.ubo.projectionView);
+    PopulateCommandBuffer(m_current_frame_index, m_image_index);
+    LatchCamera(packet);
+    SubmitCommandBuffer(m_current_frame_index, m_image_index);
+    PresentImage(m_image_index);
+
+    // Move on to the next frame in flight
+    // The CPU only waits for the GPU when it comes back around to a slot that is still in use
+    m_frame_number++;
     m_current_frame_index = (m_current_frame_index + 1) % VKBackend::MAX_FRAMES_IN_FLIGHT;
 }
 
@@ -154,27 +280,34 @@ VKBackend::PopulateCommandBuffer(uint64_t bufferIndex, uint64_t imgIndex) {
     beginInfo.pNext = nullptr;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    // We use a single color attachment that is cleared at the start of the sub pass
-    VkClearValue clearValues[1];
-    clearValues[0].color = {
-        {0.0f, 0.2f, 0.4f, 1.0f},
-    };
-
-    VkRenderPassBeginInfo beginRenderpassInfo = {};
-    beginRenderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    beginRenderpassInfo.pNext = nullptr;
-    // set the render area that is affected by the render pass instance
-    beginRenderpassInfo.renderArea.offset.x = 0;
-    beginRenderpassInfo.renderArea.offset.y = 0;
-    beginRenderpassInfo.renderArea.extent.width = m_width;
-    beginRenderpassInfo.renderArea.extent.height = m_height;
-    // Set clear values for all framebuffer attachments with loadOp set to clear
-    beginRenderpassInfo.clearValueCount = 1;
-    beginRenderpassInfo.pClearValues = clearValues;
-    // Set the renderpass object used to begin an instance of
-    beginRenderpassInfo.renderPass = m_vkparams.RenderPass;
-    // Set the framebuffer to specify the color attachment (render target) where to draw the current frame
-    beginRenderpassInfo.framebuffer = m_vkparams.Framebuffers[imgIndex];
+    // The frame is described as a render graph and rebuilt every frame
+    // The graph works out the barriers and layout transitions between passes, and its
+    // render passes and framebuffers are cached by the Vulkan side, so this is cheap
+    m_graph.Reset();
+
+    // The swapchain image comes from the presentation engine and goes back to it
+    // Its old contents are never needed, so the first transition discards them
+    RGResourceDesc backbufferDesc = {};
+    backbufferDesc.type = RG_RESOURCE_IMAGE;
+    backbufferDesc.width = m_width;
+    backbufferDesc.height = m_height;
+    backbufferDesc.format = VKRenderGraph::FromVkFormat(m_vkparams.SwapChain.Format);
+    RGHandle backbuffer = m_graph.ImportImage("backbuffer", backbufferDesc, RG_ACCESS_PRESENT, RG_ACCESS_PRESENT, true);
+
+    // Forward pass that draws every model straight into the swapchain image
+    const float clearColor[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
+    uint32_t forward = m_graph.AddPass("forward", [this](RGPassContext&) {
+        RecordForwardPass();
+    });
+    m_graph.Write(forward, backbuffer, RG_ACCESS_COLOR_ATTACHMENT, RG_LOAD_OP_CLEAR, clearColor);
+
+    m_vkgraph.SetImportedImage(
+            backbuffer,
+            m_vkparams.SwapChain.Images[imgIndex].Handle,
+            m_vkparams.SwapChain.Images[imgIndex].View,
+            m_vkparams.SwapChain.Format);
+    if (!m_vkgraph.Compile(m_graph, m_frame_number))
+        throw std::runtime_error("Failed to compile the render graph");
 
     // Puts the command buffer into a recording state
     // ONE_TIME_SUBMIT means each recording of the command buffer will
@@ -183,19 +316,85 @@ VKBackend::PopulateCommandBuffer(uint64_t bufferIndex, uint64_t imgIndex) {
     VK_CHECK(vkBeginCommandBuffer(
                 m_vkparams.GraphicsCommandBuffers[bufferIndex],
                 &beginInfo));
+    m_encoder.Begin(m_vkparams.GraphicsCommandBuffers[bufferIndex]);
+    m_encoder.ResetStats();
+
+    // Records the barriers, render passes and passes of the graph
+    // The swapchain image is left in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting
+    // Barriers and render passes do not change what is bound, so the encoder's state stays valid
+    m_vkgraph.Execute(m_graph, m_vkparams.GraphicsCommandBuffers[bufferIndex]);
+    m_encoderStats = m_encoder.GetStats();
+
+    VK_CHECK(vkEndCommandBuffer(m_vkparams.GraphicsCommandBuffers[bufferIndex]));
+}
+
+// Sample the camera again now that the frame is recorded
+// The command buffer only references the uniform buffer, so the new matrices are picked up
+// without recording anything again. The buffer is persistently mapped and host coherent, and
+// the GPU cannot start on this frame before the submit, so a plain write is all it takes
+void
+VKBackend::LatchCamera(const RenderPacket& packet) {
+    std::chrono::steady_clock::time_point sampleTime = packet.sampleTime;
+    if (m_lateLatch) {
+        UBO ubo = packet.ubo;
+        if (m_lateLatch(packet, ubo, sampleTime)) {
+            m_uboBuffers[m_current_frame_index]->WriteToBuffer(&ubo);
+            m_latency.latchedFrames++;
+        }
+    }
+
+    // Packets without a sample time are not measured
+    if (packet.sampleTime == std::chrono::steady_clock::time_point())
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    m_latency.inputToSubmit = std::chrono::duration<double>(now - sampleTime).count();
+    m_latency.packetToSubmit = std::chrono::duration<double>(now - packet.sampleTime).count();
+    m_latency.averageInputToSubmit = (m_latency.averageInputToSubmit == 0.0)
+        ? m_latency.inputToSubmit
+        : m_latency.averageInputToSubmit * 0.9 + m_latency.inputToSubmit * 0.1;
+}
 
-    // Begin the render pass instance
-    // This will clear the color attachment
-    // The render pass provides the actual image views for the attachment descriptors
-    // After beginnign the render pass, command buffers are ready to record the commands
-    // for the first subpass of that render pass.
-    // The application can record the commands one subpass at a time (if the render pass
-    // is composed of multiple subpasses) before ending the render pass instance.
-    vkCmdBeginRenderPass(
-            m_vkparams.GraphicsCommandBuffers[bufferIndex],
-            &beginRenderpassInfo,
-            VK_SUBPASS_CONTENTS_INLINE);
+// Give every draw in the draw list a sort key and sort them
+// Depth is the normalized device depth of the model's center, so opaque draws go front to
+// back and transparent ones back to front
+// Pipelines are looked up once per frame here, and only again when the key changes, since
+// the cache takes its lock on every lookup. Draws without a pipeline yet are skipped
+void
+VKBackend::BuildRenderQueue(const glm::mat4& projectionView) {
+    m_renderQueue.Clear();
+    m_drawPipelines.resize(m_draws.Size());
+
+    uint64_t lastKey = 0;
+    VKPipeline* lastPipeline = nullptr;
+    for (size_t i = 0; i < m_draws.Size(); i++) {
+        const DrawItem& draw = m_draws[i];
+        VKModel* model = m_modelCache.Get(draw.model);
+        if (!model)
+            continue;
+
+        if (!lastPipeline || draw.pipeline != lastKey) {
+            lastKey = draw.pipeline;
+            lastPipeline = m_pipelines.Get(draw.pipeline);
+        }
+        if (!lastPipeline)
+            continue;
+        m_drawPipelines[i] = lastPipeline;
+
+        glm::vec4 clip = projectionView * (draw.world * glm::vec4(model->GetCenter(), 1.0f));
+        float depth = (clip.w > 0.0f) ? (clip.z / clip.w) : 0.0f;
+        m_renderQueue.Push(
+                RenderQueue::MakeKey(draw.layer, draw.pipeline, 0, draw.model.id, depth),
+                static_cast<uint32_t>(i));
+    }
+    m_renderQueue.Sort();
+}
 
+// Draw the models of the scene
+// Called by the render graph inside of the forward pass's render pass
+// Draws that share a pipeline or model only bind it once, the encoder filters the repeats
+void
+VKBackend::RecordForwardPass() {
     // Update the dynamic viewport state
     // Defines rectangular area withing the framebuffer that rendering operations
     // will be mapped to.
@@ -204,11 +403,7 @@ VKBackend::PopulateCommandBuffer(uint64_t bufferIndex, uint64_t imgIndex) {
     viewport.width = static_cast<float>(m_width);
     viewport.minDepth = static_cast<float>(0.0f);
     viewport.maxDepth = static_cast<float>(1.0f);
-    vkCmdSetViewport(
-            m_vkparams.GraphicsCommandBuffers[bufferIndex],
-            0,
-            1,
-            &viewport);
+    m_encoder.SetViewport(viewport);
 
     // Update dynaic scissor state
     // Scissor defines a rectangular area withing the framebuffer where rendering
@@ -218,33 +413,47 @@ VKBackend::PopulateCommandBuffer(uint64_t bufferIndex, uint64_t imgIndex) {
     scissor.extent.height = m_height;
     scissor.offset.x = 0;
     scissor.offset.y = 0;
-    vkCmdSetScissor(
-            m_vkparams.GraphicsCommandBuffers[bufferIndex],
-            0,
-            1,
-            &scissor);
-
-    // Bind the graphics pipeline
-    m_pipeline->Bind(m_vkparams.GraphicsCommandBuffers[bufferIndex]);
+    m_encoder.SetScissor(scissor);
 
-
-    // Bind the triangle vertex buffer (contains position and color)
-    for (size_t i = 0; i < m_models.size(); i++) {
-        m_models[i]->Bind(m_vkparams.GraphicsCommandBuffers[bufferIndex]);
-        m_models[i]->Draw(m_vkparams.GraphicsCommandBuffers[bufferIndex], m_current_frame_index);
+    // Descriptors are bound once for the whole frame, draws only push their indices
+    m_encoder.BindDescriptorSets(
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_vkparams.PipelineLayout,
+            DESCRIPTOR_SET_FRAME,
+            1,
+            &m_vkparams.DescriptorSets[m_current_frame_index]);
+    if (m_bindless.IsEnabled())
+        m_bindless.Bind(m_encoder, m_vkparams.PipelineLayout, DESCRIPTOR_SET_BINDLESS);
+
+    // Draw in the order of the render queue
+    // Draws that share a pipeline and model are next to each other, so the encoder
+    // drops most of the binds between them
+    const std::vector<RenderItem>& items = m_renderQueue.GetItems();
+    for (size_t i = 0; i < items.size(); i++) {
+        const DrawItem& draw = m_draws[items[i].index];
+        VKModel* model = m_modelCache.Get(draw.model);
+        if (!model)
+            continue;
+
+        m_drawPipelines[items[i].index]->Bind(m_encoder);
+
+        VKDrawConstants constants = {};
+        constants.instanceIndex = items[i].index;
+        constants.model = draw.world;
+        m_encoder.PushConstants(
+                m_vkparams.PipelineLayout,
+                VK_SHADER_STAGE_ALL_GRAPHICS,
+                0,
+                sizeof(constants),
+                &constants);
+
+        model->Bind(m_encoder);
+        model->Draw(m_encoder);
     }
-    // m_model->Bind(m_vkparams.GraphicsCommandBuffers[bufferIndex]);
-    // m_model->Draw(m_vkparams.GraphicsCommandBuffers[bufferIndex], m_current_frame_index);
-
-    // Ending the render pass will add an implicit barrier, transitioning the frame buffer
-    // color attachment to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
-    vkCmdEndRenderPass(m_vkparams.GraphicsCommandBuffers[bufferIndex]);
-
-    VK_CHECK(vkEndCommandBuffer(m_vkparams.GraphicsCommandBuffers[bufferIndex]));
 }
 
 void
-VKBackend::SubmitCommandBuffer(uint64_t index) {
+VKBackend::SubmitCommandBuffer(uint64_t index, uint32_t imageIndex) {
     // Pipeline stage at which the queue submission will wait (via a semaphore)
     VkPipelineStageFlags waitStateMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -257,14 +466,15 @@ VKBackend::SubmitCommandBuffer(uint64_t index) {
     submitInfo.pCommandBuffers = &m_vkparams.GraphicsCommandBuffers[index]; // command buffers(s) to execute in this batch (submission)
     submitInfo.commandBufferCount = 1;                                      // one command buffer
 
-    submitInfo.pWaitSemaphores = &m_vkparams.ImageAvailableSemaphore;      // semaphore(s) to wait upon before the submitted command buffers begin executing
-    submitInfo.pSignalSemaphores = &m_vkparams.RenderingFinishedSemaphore; // semaphore(s) to signal when command buffers have been completed
+    submitInfo.pWaitSemaphores = &m_vkparams.ImageAvailableSemaphores[index];      // semaphore(s) to wait upon before the submitted command buffers begin executing
+    submitInfo.pSignalSemaphores = &m_vkparams.RenderingFinishedSemaphores[imageIndex]; // semaphore(s) to signal when command buffers have been completed
 
+    // The frame fence is signaled once the command buffer has completed
     VK_CHECK(vkQueueSubmit(
                 m_vkparams.GraphicsQueue.Handle,
                 1,
                 &submitInfo,
-                VK_NULL_HANDLE));
+                m_vkparams.FrameFences[index]));
 }
 
 void
@@ -279,16 +489,15 @@ VKBackend::PresentImage(uint32_t index) {
     presentInfo.pSwapchains = &m_vkparams.SwapChain.Handle;
     presentInfo.pImageIndices = &index;
 
-    // Check if a wait semaphore has been specified to wait for before presenting the image
-    if (m_vkparams.RenderingFinishedSemaphore != VK_NULL_HANDLE) {
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &m_vkparams.RenderingFinishedSemaphore;
-    }
+    // Wait for the frame's rendering to finish before presenting the image
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &m_vkparams.RenderingFinishedSemaphores[index];
 
+    // The swapchain no longer matches the surface, rebuild it at the start of the next frame
     VkResult present = vkQueuePresentKHR(m_vkparams.GraphicsQueue.Handle, &presentInfo);
-    if (!((present == VK_SUCCESS) || (present == VK_SUBOPTIMAL_KHR))) {
-        if (present == VK_ERROR_OUT_OF_DATE_KHR)
-            WindowResize(m_width, m_height);
+    if (!(present == VK_SUCCESS)) {
+        if (present == VK_ERROR_OUT_OF_DATE_KHR || present == VK_SUBOPTIMAL_KHR)
+            m_swapchain_dirty = true;
         else 
             VK_CHECK(present)
     }
@@ -306,9 +515,9 @@ VKBackend::OnDestroy() {
 
     // Destroy vertex buffer object and deallocate backing memory
     std::cout << "Destroying vertex buffer and memory...";
-    for (size_t i = 0; i < m_models.size(); i++) {
-        m_models[i]->Destroy();
-    }
+    m_draws.Clear();
+    m_retiredModels.clear();
+    m_modelCache.Clear();
     std::cout << "destroyed & freed" << std::endl;
     
     std::cout << "Destroying Uniform Buffers... ";
@@ -320,17 +529,16 @@ VKBackend::OnDestroy() {
 
     // Destroy pipeline layout and pipeline layout objects
     std::cout << "Destroying pipeline layout and graphics pipeline...";
-    m_pipeline->Destroy();
+    m_pipelines.Destroy();
+    vkDestroyPipelineLayout(m_vkparams.Device.Device, m_vkparams.PipelineLayout, m_vkparams.Allocator);
     std::cout << "destroyed" << std::endl;
 
-    std::cout << "Destroying Framebuffers... ";
-    // Destroy frame buffers
-    for (size_t i = 0; i < m_vkparams.Framebuffers.size(); i++) {
-        vkDestroyFramebuffer(
-                m_vkparams.Device.Device,
-                m_vkparams.Framebuffers[i],
-                m_vkparams.Allocator);
-    }
+    std::cout << "Destroying Render Graph... ";
+    m_vkgraph.Destroy();
+    std::cout << "destroyed" << std::endl;
+
+    std::cout << "Destroying Retired Swapchains... ";
+    ReleaseRetiredSwapchains(true);
     std::cout << "destroyed" << std::endl;
 
     std::cout << "Destroying Swapchain Images... ";
@@ -340,6 +548,10 @@ VKBackend::OnDestroy() {
                 m_vkparams.Device.Device,
                 m_vkparams.SwapChain.Images[i].View,
                 m_vkparams.Allocator);
+        vkDestroySemaphore(
+                m_vkparams.Device.Device,
+                m_vkparams.RenderingFinishedSemaphores[i],
+                m_vkparams.Allocator);
     }
     std::cout << "destroyed" << std::endl;
 
@@ -351,11 +563,13 @@ VKBackend::OnDestroy() {
     std::cout << "destroyed" << std::endl;
 
 
-    std::cout << "Destroying Descriptor Pool... ";
-    vkDestroyDescriptorPool(
-            m_vkparams.Device.Device, 
-            m_vkparams.DescriptorPool,
-            m_vkparams.Allocator);
+    std::cout << "Destroying Descriptor Pools... ";
+    m_descriptorCache.Destroy();
+    for (size_t i = 0; i < m_frameDescriptors.size(); i++) {
+        m_frameDescriptors[i]->Destroy();
+    }
+    m_frameDescriptors.clear();
+    m_bindless.Destroy();
     std::cout << "destroyed" << std::endl;
 
     std::cout << "Destroying Descriptor Set Layout... ";
@@ -383,16 +597,18 @@ VKBackend::OnDestroy() {
             m_vkparams.Allocator);
     std::cout << "destroyed" << std::endl;
 
-    // Destroy semaphores
-    std::cout << "Destroying Semaphores... ";
-    vkDestroySemaphore(
-            m_vkparams.Device.Device,
-            m_vkparams.ImageAvailableSemaphore,
-            m_vkparams.Allocator);
-    vkDestroySemaphore(
-            m_vkparams.Device.Device,
-            m_vkparams.RenderingFinishedSemaphore,
-            m_vkparams.Allocator);
+    // Destroy semaphores and fences
+    std::cout << "Destroying Semaphores and Fences... ";
+    for (size_t i = 0; i < m_vkparams.FrameFences.size(); i++) {
+        vkDestroySemaphore(
+                m_vkparams.Device.Device,
+                m_vkparams.ImageAvailableSemaphores[i],
+                m_vkparams.Allocator);
+        vkDestroyFence(
+                m_vkparams.Device.Device,
+                m_vkparams.FrameFences[i],
+                m_vkparams.Allocator);
+    }
     std::cout << "destroyed" << std::endl;
 
     // Destroy command pool
@@ -439,9 +655,9 @@ VKBackend::InitVulkan() {
             m_vkparams.Device.Device, 
             m_vkparams.GraphicsQueue.FamilyIndex, 
             m_vkparams.GraphicsQueue.Handle);
-    CreateSwapchain(&m_width, &m_height, m_settings.enable_vsync);
+    RetiredSwapchain none = {};
+    CreateSwapchain(&m_width, &m_height, m_settings.present_mode, none);
     CreateRenderPass();
-    CreateFrameBuffers();
     AllocateCommandBuffers();
     // CreateDepthResources();
     CreateSyncObjects();
@@ -449,6 +665,9 @@ VKBackend::InitVulkan() {
     CreateUniformBuffer();
     CreateDescriptorPool();
     CreateDescriptorSets();
+
+    if (m_settings.enable_bindless && !m_bindless.Initialize(BINDLESS_MAX_IMAGES, BINDLESS_MAX_STORAGE_BUFFERS))
+        std::cout << "Bindless resources not supported, using descriptor sets" << std::endl;
 }
 
 void
@@ -460,11 +679,40 @@ VKBackend::SetupPipeline() {
     std::cout << "PIPELINE SETUP\n";
 }
 
+// Add a model to the draw list
+// Geometry that has already been uploaded is reused instead of creating another GPU copy
+// Models are drawn with the default pipeline
+ModelHandle
+VKBackend::AddModel(Builder builder, RenderLayer layer) {
+    AssetHandle<VKModel> handle = m_modelCache.FindOrCreate(builder.Hash(), [&](size_t& bytes) {
+        bytes = builder.vertices.size() * sizeof(Vertex) + builder.indices.size() * sizeof(uint32_t);
+        return std::make_unique<VKModel>(m_vkparams, builder);
+    });
+    DrawItem draw = {};
+    draw.model = handle;
+    draw.pipeline = m_defaultPipeline;
+    draw.layer = layer;
+    draw.world = glm::mat4(1.0f);
+    return m_draws.Insert(draw);
+}
+
 void
-VKBackend::AddModel(Builder builder) {
-    m_models.push_back(std::make_unique<VKModel>(m_vkparams, builder));
+VKBackend::RemoveModel(ModelHandle handle) {
+    DrawItem* draw = m_draws.Get(handle);
+    if (!draw)
+        return;
 
-    return;
+    m_retiredModels.push_back({ draw->model, m_frame_number + MAX_FRAMES_IN_FLIGHT });
+    m_draws.Remove(handle);
+}
+
+// Drop the cache references of removed models that no frame in flight draws anymore
+void
+VKBackend::ReleaseRetiredModels() {
+    while (!m_retiredModels.empty() && m_retiredModels.front().retireFrame <= m_frame_number) {
+        m_modelCache.Release(m_retiredModels.front().model);
+        m_retiredModels.pop_front();
+    }
 }
 
 void 
@@ -487,60 +735,49 @@ VKBackend::CreateDescriptorSetLayout() {
     );
 }
 
+// The uniform buffer of each frame slot never changes, so its set comes from the cache
 void
 VKBackend::CreateDescriptorSets() {
-    std::vector <VkDescriptorSetLayout> layouts(VKBackend::MAX_FRAMES_IN_FLIGHT, m_vkparams.DescriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_vkparams.DescriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(VKBackend::MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
-
     m_vkparams.DescriptorSets.resize(VKBackend::MAX_FRAMES_IN_FLIGHT);
-    VK_CHECK(vkAllocateDescriptorSets(
-                m_vkparams.Device.Device,
-                &allocInfo,
-                m_vkparams.DescriptorSets.data()));
-
-    for (size_t i = 0; i < layouts.size(); i++) {
-        VkDescriptorBufferInfo bufferInfo = {};
-        bufferInfo.buffer = m_uboBuffers[i]->GetBuffer();
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UBO);
-
-        VkWriteDescriptorSet descriptorWrite = {};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = m_vkparams.DescriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-        descriptorWrite.pImageInfo = nullptr;
-        descriptorWrite.pTexelBufferView = nullptr;
-
-        vkUpdateDescriptorSets(m_vkparams.Device.Device, 1, &descriptorWrite, 0, nullptr);
-        
+    for (size_t i = 0; i < m_vkparams.DescriptorSets.size(); i++) {
+        VKDescriptorBinding ubo = {};
+        ubo.binding = 0;
+        ubo.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        ubo.buffer.buffer = m_uboBuffers[i]->GetBuffer();
+        ubo.buffer.offset = 0;
+        ubo.buffer.range = sizeof(UBO);
+
+        m_vkparams.DescriptorSets[i] = m_descriptorCache.Get(m_vkparams.DescriptorSetLayout, { ubo });
     }
 }
 
+// Create the allocators for sets that only live for one frame
+// They start small and chain more pools as needed, so no pool has to be sized up front
 void
 VKBackend::CreateDescriptorPool() {
-    VkDescriptorPoolSize poolSize = {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(VKBackend::MAX_FRAMES_IN_FLIGHT);
+    m_frameDescriptors.resize(VKBackend::MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < m_frameDescriptors.size(); i++) {
+        m_frameDescriptors[i] = std::make_unique<VKDescriptorAllocator>(
+            m_vkparams,
+            FRAME_DESCRIPTOR_SETS,
+            VKDescriptorAllocator::DefaultRatios());
+    }
+}
 
-    VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(VKBackend::MAX_FRAMES_IN_FLIGHT);
+VkDescriptorSet
+VKBackend::AllocateFrameDescriptorSet(VkDescriptorSetLayout layout) {
+    return m_frameDescriptors[m_current_frame_index]->Allocate(layout);
+}
 
-    VK_CHECK(vkCreateDescriptorPool(
-                m_vkparams.Device.Device,
-                &poolInfo,
-                m_vkparams.Allocator,
-                &m_vkparams.DescriptorPool));
+VKDescriptorStats
+VKBackend::GetDescriptorStats() const {
+    VKDescriptorStats stats = m_descriptorCache.GetStats();
+    for (size_t i = 0; i < m_frameDescriptors.size(); i++) {
+        const VKDescriptorStats& frame = m_frameDescriptors[i]->GetStats();
+        stats.poolCount += frame.poolCount;
+        stats.allocations += frame.allocations;
+    }
+    return stats;
 }
 
 
@@ -581,10 +818,8 @@ VKBackend::CreateVertexBuffer() {
     triangleBuilder.vertices = vertices;
     triangleBuilder.indices = indices;
 
-    std::unique_ptr<VKModel> newmodel = std::make_unique<VKModel>(m_vkparams, triangleBuilder);
-
     // m_model = std::make_unique<VKModel>(m_vkparams, triangleBuilder);
-    m_models.push_back(std::move(newmodel));
+    AddModel(triangleBuilder);
 
 }
 
@@ -594,9 +829,22 @@ VKBackend::CreatePipelineLayout() {
     // Create pipeline layout that will be used to create one or more pipeline objects
     VkPipelineLayoutCreateInfo pPipelineCreateInfo = {};
     pPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    // Set 0 holds the per frame uniforms. With bindless, set 1 holds every texture and storage
+    // buffer, and draws pick theirs with indices in the push constants
+    std::vector<VkDescriptorSetLayout> setLayouts = { m_vkparams.DescriptorSetLayout };
+    if (m_bindless.IsEnabled())
+        setLayouts.push_back(m_bindless.GetLayout());
+
+    VkPushConstantRange pushConstants = {};
+    pushConstants.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(VKDrawConstants);
+
     pPipelineCreateInfo.pNext = nullptr;
-    pPipelineCreateInfo.setLayoutCount = 1;
-    pPipelineCreateInfo.pSetLayouts = &m_vkparams.DescriptorSetLayout;
+    pPipelineCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pPipelineCreateInfo.pSetLayouts = setLayouts.data();
+    pPipelineCreateInfo.pushConstantRangeCount = 1;
+    pPipelineCreateInfo.pPushConstantRanges = &pushConstants;
 
     VK_CHECK(
         vkCreatePipelineLayout(m_vkparams.Device.Device, &pPipelineCreateInfo, m_vkparams.Allocator, &m_vkparams.PipelineLayout));
@@ -604,12 +852,27 @@ VKBackend::CreatePipelineLayout() {
 
 void 
 VKBackend::CreatePipelineObjects() {
-    VKPipelineConfig pipelineConfig = {};
-    m_pipeline = std::make_unique<VKPipeline>(m_vkparams, pipelineConfig);
+    m_pipelines.Initialize();
+
+    // The fallback has to exist before the first frame, so build it right away
+    VKPipelineDesc fallback = {};
+    fallback.vertShader = "shaders/vert/triangle.vert.spv";
+    fallback.fragShader = "shaders/frag/triangle.frag.spv";
+    m_fallbackPipeline = m_pipelines.Build(fallback);
+    m_pipelines.SetFallback(m_fallbackPipeline);
+
+    // Pipelines are keyed by shader code, state and specialization constants, so a variant
+    // whose shaders and config match one that already exists comes straight from the cache
+    VKPipelineDesc desc = {};
+    desc.vertShader = "shaders/vert/triangle.vert.spv";
+    desc.fragShader = "shaders/frag/test.frag.spv";
+    desc.config.fragSpecialization.Set(SPEC_CONSTANT_GRAYSCALE, VK_FALSE);
+    m_defaultPipeline = m_pipelines.Request(desc);
+}
 
-    m_pipeline->CreateGraphicsPipeline(
-            GetAssetsPath()+"/shaders/vert/triangle.vert.spv", 
-            GetAssetsPath()+"/shaders/frag/triangle.frag.spv");
+uint64_t
+VKBackend::RequestPipeline(const VKPipelineDesc& desc) {
+    return m_pipelines.Request(desc);
 }
 
 
@@ -728,13 +991,26 @@ VKBackend::CreateSurface() {
 //       this is also used to recreate the swapchain
 //       for events that require it like 
 //       window resizing
-void
-VKBackend::CreateSwapchain(uint32_t *width, uint32_t *height, bool vsync) {
-    RecreateSwapchain(m_vkparams, width, height, vsync, m_command_buffer_count);
+bool
+VKBackend::CreateSwapchain(uint32_t *width, uint32_t *height, PresentMode mode, RetiredSwapchain& retired) {
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    switch (mode) {
+        case PRESENT_MODE_FIFO:         presentMode = VK_PRESENT_MODE_FIFO_KHR; break;
+        case PRESENT_MODE_FIFO_RELAXED: presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; break;
+        case PRESENT_MODE_MAILBOX:      presentMode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case PRESENT_MODE_IMMEDIATE:    presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+    }
+
+    if (!RecreateSwapchain(m_vkparams, width, height, presentMode, retired))
+        return false;
     std::cout << "Swapchain Created" << std::endl;
+    return true;
 }
 
 // Creata a renderpass object
+// Frames are recorded with the render passes the render graph builds, this one is only
+// what pipelines are created against (render passes with the same attachment formats
+// are compatible, so pipelines built with it can be used in the graph's passes)
 void
 VKBackend::CreateRenderPass() {
     // This will use a single renderpass with one subpass
@@ -876,44 +1152,22 @@ VKBackend::CreateDevice() {
 
 
 
+    // Turn on descriptor indexing for bindless resources if the device has it
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+    const void* featureChain = nullptr;
+    if (m_settings.enable_bindless
+            && QueryDescriptorIndexing(m_vkparams, deviceExtensions, supportedDeviceExtensions, indexingFeatures)) {
+        featureChain = &indexingFeatures;
+    }
+
     // Create the logical device
-    if (CreateLogicalDevice(queueCreateInfos, deviceExtensions, supportedDeviceExtensions, m_vkparams) != VK_SUCCESS) {
+    if (CreateLogicalDevice(queueCreateInfos, deviceExtensions, supportedDeviceExtensions, m_vkparams, featureChain) != VK_SUCCESS) {
         throw std::runtime_error("CreateLogicalDevice() could not create vulkan logical device");
     }
 
     std::cout << "Device created" << std::endl;
 }
 
-// Create a framebuffer to attach color to
-// We need to create one for each image in the swapchain
-void
-VKBackend::CreateFrameBuffers() {
-    VkImageView attachments[1] = {};
-    
-    VkFramebufferCreateInfo createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    createInfo.pNext = nullptr;
-    createInfo.renderPass = m_vkparams.RenderPass;
-    createInfo.attachmentCount = 1;
-    createInfo.pAttachments = attachments;
-    createInfo.width = m_width;
-    createInfo.height = m_height;
-    createInfo.layers = 1;
-
-    // Create a framebuffer for each swapchain image
-    m_vkparams.Framebuffers.resize(m_vkparams.SwapChain.Images.size());
-    for (size_t i = 0; i < m_vkparams.Framebuffers.size(); i++) {
-        attachments[0] = m_vkparams.SwapChain.Images[i].View;
-        VK_CHECK(vkCreateFramebuffer(
-                    m_vkparams.Device.Device,
-                    &createInfo,
-                    m_vkparams.Allocator,
-                    &m_vkparams.Framebuffers[i]));
-    }
-
-    std::cout << "Framebuffers Created: [" << m_vkparams.Framebuffers.size() << "]" << std::endl;
-}
-
 void
 VKBackend::AllocateCommandBuffers() {
     if (!m_vkparams.GraphicsCommandPool) {
@@ -925,8 +1179,9 @@ VKBackend::AllocateCommandBuffers() {
         VK_CHECK(vkCreateCommandPool(m_vkparams.Device.Device, &cmdPoolInfo, m_vkparams.Allocator, &m_vkparams.GraphicsCommandPool));
     }
 
-    // Create one command buffer for each image in the swapchain
-    m_vkparams.GraphicsCommandBuffers.resize(m_command_buffer_count);
+    // Create one command buffer for each frame in flight
+    // They are re-recorded every frame, so they survive swapchain rebuilds
+    m_vkparams.GraphicsCommandBuffers.resize(VKBackend::MAX_FRAMES_IN_FLIGHT);
 
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -946,23 +1201,33 @@ void
 VKBackend::CreateSyncObjects() {
     // Create semaphores to synchronize acquiring presentable images before
     // rendering and waiting for drawing to be completed before presenting
+    // Each frame in flight gets its own, along with a fence the CPU waits on
+    // before reusing the frame's resources
     VkSemaphoreCreateInfo semInfo = {};
     semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semInfo.pNext = nullptr;
 
-    // Return an unsignaled semaphore
-    VK_CHECK(vkCreateSemaphore(
-                m_vkparams.Device.Device,
-                &semInfo,
-                m_vkparams.Allocator,
-                &m_vkparams.ImageAvailableSemaphore));
+    // Fences start signaled so that the first wait on each frame returns right away
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    // Return an unsignaled semaphore
-    VK_CHECK(vkCreateSemaphore(
-                m_vkparams.Device.Device,
-                &semInfo,
-                m_vkparams.Allocator,
-                &m_vkparams.RenderingFinishedSemaphore));
+    m_vkparams.ImageAvailableSemaphores.resize(VKBackend::MAX_FRAMES_IN_FLIGHT);
+    m_vkparams.FrameFences.resize(VKBackend::MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < m_vkparams.FrameFences.size(); i++) {
+        // Return an unsignaled semaphore
+        VK_CHECK(vkCreateSemaphore(
+                    m_vkparams.Device.Device,
+                    &semInfo,
+                    m_vkparams.Allocator,
+                    &m_vkparams.ImageAvailableSemaphores[i]));
+
+        VK_CHECK(vkCreateFence(
+                    m_vkparams.Device.Device,
+                    &fenceInfo,
+                    m_vkparams.Allocator,
+                    &m_vkparams.FrameFences[i]));
+    }
 
     std::cout << "Sync Objects Created" << std::endl;
     
@@ -5,9 +5,17 @@
 #include "platform/platform.hh"
 #include "vkmodel.hh"
 #include "vkpipeline.hh"
+#include "vkpipelinecache.hh"
+#include "vkswapchain.hh"
+#include "vkdescriptors.hh"
+#include "vkbindless.hh"
+#include "vkrendergraph.hh"
+#include "../render_queue.hh"
 #include "../render_types.hh"
+#include "core/asset_manager.hh"
 
 #include <cstdint>
+#include <deque>
 
 // Math lib
 #define GLM_FORCE_RADIANS
@@ -15,10 +23,25 @@
 #include <glm/glm.hpp>
 #include <vulkan/vulkan_core.h>
 
+// How finished frames are handed to the display
+enum PresentMode {
+  PRESENT_MODE_FIFO,         // wait for vblank, never tears. Lowest power use
+  PRESENT_MODE_FIFO_RELAXED, // wait for vblank, but tear instead of waiting a whole refresh when late
+  PRESENT_MODE_MAILBOX,      // newest frame is shown on vblank, older ones are dropped. No tearing
+  PRESENT_MODE_IMMEDIATE,    // show frames as soon as they are done. Tears
+};
+
 // Settings to be passed to the renderer backed
 struct RendererSettings {
   bool enable_validation = false;
-  bool enable_vsync = false;
+  PresentMode present_mode = PRESENT_MODE_FIFO;
+  // Frames the CPU may get ahead of the GPU, between 1 and MAX_FRAMES_IN_FLIGHT
+  // Lower values reduce input latency at the cost of throughput
+  uint32_t max_queued_frames = 2;
+  // Use one bindless descriptor set for textures and storage buffers when the device supports it
+  bool enable_bindless = true;
+  // Record and submit frames on a render thread while the main thread simulates the next one
+  bool render_thread = true;
 };
 
 // Structure for Uniform Buffer Object
@@ -46,6 +69,9 @@ class VKBackend {
         const std::string GetDeviceName();
 
         void WindowResize(uint32_t width, uint32_t height);
+        // Takes effect when the swapchain is rebuilt at the start of the next frame
+        void SetPresentMode(PresentMode mode);
+        void SetMaxQueuedFrames(uint32_t count);
 
         void OnKeyDown(uint8_t) {}
         void OnKeyUp(uint8_t) {}
@@ -65,7 +91,8 @@ class VKBackend {
         void SetHeight(uint32_t height) { m_height = height; }
 
         // Public Interface
-        void BeginFrame();
+        // Returns false if there is no image to render to this frame (ie minimized)
+        bool BeginFrame();
         void EndFrame(RenderPacket packet);
 
         // Static members
@@ -77,7 +104,32 @@ class VKBackend {
 
         void CreateVertexBuffer();
         void CreateUniformBuffer();
-        void AddModel(Builder builder);
+        ModelHandle AddModel(Builder builder, RenderLayer layer = RENDER_LAYER_OPAQUE);
+        // Frames already queued still draw the model, so its geometry is released once they retire
+        void RemoveModel(ModelHandle handle);
+        const AssetCacheStats& GetModelCacheStats() const { return m_modelCache.GetStats(); }
+
+        // Pipelines are built in the background; binding one that is not ready yet uses the fallback
+        uint64_t RequestPipeline(const VKPipelineDesc& desc);
+        VKPipelineCacheStats GetPipelineCacheStats() { return m_pipelines.GetStats(); }
+
+        // Sets that only live for the current frame. They are recycled once the GPU is done with the frame
+        VkDescriptorSet AllocateFrameDescriptorSet(VkDescriptorSetLayout layout);
+        // Sets that never change are shared through the cache
+        VKDescriptorCache& GetDescriptorCache() { return m_descriptorCache; }
+        VKDescriptorStats GetDescriptorStats() const;
+
+        // Textures and storage buffers are addressed by index when bindless is enabled
+        bool IsBindless() const { return m_bindless.IsEnabled(); }
+        VKBindlessHeap& GetBindlessHeap() { return m_bindless; }
+        uint64_t GetFrameNumber() const { return m_frame_number; }
+
+        // The camera is sampled again right before each submit when a late latch is set
+        void SetLateLatch(LateLatchFunc latch) { m_lateLatch = latch; }
+        const LatencyStats& GetLatencyStats() const { return m_latency; }
+
+        // Commands recorded for the last frame, and how many of them were dropped as redundant
+        const VKEncoderStats& GetEncoderStats() const { return m_encoderStats; }
     private:
         void InitVulkan();
         void SetupPipeline();
@@ -85,9 +137,10 @@ class VKBackend {
         void CreateInstance();
         void CreateSurface();
         void CreateDevice();
-        void CreateSwapchain(uint32_t *w, uint32_t *h, bool vsync);
+        bool CreateSwapchain(uint32_t *w, uint32_t *h, PresentMode mode, RetiredSwapchain& retired);
+        bool RebuildSwapchain();
+        void ReleaseRetiredSwapchains(bool all);
         void CreateRenderPass();
-        void CreateFrameBuffers();
         void AllocateCommandBuffers();
         void CreateSyncObjects();
         void CreateDescriptorSetLayout();
@@ -97,7 +150,10 @@ class VKBackend {
         void CreateDepthResources();
 
         void PopulateCommandBuffer(uint64_t bufferIndex, uint64_t imgIndex);
-        void SubmitCommandBuffer(uint64_t index);
+        void BuildRenderQueue(const glm::mat4& projectionView);
+        void RecordForwardPass();
+        void LatchCamera(const RenderPacket& packet);
+        void SubmitCommandBuffer(uint64_t index, uint32_t imageIndex);
         void PresentImage(uint32_t index);
 
         void DestroyInstance();
@@ -108,10 +164,54 @@ class VKBackend {
 
         VkResult AcquireNextImage(uint32_t* imageIndex);
 
+        VKCommonParameters m_vkparams;
+
         std::string m_title;
-        std::vector<std::unique_ptr<VKModel> > m_models;
+        // A model in the draw list and the state it is drawn with
+        struct DrawItem {
+            AssetHandle<VKModel> model;
+            uint64_t pipeline;
+            RenderLayer layer;
+            glm::mat4 world;
+        };
+
+        struct RetiredModel {
+            AssetHandle<VKModel> model;
+            uint64_t retireFrame;
+        };
+
+        void ReleaseRetiredModels();
+
+        // Models are deduplicated by the contents of their geometry
+        // m_draws is the draw list, and may hold the same asset handle more than once
+        // It is sorted into m_renderQueue every frame
+        AssetCache<VKModel> m_modelCache;
+        SlotMap<DrawItem> m_draws;
+        std::deque<RetiredModel> m_retiredModels;
+        RenderQueue m_renderQueue;
+        std::vector<VKPipeline*> m_drawPipelines; // by draw index, resolved when the queue is built
         std::unique_ptr<VKModel> m_model;
-        std::unique_ptr<VKPipeline> m_pipeline;
+        // Pipelines are built on worker threads, the triangle pipeline is built
+        // up front and drawn with until the requested variant is ready
+        VKPipelineCache m_pipelines;
+        uint64_t m_fallbackPipeline = 0;
+        uint64_t m_defaultPipeline = 0;
+
+        // Descriptor sets are never allocated from a fixed size pool
+        VKDescriptorCache m_descriptorCache;
+        std::vector<std::unique_ptr<VKDescriptorAllocator> > m_frameDescriptors; // one per frame in flight
+        VKBindlessHeap m_bindless;
+
+        // The passes of a frame, rebuilt every frame and run by m_vkgraph
+        RenderGraph m_graph;
+        VKRenderGraph m_vkgraph;
+
+        // Draw state goes through the encoder so that redundant binds are dropped
+        VKCommandEncoder m_encoder;
+        VKEncoderStats m_encoderStats;
+
+        LateLatchFunc m_lateLatch;
+        LatencyStats m_latency;
 
 
         // Vertex layout
@@ -135,15 +235,17 @@ class VKBackend {
         RendererSettings m_settings;
 
         bool m_initialized;
-        uint32_t m_current_frame_index = 0;
-        uint32_t m_command_buffer_index = 0;
-        uint32_t m_command_buffer_count = 0;
+        uint32_t m_current_frame_index = 0; // frame in flight slot, selects command buffer, sync objects and UBO
+        uint32_t m_image_index = 0;         // swapchain image acquired for the current frame
+        uint64_t m_frame_number = 0;        // frames submitted so far
+
+        // Set when the swapchain no longer matches the window, it is rebuilt at the start of the next frame
+        bool m_swapchain_dirty = false;
+        std::deque<RetiredSwapchain> m_retired_swapchains;
 
         std::vector <std::unique_ptr<VKBuffer> > m_uboBuffers;
 
         VkPhysicalDeviceProperties m_deviceProperties;
         VkPhysicalDeviceFeatures m_deviceFeatures;
         VkPhysicalDeviceMemoryProperties m_deviceMemoryProperties;
-
-        VKCommonParameters m_vkparams;
 };